@@ -2,10 +2,20 @@
 #include <stdlib.h>
 #include <stdbool.h>
 #include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include <pthread.h>
+#include <unistd.h>
 
 #define MAX_PEOPLE 100
 #define NAME_LENGTH 50
 #define PHONE_LENGTH 15
+#define WORD_BITS 64
+#define CHUNK_WORDS 64              // bitmap words handed to a thread at a time (4096 people)
+#define PARALLEL_MIN_PEOPLE 65536   // smaller graphs are searched on one thread
+#define TOP_DOWN_ALPHA 14           // go bottom-up once the frontier has more than 1/14 of the unexplored edges
+#define BOTTOM_UP_BETA 24           // go back top-down once a shrinking frontier has under 1/24 of the people
+#define SMALL_WORLD_REWIRE 0.1      // share of ring contacts the benchmark graph replaces by random people
 
 // Structure for a person
 typedef struct Person {
@@ -26,6 +36,32 @@ typedef struct Graph {
     int numPeople;
 } Graph;
 
+// contact graph in compressed sparse row form, for any number of people: the contacts of
+// person p are contacts[offsets[p]] .. contacts[offsets[p + 1] - 1]
+typedef struct ContactGraph {
+    int numPeople;
+    long long numContacts;
+    long long* offsets;
+    int* contacts;
+} ContactGraph;
+
+typedef struct ThreadArgs {
+    int threadId;
+    int numThreads;
+    void* shared;
+} ThreadArgs;
+
+ContactGraph* createContactGraph(Graph* graph);
+ContactGraph* generateSmallWorld(int numPeople, int degree, double rewire, unsigned int seed);
+void freeContactGraph(ContactGraph* graph);
+void directionOptimizingBFS(const ContactGraph* graph, int start, int* levels, int numThreads);
+int defaultThreadCount();
+void runThreads(int numThreads, void* (*worker)(void*), void* shared);
+double currentTime();
+int runBenchmark(int argc, char* argv[]);
+Graph* createExampleGraph();
+void freeGraph(Graph* graph);
+
 // A new graph is created here
 Graph* createGraph(int numPeople) {
     Graph* graph = (Graph*)malloc(sizeof(Graph));
@@ -76,21 +112,8 @@ void BFS(Graph* graph, int start, int levels[MAX_PEOPLE]) {
     }
 }
 
-// Print this contacts by level
-void printContactsByLevel(Graph* graph, int levels[MAX_PEOPLE]) {
-    printf("Contacts by level:\n");
-    for (int level = 0; level < MAX_PEOPLE; level++) {
-        printf("Level %d: ", level);
-        for (int i = 0; i < graph->numPeople; i++) {
-            if (levels[i] == level) {
-                printf("%s (Phone: %s) ", graph->people[i].name, graph->people[i].phone);
-            }
-        }
-        printf("\n");
-    }
-}
-
-int main() {
+// The ten people of the interactive example and their contacts
+Graph* createExampleGraph() {
     Graph* graph = createGraph(10);
     
     // Add people and their contacts here
@@ -126,6 +149,330 @@ int main() {
     addEdge(graph, 5, 8); 
     addEdge(graph, 6, 9); 
 
+    return graph;
+}
+
+// free the contact lists and the graph here
+void freeGraph(Graph* graph) {
+    for (int i = 0; i < graph->numPeople; i++) {
+        Node* temp = graph->adjList[i];
+        while (temp != NULL) {
+            Node* next = temp->next;
+            free(temp);
+            temp = next;
+        }
+    }
+    free(graph);
+}
+
+// build the row form of the adjacency lists, keeping each person's contacts in list order
+ContactGraph* createContactGraph(Graph* graph) {
+    ContactGraph* result = malloc(sizeof(ContactGraph));
+    result->numPeople = graph->numPeople;
+    result->offsets = malloc((graph->numPeople + 1) * sizeof(long long));
+    result->offsets[0] = 0;
+    for (int i = 0; i < graph->numPeople; i++) {
+        long long degree = 0;
+        for (Node* temp = graph->adjList[i]; temp != NULL; temp = temp->next) {
+            degree++;
+        }
+        result->offsets[i + 1] = result->offsets[i] + degree;
+    }
+    result->numContacts = result->offsets[graph->numPeople];
+    result->contacts = malloc((result->numContacts > 0 ? result->numContacts : 1) * sizeof(int));
+
+    for (int i = 0; i < graph->numPeople; i++) {
+        long long e = result->offsets[i];
+        for (Node* temp = graph->adjList[i]; temp != NULL; temp = temp->next) {
+            result->contacts[e++] = temp->personIndex;
+        }
+    }
+    return result;
+}
+
+static uint64_t nextRandom(uint64_t* state) {
+    *state ^= *state >> 12;
+    *state ^= *state << 25;
+    *state ^= *state >> 27;
+    return *state * 0x2545F4914F6CDD1DULL;
+}
+
+// Watts-Strogatz small world: everybody knows the degree / 2 people after them on a ring, and
+// each of those contacts is replaced by a random person with probability rewire
+ContactGraph* generateSmallWorld(int numPeople, int degree, double rewire, unsigned int seed) {
+    long long perPerson = degree / 2, numEdges = (long long)numPeople * perPerson;
+    int* src = malloc((numEdges > 0 ? numEdges : 1) * sizeof(int));
+    int* dest = malloc((numEdges > 0 ? numEdges : 1) * sizeof(int));
+    uint64_t state = 0x9E3779B97F4A7C15ULL ^ seed;
+    uint64_t threshold = (uint64_t)(rewire * (double)(1ULL << 53));
+
+    for (long long e = 0; e < numEdges; e++) {
+        int person = (int)(e / perPerson);
+        src[e] = person;
+        dest[e] = (int)((person + e % perPerson + 1) % numPeople);
+        if (nextRandom(&state) >> 11 < threshold) {
+            dest[e] = (int)(nextRandom(&state) % numPeople);
+            if (dest[e] == person) dest[e] = (person + 1) % numPeople;
+        }
+    }
+
+    ContactGraph* graph = malloc(sizeof(ContactGraph));
+    graph->numPeople = numPeople;
+    graph->numContacts = 2 * numEdges;
+    graph->offsets = calloc(numPeople + 1, sizeof(long long));
+    graph->contacts = malloc((graph->numContacts > 0 ? graph->numContacts : 1) * sizeof(int));
+    for (long long e = 0; e < numEdges; e++) {
+        graph->offsets[src[e] + 1]++;
+        graph->offsets[dest[e] + 1]++;
+    }
+    for (int i = 0; i < numPeople; i++) {
+        graph->offsets[i + 1] += graph->offsets[i];
+    }
+    long long* position = malloc((numPeople > 0 ? numPeople : 1) * sizeof(long long));
+    memcpy(position, graph->offsets, numPeople * sizeof(long long));
+    for (long long e = 0; e < numEdges; e++) {
+        graph->contacts[position[src[e]]++] = dest[e];
+        graph->contacts[position[dest[e]]++] = src[e];
+    }
+
+    free(position);
+    free(src);
+    free(dest);
+    return graph;
+}
+
+void freeContactGraph(ContactGraph* graph) {
+    free(graph->offsets);
+    free(graph->contacts);
+    free(graph);
+}
+
+// the queue search of BFS() on the row form, as the reference for the benchmark
+static void queueBFS(const ContactGraph* graph, int start, int* levels) {
+    int* queue = malloc(graph->numPeople * sizeof(int));
+    int front = 0, rear = 0;
+    memset(levels, -1, graph->numPeople * sizeof(int));
+
+    levels[start] = 0;
+    queue[rear++] = start;
+    while (front < rear) {
+        int current = queue[front++];
+        for (long long e = graph->offsets[current]; e < graph->offsets[current + 1]; e++) {
+            int neighbor = graph->contacts[e];
+            if (levels[neighbor] < 0) {
+                levels[neighbor] = levels[current] + 1;
+                queue[rear++] = neighbor;
+            }
+        }
+    }
+    free(queue);
+}
+
+// state shared by the threads of one direction-optimizing search. Frontiers and the visited
+// set are bitmaps with one bit per person; the threads take CHUNK_WORDS words at a time.
+typedef struct FrontierSearch {
+    const ContactGraph* graph;
+    int* levels;
+    uint64_t* visited;
+    uint64_t* frontier[2];       // the current level and the next one, swapped after each level
+    uint64_t lastMask;           // bits of the last word that stand for people
+    int numWords;
+    int allowBottomUp;
+    int bottomUp;                // direction of the current level
+    int depth;
+    int bottomUpLevels;
+    long long frontierSize;      // people in the current frontier
+    long long frontierEdges;     // their contact entries
+    long long unexploredEdges;   // contact entries of the people not reached yet
+    long long nextSize;          // the same two counts for the next frontier, added up by the threads
+    long long nextEdges;
+    int nextWord;
+    pthread_barrier_t barrier;
+} FrontierSearch;
+
+// top-down step over frontier words [first, last): claim the unvisited contacts of every
+// frontier person, racing other threads for them with an atomic or on the visited word
+static void expandTopDown(FrontierSearch* search, const uint64_t* frontier, uint64_t* next, int first, int last,
+                          long long* size, long long* edges) {
+    const ContactGraph* graph = search->graph;
+    for (int w = first; w < last; w++) {
+        for (uint64_t bits = frontier[w]; bits != 0; bits &= bits - 1) {
+            int person = w * WORD_BITS + __builtin_ctzll(bits);
+            for (long long e = graph->offsets[person]; e < graph->offsets[person + 1]; e++) {
+                int contact = graph->contacts[e];
+                uint64_t mask = 1ULL << (contact % WORD_BITS);
+                uint64_t* word = &search->visited[contact / WORD_BITS];
+                if (__atomic_load_n(word, __ATOMIC_RELAXED) & mask) continue;
+                if (__atomic_fetch_or(word, mask, __ATOMIC_RELAXED) & mask) continue;
+
+                search->levels[contact] = search->depth + 1;
+                __atomic_fetch_or(&next[contact / WORD_BITS], mask, __ATOMIC_RELAXED);
+                (*size)++;
+                *edges += graph->offsets[contact + 1] - graph->offsets[contact];
+            }
+        }
+    }
+}
+
+// bottom-up step over words [first, last): every unvisited person looks for any contact in
+// the frontier and stops at the first one. The words belong to this thread alone, so no
+// atomics are needed.
+static void expandBottomUp(FrontierSearch* search, const uint64_t* frontier, uint64_t* next, int first, int last,
+                           long long* size, long long* edges) {
+    const ContactGraph* graph = search->graph;
+    for (int w = first; w < last; w++) {
+        uint64_t unvisited = ~search->visited[w] & (w == search->numWords - 1 ? search->lastMask : ~0ULL);
+        uint64_t found = 0;
+        for (; unvisited != 0; unvisited &= unvisited - 1) {
+            int bit = __builtin_ctzll(unvisited);
+            int person = w * WORD_BITS + bit;
+            for (long long e = graph->offsets[person]; e < graph->offsets[person + 1]; e++) {
+                int contact = graph->contacts[e];
+                if (frontier[contact / WORD_BITS] >> (contact % WORD_BITS) & 1) {
+                    found |= 1ULL << bit;
+                    search->levels[person] = search->depth + 1;
+                    (*size)++;
+                    *edges += graph->offsets[person + 1] - graph->offsets[person];
+                    break;
+                }
+            }
+        }
+        next[w] = found;
+        search->visited[w] |= found;
+    }
+}
+
+// called by one thread between levels: make the next frontier current and pick its direction
+// (Beamer's heuristic). Bottom-up pays off once the frontier's edges are a sizeable share of
+// the edges left to explore; top-down again once the frontier shrinks to a small fraction.
+static void finishLevel(FrontierSearch* search) {
+    long long previousSize = search->frontierSize;
+    search->frontierSize = search->nextSize;
+    search->frontierEdges = search->nextEdges;
+    search->unexploredEdges -= search->nextEdges;
+    search->nextSize = 0;
+    search->nextEdges = 0;
+    search->nextWord = 0;
+    search->depth++;
+
+    if (!search->allowBottomUp) return;
+    if (!search->bottomUp) {
+        search->bottomUp = search->frontierEdges > search->unexploredEdges / TOP_DOWN_ALPHA;
+    } else {
+        search->bottomUp = search->frontierSize >= previousSize
+                        || search->frontierSize >= search->graph->numPeople / BOTTOM_UP_BETA;
+    }
+    search->bottomUpLevels += search->bottomUp && search->frontierSize > 0;
+}
+
+static void* frontierWorker(void* arg) {
+    ThreadArgs* args = arg;
+    FrontierSearch* shared = args->shared;
+    int current = 0;
+
+    // between levels every thread clears a fixed slice of the finished frontier
+    int firstWord = (int)((long long)shared->numWords * args->threadId / args->numThreads);
+    int lastWord = (int)((long long)shared->numWords * (args->threadId + 1) / args->numThreads);
+
+    while (shared->frontierSize > 0) {
+        uint64_t* frontier = shared->frontier[current];
+        uint64_t* next = shared->frontier[1 - current];
+        long long size = 0, edges = 0;
+
+        for (;;) {
+            int first = __atomic_fetch_add(&shared->nextWord, CHUNK_WORDS, __ATOMIC_RELAXED);
+            if (first >= shared->numWords) break;
+            int last = first + CHUNK_WORDS < shared->numWords ? first + CHUNK_WORDS : shared->numWords;
+            if (shared->bottomUp) {
+                expandBottomUp(shared, frontier, next, first, last, &size, &edges);
+            } else {
+                expandTopDown(shared, frontier, next, first, last, &size, &edges);
+            }
+        }
+        __atomic_fetch_add(&shared->nextSize, size, __ATOMIC_RELAXED);
+        __atomic_fetch_add(&shared->nextEdges, edges, __ATOMIC_RELAXED);
+        pthread_barrier_wait(&shared->barrier);
+
+        memset(frontier + firstWord, 0, (lastWord - firstWord) * sizeof(uint64_t));
+        current = 1 - current;
+        if (args->threadId == 0) {
+            finishLevel(shared);
+        }
+        pthread_barrier_wait(&shared->barrier);
+    }
+    return NULL;
+}
+
+// level-synchronous search over bitmap frontiers on numThreads threads, top-down only or
+// switching direction; returns the number of levels expanded bottom-up
+static int searchFrontiers(const ContactGraph* graph, int start, int* levels, int numThreads, int allowBottomUp) {
+    memset(levels, -1, graph->numPeople * sizeof(int));
+    if (start < 0 || start >= graph->numPeople) return 0;
+    if (numThreads < 1 || graph->numPeople < PARALLEL_MIN_PEOPLE) numThreads = 1;
+
+    FrontierSearch search;
+    search.graph = graph;
+    search.levels = levels;
+    search.numWords = (graph->numPeople + WORD_BITS - 1) / WORD_BITS;
+    search.lastMask = graph->numPeople % WORD_BITS ? (1ULL << (graph->numPeople % WORD_BITS)) - 1 : ~0ULL;
+    search.visited = calloc(search.numWords, sizeof(uint64_t));
+    search.frontier[0] = calloc(search.numWords, sizeof(uint64_t));
+    search.frontier[1] = calloc(search.numWords, sizeof(uint64_t));
+    search.allowBottomUp = allowBottomUp;
+    search.bottomUp = 0;
+    search.depth = 0;
+    search.bottomUpLevels = 0;
+    search.frontierSize = 1;
+    search.frontierEdges = graph->offsets[start + 1] - graph->offsets[start];
+    search.unexploredEdges = graph->numContacts - search.frontierEdges;
+    search.nextSize = 0;
+    search.nextEdges = 0;
+    search.nextWord = 0;
+    pthread_barrier_init(&search.barrier, NULL, numThreads);
+
+    levels[start] = 0;
+    search.visited[start / WORD_BITS] |= 1ULL << (start % WORD_BITS);
+    search.frontier[0][start / WORD_BITS] |= 1ULL << (start % WORD_BITS);
+    runThreads(numThreads, frontierWorker, &search);
+
+    pthread_barrier_destroy(&search.barrier);
+    free(search.visited);
+    free(search.frontier[0]);
+    free(search.frontier[1]);
+    return search.bottomUpLevels;
+}
+
+// Direction-optimizing BFS (Beamer et al.): small frontiers are expanded top-down, from the
+// frontier to its contacts, and large ones bottom-up, where every person not reached yet
+// checks whether one of its contacts is in the frontier and stops at the first. On small-world
+// graphs the middle levels cover most people, so bottom-up skips most of their edges. Levels
+// are expanded in parallel on numThreads threads. levels[] is filled for all numPeople people
+// as BFS() and a memset to -1 would: the contact distance from start, or -1 if unreachable.
+void directionOptimizingBFS(const ContactGraph* graph, int start, int* levels, int numThreads) {
+    searchFrontiers(graph, start, levels, numThreads, 1);
+}
+
+// Print this contacts by level
+void printContactsByLevel(Graph* graph, int levels[MAX_PEOPLE]) {
+    printf("Contacts by level:\n");
+    for (int level = 0; level < MAX_PEOPLE; level++) {
+        printf("Level %d: ", level);
+        for (int i = 0; i < graph->numPeople; i++) {
+            if (levels[i] == level) {
+                printf("%s (Phone: %s) ", graph->people[i].name, graph->people[i].phone);
+            }
+        }
+        printf("\n");
+    }
+}
+
+int main(int argc, char* argv[]) {
+    if (argc > 1 && strcmp(argv[1], "bench") == 0) {
+        return runBenchmark(argc - 2, argv + 2);
+    }
+
+    Graph* graph = createExampleGraph();
+
     int source;
     printf("Enter the index of the criminal (0 to %d): ", graph->numPeople - 1);
     scanf("%d", &source);
@@ -133,10 +480,125 @@ int main() {
     int levels[MAX_PEOPLE];
     memset(levels, -1, sizeof(levels)); // -1 indicates unvisited
 
-    BFS(graph, source, levels);
+    ContactGraph* contacts = createContactGraph(graph);
+    directionOptimizingBFS(contacts, source, levels, defaultThreadCount());
     printContactsByLevel(graph, levels);
 
     // free the memory here
+    freeContactGraph(contacts);
+    freeGraph(graph);
 
     return 0;
 }
+
+int defaultThreadCount() {
+    long cores = sysconf(_SC_NPROCESSORS_ONLN);
+    return cores > 0 ? (int)cores : 1;
+}
+
+// run worker on numThreads threads (the caller being thread 0) and wait for all of them
+void runThreads(int numThreads, void* (*worker)(void*), void* shared) {
+    pthread_t* threads = malloc(numThreads * sizeof(pthread_t));
+    ThreadArgs* args = malloc(numThreads * sizeof(ThreadArgs));
+
+    for (int i = 0; i < numThreads; i++) {
+        args[i].threadId = i;
+        args[i].numThreads = numThreads;
+        args[i].shared = shared;
+    }
+    for (int i = 1; i < numThreads; i++) {
+        pthread_create(&threads[i], NULL, worker, &args[i]);
+    }
+    worker(&args[0]);
+    for (int i = 1; i < numThreads; i++) {
+        pthread_join(threads[i], NULL);
+    }
+
+    free(threads);
+    free(args);
+}
+
+double currentTime() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// run both bitmap searches from every person of the example graph and count the starts where
+// their levels differ from those of BFS(), the reference search
+static int checkExampleGraph() {
+    Graph* graph = createExampleGraph();
+    ContactGraph* contacts = createContactGraph(graph);
+    int expected[MAX_PEOPLE], levels[MAX_PEOPLE];
+    int mismatches = 0;
+
+    for (int start = 0; start < graph->numPeople; start++) {
+        memset(expected, -1, sizeof(expected));
+        BFS(graph, start, expected);
+        for (int allowBottomUp = 0; allowBottomUp <= 1; allowBottomUp++) {
+            searchFrontiers(contacts, start, levels, 1, allowBottomUp);
+            if (memcmp(levels, expected, graph->numPeople * sizeof(int)) != 0) {
+                mismatches++;
+                break;
+            }
+        }
+    }
+
+    printf("Example graph: %d people, bitmap searches from every start vs BFS()  %s\n", graph->numPeople,
+           mismatches == 0 ? "ok" : "MISMATCH");
+    freeContactGraph(contacts);
+    freeGraph(graph);
+    return mismatches;
+}
+
+// benchmark: criminal_tracking bench [people] [degree] [max threads]
+// checks the bitmap searches against BFS() on the example graph, then compares the queue search
+// with them, top-down only and direction-optimizing, on a small world
+int runBenchmark(int argc, char* argv[]) {
+    int people = argc > 0 ? atoi(argv[0]) : 1000000;
+    int degree = argc > 1 ? atoi(argv[1]) : 16;
+    int maxThreads = argc > 2 ? atoi(argv[2]) : defaultThreadCount();
+
+    if (people < 2 || degree < 2 || maxThreads <= 0) {
+        printf("Usage: criminal_tracking bench [people] [degree] [max threads]\n");
+        return 1;
+    }
+
+    int exampleMismatches = checkExampleGraph();
+    ContactGraph* graph = generateSmallWorld(people, degree, SMALL_WORLD_REWIRE, 42);
+    int* expected = malloc(people * sizeof(int));
+    int* levels = malloc(people * sizeof(int));
+
+    double start = currentTime();
+    queueBFS(graph, 0, expected);
+    double queueTime = currentTime() - start;
+    int depth = 0, reached = 0;
+    for (int i = 0; i < people; i++) {
+        if (expected[i] > depth) depth = expected[i];
+        reached += expected[i] >= 0;
+    }
+    printf("Small world: %d people, %lld contacts, %d reached in %d levels\n", people, graph->numContacts / 2,
+           reached, depth + 1);
+    printf("  queue (BFS)                           %10.3f ms\n", queueTime * 1000);
+
+    int mismatches = exampleMismatches;
+    for (int threads = 1; ; threads = threads * 2 < maxThreads ? threads * 2 : maxThreads) {
+        for (int allowBottomUp = 0; allowBottomUp <= 1; allowBottomUp++) {
+            start = currentTime();
+            int bottomUpLevels = searchFrontiers(graph, 0, levels, threads, allowBottomUp);
+            double elapsed = currentTime() - start;
+
+            int match = memcmp(levels, expected, people * sizeof(int)) == 0;
+            mismatches += !match;
+            printf("  %-20s %3d threads %10.3f ms  vs queue %6.2fx  %2d bottom-up levels  %s\n",
+                   allowBottomUp ? "direction-optimizing" : "top-down bitmap", threads, elapsed * 1000,
+                   queueTime / elapsed, bottomUpLevels, match ? "ok" : "MISMATCH");
+        }
+        if (threads >= maxThreads) break;
+    }
+
+    free(expected);
+    free(levels);
+    freeContactGraph(graph);
+    return mismatches > 0;
+}
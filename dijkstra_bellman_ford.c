@@ -1,9 +1,22 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <limits.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
-#define MAX_VERTICES 100
-#define INF INT_MAX
+#define INF LLONG_MAX
+#define GRAPH_BINARY_MAGIC 0x42524757 // "WGRB", the binary graph format of weighted_graph
+#define GRAPH_BINARY_VERSION 1
+#define GRAPH_BINARY_HEADER (4 * sizeof(int))
+#define SNAPSHOT_MAGIC 0x53534757 // "WGSS", graph snapshots written by weighted_graph
+#define SNAPSHOT_VERSION 1
+#define SNAPSHOT_PAGE 4096
+#define SNAPSHOT_SECTIONS 12
+#define SNAPSHOT_CHECKSUM 1
+#define SNAPSHOT_CHECKSUM_SEED 0xcbf29ce484222325ULL
 
 // Structure to represent an edge in the graph
 typedef struct edge {
@@ -13,28 +26,149 @@ typedef struct edge {
 } Edge;
 
 // Structure for the graph
+// The adjacency lists are used while edges are added; finalizeGraph() then packs
+// them into CSR arrays where the edges of u are offsets[u] .. offsets[u + 1] - 1.
+// A graph opened from a snapshot points into the mapping instead of owning its arrays.
 typedef struct graph {
-    Edge* adjList[MAX_VERTICES];
+    Edge** adjList;
     int numVertices;
+    int numEdges;
+    int* offsets;
+    int* destinations;
+    int* weights;
+    void* mapping;
+    size_t mappingSize;
 } Graph;
 
+// Structure of a snapshot header as written by weighted_graph; the graph is in the first three
+// sections (offsets, destinations, weights), each starting on a page boundary
+typedef struct snapshotHeader {
+    int magic;
+    int version;
+    int flags;
+    int numVertices;
+    int numEdges;
+    int upwardEdges;
+    int downwardEdges;
+    int reserved;
+    unsigned long long checksum;
+    struct {
+        long long offset;
+        long long count;
+    } sections[SNAPSHOT_SECTIONS];
+} SnapshotHeader;
+
+// Per-query scratch memory, sized for the graph once and reused by every query
+typedef struct workspace {
+    int capacity;
+    long long* dist;
+    int* parent;
+    char* visited;
+    int* heap;
+    int* position;
+    int* cycle;
+} Workspace;
+
+// Function to create a graph without adjacency lists, for CSR arrays made elsewhere
+Graph* createCsrGraph(int numVertices) {
+    Graph* graph = (Graph*)malloc(sizeof(Graph));
+    graph->adjList = NULL;
+    graph->numVertices = numVertices;
+    graph->numEdges = 0;
+    graph->offsets = NULL;
+    graph->destinations = NULL;
+    graph->weights = NULL;
+    graph->mapping = NULL;
+    graph->mappingSize = 0;
+    return graph;
+}
+
 // Function to create a graph
 Graph* createGraph(int numVertices) {
     Graph* graph = (Graph*)malloc(sizeof(Graph));
+    graph->adjList = (Edge**)malloc(numVertices * sizeof(Edge*));
     graph->numVertices = numVertices;
+    graph->numEdges = 0;
+    graph->offsets = NULL;
+    graph->destinations = NULL;
+    graph->weights = NULL;
+    graph->mapping = NULL;
+    graph->mappingSize = 0;
     for (int i = 0; i < numVertices; i++) {
         graph->adjList[i] = NULL;
     }
     return graph;
 }
 
+// Function to create an already finalized graph straight from edge arrays
+Graph* createGraphFromEdges(int numVertices, int numEdges, const int* sources, const int* destinations, const int* weights) {
+    Graph* graph = createGraph(numVertices);
+    graph->numEdges = numEdges;
+    graph->offsets = (int*)calloc(numVertices + 1, sizeof(int));
+    graph->destinations = (int*)malloc(numEdges * sizeof(int));
+    graph->weights = (int*)malloc(numEdges * sizeof(int));
+
+    for (int i = 0; i < numEdges; i++) {
+        graph->offsets[sources[i] + 1]++;
+    }
+    for (int u = 0; u < numVertices; u++) {
+        graph->offsets[u + 1] += graph->offsets[u];
+    }
+
+    // offsets[u] is used as the fill cursor of u, then shifted back into place
+    for (int i = 0; i < numEdges; i++) {
+        int slot = graph->offsets[sources[i]]++;
+        graph->destinations[slot] = destinations[i];
+        graph->weights[slot] = weights[i];
+    }
+    for (int u = numVertices; u > 0; u--) {
+        graph->offsets[u] = graph->offsets[u - 1];
+    }
+    graph->offsets[0] = 0;
+    return graph;
+}
+
 // Function to add an edge to the graph
 void addEdge(Graph* graph, int source, int destination, int weight) {
+    if (graph->offsets != NULL) {
+        printf("Graph is already finalized, edge %d -> %d ignored\n", source, destination);
+        return;
+    }
+    if (source < 0 || source >= graph->numVertices || destination < 0 || destination >= graph->numVertices) {
+        printf("Vertex out of range (0 to %d), edge %d -> %d ignored\n", graph->numVertices - 1, source, destination);
+        return;
+    }
     Edge* newEdge = (Edge*)malloc(sizeof(Edge));
     newEdge->destination = destination;
     newEdge->weight = weight;
     newEdge->next = graph->adjList[source];
     graph->adjList[source] = newEdge;
+    graph->numEdges++;
+}
+
+// Function to pack the adjacency lists into CSR arrays and free the list nodes
+void finalizeGraph(Graph* graph) {
+    if (graph->offsets != NULL) return;
+
+    graph->offsets = (int*)malloc((graph->numVertices + 1) * sizeof(int));
+    graph->destinations = (int*)malloc(graph->numEdges * sizeof(int));
+    graph->weights = (int*)malloc(graph->numEdges * sizeof(int));
+
+    int slot = 0;
+    for (int u = 0; u < graph->numVertices; u++) {
+        graph->offsets[u] = slot;
+        Edge* edge = graph->adjList[u];
+        while (edge != NULL) {
+            Edge* temp = edge;
+            graph->destinations[slot] = edge->destination;
+            graph->weights[slot] = edge->weight;
+            slot++;
+            edge = edge->next;
+            free(temp);
+        }
+        graph->adjList[u] = NULL;
+    }
+    graph->offsets[graph->numVertices] = slot;
 }
 
 // Function to draw the graph
@@ -42,98 +176,214 @@ void drawGraph(Graph* graph) {
     printf("\nGraph representation (adjacency list):\n");
     for (int i = 0; i < graph->numVertices; i++) {
         printf("%d: ", i);
-        Edge* edge = graph->adjList[i];
-        while (edge != NULL) {
-            printf("-> (%d, %d) ", edge->destination, edge->weight);
-            edge = edge->next;
+        for (int e = graph->offsets[i]; e < graph->offsets[i + 1]; e++) {
+            printf("-> (%d, %d) ", graph->destinations[e], graph->weights[e]);
         }
         printf("\n");
     }
 }
 
-// Dijkstra's Algorithm
-void Dijkstra(Graph* graph, int source) {
-    int dist[MAX_VERTICES];
-    int visited[MAX_VERTICES] = {0};
+// Function to allocate the scratch arrays for queries on graphs of up to capacity vertices
+Workspace* createWorkspace(int capacity) {
+    Workspace* ws = (Workspace*)malloc(sizeof(Workspace));
+    ws->capacity = capacity;
+    ws->dist = (long long*)malloc(capacity * sizeof(long long));
+    ws->parent = (int*)malloc(capacity * sizeof(int));
+    ws->visited = (char*)malloc(capacity);
+    ws->heap = (int*)malloc(capacity * sizeof(int));
+    ws->position = (int*)malloc(capacity * sizeof(int));
+    ws->cycle = (int*)malloc(capacity * sizeof(int));
+    return ws;
+}
 
-    for (int i = 0; i < graph->numVertices; i++) {
-        dist[i] = INF;
+// Function to reset the workspace before a query from source
+void resetWorkspace(Workspace* ws, int numVertices, int source) {
+    for (int i = 0; i < numVertices; i++) {
+        ws->dist[i] = INF;
+        ws->parent[i] = -1;
+        ws->visited[i] = 0;
+        ws->position[i] = -1;
     }
-    dist[source] = 0;
+    ws->dist[source] = 0;
+}
 
-    for (int i = 0; i < graph->numVertices - 1; i++) {
-        int minDist = INF;
-        int minIndex = -1;
+// Free the workspace's memory
+void freeWorkspace(Workspace* ws) {
+    free(ws->dist);
+    free(ws->parent);
+    free(ws->visited);
+    free(ws->heap);
+    free(ws->position);
+    free(ws->cycle);
+    free(ws);
+}
 
-        for (int j = 0; j < graph->numVertices; j++) {
-            if (!visited[j] && dist[j] < minDist) {
-                minDist = dist[j];
-                minIndex = j;
-            }
+// Function to print the distances of the last query
+void printDistances(Workspace* ws, int numVertices) {
+    for (int i = 0; i < numVertices; i++) {
+        if (ws->dist[i] == INF) {
+            printf("Distance to vertex %d: INF\n", i);
+        } else {
+            printf("Distance to vertex %d: %lld\n", i, ws->dist[i]);
         }
+    }
+}
 
-        if (minIndex == -1) break; // No more reachable vertices
+// Move the heap entry at index up until its parent is not larger
+void siftUp(int heap[], int position[], long long dist[], int index) {
+    int vertex = heap[index];
+    while (index > 0 && dist[heap[(index - 1) / 2]] > dist[vertex]) {
+        heap[index] = heap[(index - 1) / 2];
+        position[heap[index]] = index;
+        index = (index - 1) / 2;
+    }
+    heap[index] = vertex;
+    position[vertex] = index;
+}
+
+// Move the heap entry at index down until both children are not smaller
+void siftDown(int heap[], int position[], long long dist[], int size, int index) {
+    int vertex = heap[index];
+    while (2 * index + 1 < size) {
+        int child = 2 * index + 1;
+        if (child + 1 < size && dist[heap[child + 1]] < dist[heap[child]]) {
+            child++;
+        }
+        if (dist[vertex] <= dist[heap[child]]) break;
+        heap[index] = heap[child];
+        position[heap[index]] = index;
+        index = child;
+    }
+    heap[index] = vertex;
+    position[vertex] = index;
+}
+
+// Dijkstra's Algorithm (indexed binary heap with decrease-key)
+void Dijkstra(Graph* graph, Workspace* ws, int source) {
+    long long* dist = ws->dist;
+    char* visited = ws->visited;
+    int* heap = ws->heap;
+    int* position = ws->position;
+    int heapSize = 0;
+
+    resetWorkspace(ws, graph->numVertices, source);
+    heap[heapSize++] = source;
+    position[source] = 0;
+
+    while (heapSize > 0) {
+        int minIndex = heap[0];
+        position[minIndex] = -1;
+        if (--heapSize > 0) {
+            heap[0] = heap[heapSize];
+            siftDown(heap, position, dist, heapSize, 0);
+        }
         visited[minIndex] = 1;
 
-        Edge* edge = graph->adjList[minIndex];
-        while (edge != NULL) {
-            if (!visited[edge->destination] && dist[minIndex] + edge->weight < dist[edge->destination]) {
-                dist[edge->destination] = dist[minIndex] + edge->weight;
+        for (int e = graph->offsets[minIndex]; e < graph->offsets[minIndex + 1]; e++) {
+            int v = graph->destinations[e];
+            if (!visited[v] && dist[minIndex] + graph->weights[e] < dist[v]) {
+                dist[v] = dist[minIndex] + graph->weights[e];
+                ws->parent[v] = minIndex;
+                if (position[v] == -1) {
+                    heap[heapSize] = v;
+                    siftUp(heap, position, dist, heapSize++);
+                } else {
+                    siftUp(heap, position, dist, position[v]);
+                }
             }
-            edge = edge->next;
         }
     }
 
     // Print the shortest distances
     printf("Dijkstra's Algorithm: Shortest distances from vertex %d:\n", source);
-    for (int i = 0; i < graph->numVertices; i++) {
-        printf("Distance to vertex %d: %d\n", i, dist[i]);
+    printDistances(ws, graph->numVertices);
+}
+
+// Function to find a negative cycle once a full round still relaxed an edge.
+// Stores it in ws->cycle in edge order and returns its length (0 if distances settled).
+int findNegativeCycle(Graph* graph, Workspace* ws) {
+    long long* dist = ws->dist;
+    int* parent = ws->parent;
+
+    while (1) {
+        int relaxed = 0;
+        for (int u = 0; u < graph->numVertices; u++) {
+            if (dist[u] == INF) continue;
+            for (int e = graph->offsets[u]; e < graph->offsets[u + 1]; e++) {
+                int v = graph->destinations[e];
+                if (dist[u] + graph->weights[e] >= dist[v]) continue;
+                dist[v] = dist[u] + graph->weights[e];
+                parent[v] = u;
+                relaxed = 1;
+
+                // Following parents for V steps without reaching the source means we are on a cycle
+                int x = v;
+                for (int i = 0; i < graph->numVertices && x != -1; i++) {
+                    x = parent[x];
+                }
+                if (x == -1) continue;
+
+                int length = 0;
+                int y = x;
+                do {
+                    ws->cycle[length++] = y;
+                    y = parent[y];
+                } while (y != x);
+                for (int i = 0, j = length - 1; i < j; i++, j--) {
+                    int temp = ws->cycle[i];
+                    ws->cycle[i] = ws->cycle[j];
+                    ws->cycle[j] = temp;
+                }
+                return length;
+            }
+        }
+        if (!relaxed) return 0;
     }
 }
 
 // Bellman-Ford Algorithm
-void BellmanFord(Graph* graph, int source) {
-    int dist[MAX_VERTICES];
+// Returns the length of the negative cycle stored in ws->cycle, or 0 if there is none
+int BellmanFord(Graph* graph, Workspace* ws, int source) {
+    long long* dist = ws->dist;
+    int changed = 1;
 
-    for (int i = 0; i < graph->numVertices; i++) {
-        dist[i] = INF;
-    }
-    dist[source] = 0;
+    resetWorkspace(ws, graph->numVertices, source);
 
-    for (int i = 0; i < graph->numVertices - 1; i++) {
+    // Stop as soon as a full round leaves every distance unchanged
+    for (int i = 0; i < graph->numVertices - 1 && changed; i++) {
+        changed = 0;
         for (int u = 0; u < graph->numVertices; u++) {
-            Edge* edge = graph->adjList[u];
-            while (edge != NULL) {
-                if (dist[u] != INF && dist[u] + edge->weight < dist[edge->destination]) {
-                    dist[edge->destination] = dist[u] + edge->weight;
+            if (dist[u] == INF) continue;
+            for (int e = graph->offsets[u]; e < graph->offsets[u + 1]; e++) {
+                if (dist[u] + graph->weights[e] < dist[graph->destinations[e]]) {
+                    dist[graph->destinations[e]] = dist[u] + graph->weights[e];
+                    ws->parent[graph->destinations[e]] = u;
+                    changed = 1;
                 }
-                edge = edge->next;
             }
         }
     }
 
     // Check for negative-weight cycles
-    for (int u = 0; u < graph->numVertices; u++) {
-        Edge* edge = graph->adjList[u];
-        while (edge != NULL) {
-            if (dist[u] != INF && dist[u] + edge->weight < dist[edge->destination]) {
-                printf("Graph contains a negative weight cycle\n");
-                return;
-            }
-            edge = edge->next;
+    int cycleLength = changed ? findNegativeCycle(graph, ws) : 0;
+    if (cycleLength > 0) {
+        printf("Graph contains a negative weight cycle: ");
+        for (int i = 0; i < cycleLength; i++) {
+            printf("%d -> ", ws->cycle[i]);
         }
+        printf("%d\n", ws->cycle[0]);
+        return cycleLength;
     }
 
     // Print the shortest distances
     printf("Bellman-Ford Algorithm: Shortest distances from vertex %d:\n", source);
-    for (int i = 0; i < graph->numVertices; i++) {
-        printf("Distance to vertex %d: %d\n", i, dist[i]);
-    }
+    printDistances(ws, graph->numVertices);
+    return 0;
 }
 
 // Free the graph's memory
 void freeGraph(Graph* graph) {
-    for (int i = 0; i < graph->numVertices; i++) {
+    for (int i = 0; i < graph->numVertices && graph->adjList != NULL; i++) {
         Edge* edge = graph->adjList[i];
         while (edge != NULL) {
             Edge* temp = edge;
@@ -141,39 +391,323 @@ void freeGraph(Graph* graph) {
             free(temp);
         }
     }
+    free(graph->adjList);
+    if (graph->mapping != NULL) {
+        munmap(graph->mapping, graph->mappingSize);
+    } else {
+        free(graph->offsets);
+        free(graph->destinations);
+        free(graph->weights);
+    }
     free(graph);
 }
 
-// Main function
-int main() {
+// Function to parse a decimal int (optionally signed) at *cursor after skipping blanks
+int parseInt(const char** cursor, const char* end, int* value) {
+    const char* p = *cursor;
+    while (p < end && (*p == ' ' || *p == '\t' || *p == '\r')) p++;
+
+    int negative = p < end && *p == '-';
+    if (negative) p++;
+    if (p == end || *p < '0' || *p > '9') return 0;
+
+    long long result = 0;
+    while (p < end && *p >= '0' && *p <= '9') {
+        result = result * 10 + (*p++ - '0');
+        if (result > (long long)INT_MAX + 1) return 0;
+    }
+    if (negative) result = -result;
+    if (result > INT_MAX) return 0;
+
+    *value = (int)result;
+    *cursor = p;
+    return 1;
+}
+
+// Function to check CSR arrays read from a file before they are indexed with: offsets start at
+// 0, never decrease and end at the edge count, and every destination is a vertex
+int validCsrArrays(const Graph* graph) {
+    int n = graph->numVertices, m = graph->numEdges;
+    int valid = graph->offsets[0] == 0 && graph->offsets[n] == m;
+    for (int u = 0; u < n && valid; u++) {
+        valid = graph->offsets[u] <= graph->offsets[u + 1];
+    }
+    for (int e = 0; e < m && valid; e++) {
+        valid = graph->destinations[e] >= 0 && graph->destinations[e] < n;
+    }
+    return valid;
+}
+
+// Function to read a binary graph: 4-int header (magic, version, vertices, edges), then
+// the CSR arrays offsets[V + 1], destinations[E] and weights[E]
+Graph* readBinaryGraph(const char* data, size_t size, const char* fileName) {
+    const int* header = (const int*)data;
+    if (size < GRAPH_BINARY_HEADER || header[1] != GRAPH_BINARY_VERSION || header[2] <= 0 || header[3] < 0
+        || size != GRAPH_BINARY_HEADER + ((size_t)header[2] + 1 + 2 * (size_t)header[3]) * sizeof(int)) {
+        printf("%s: unsupported version or truncated binary graph\n", fileName);
+        return NULL;
+    }
+
+    int n = header[2];
+    int m = header[3];
+    Graph* graph = createCsrGraph(n);
+    graph->numEdges = m;
+    graph->offsets = (int*)malloc((n + 1) * sizeof(int));
+    graph->destinations = (int*)malloc(m * sizeof(int));
+    graph->weights = (int*)malloc(m * sizeof(int));
+    memcpy(graph->offsets, header + 4, (n + 1) * sizeof(int));
+    memcpy(graph->destinations, header + 5 + n, m * sizeof(int));
+    memcpy(graph->weights, header + 5 + n + m, m * sizeof(int));
+
+    if (!validCsrArrays(graph)) {
+        printf("%s: corrupt binary graph\n", fileName);
+        freeGraph(graph);
+        return NULL;
+    }
+    return graph;
+}
+
+// Function to parse a DIMACS .gr file ("p sp n m", then "a u v w" with 1-based vertices)
+// or an edge list ("n m", then "u v w" with 0-based vertices); comment lines are skipped
+Graph* parseTextGraph(const char* data, size_t size, const char* fileName) {
+    const char* p = data;
+    const char* end = data + size;
+    int dimacs = -1, vertices = 0, edges = 0, count = 0, lineNumber = 0;
+    int* sources = NULL;
+    int* destinations = NULL;
+    int* weights = NULL;
+
+    while (p < end) {
+        const char* line = p;
+        const char* lineEnd = (const char*)memchr(p, '\n', end - p);
+        if (lineEnd == NULL) lineEnd = end;
+        p = lineEnd + 1;
+        lineNumber++;
+
+        while (line < lineEnd && (*line == ' ' || *line == '\t' || *line == '\r')) line++;
+        if (line == lineEnd || *line == 'c' || *line == '#') continue;
+
+        int ok;
+        if (dimacs < 0) {
+            // The first other line is the header
+            dimacs = *line == 'p';
+            if (dimacs) {
+                line++;
+                while (line < lineEnd && (*line == ' ' || *line == '\t')) line++;
+                ok = lineEnd - line >= 2 && line[0] == 's' && line[1] == 'p';
+                line += 2;
+            } else {
+                ok = 1;
+            }
+            ok = ok && parseInt(&line, lineEnd, &vertices) && parseInt(&line, lineEnd, &edges) && vertices > 0 && edges >= 0;
+            if (ok) {
+                sources = (int*)malloc(edges * sizeof(int));
+                destinations = (int*)malloc(edges * sizeof(int));
+                weights = (int*)malloc(edges * sizeof(int));
+            }
+        } else {
+            int u, v, w;
+            ok = (!dimacs || *line++ == 'a') && count < edges && parseInt(&line, lineEnd, &u)
+                 && parseInt(&line, lineEnd, &v) && parseInt(&line, lineEnd, &w);
+            if (ok && dimacs) {
+                u--;
+                v--;
+            }
+            ok = ok && u >= 0 && u < vertices && v >= 0 && v < vertices;
+            if (ok) {
+                sources[count] = u;
+                destinations[count] = v;
+                weights[count++] = w;
+            }
+        }
+        while (ok && line < lineEnd && (*line == ' ' || *line == '\t' || *line == '\r')) line++;
+
+        if (!ok || line != lineEnd) {
+            printf("%s:%d: malformed line\n", fileName, lineNumber);
+            free(sources);
+            free(destinations);
+            free(weights);
+            return NULL;
+        }
+    }
+
+    Graph* graph = NULL;
+    if (dimacs < 0) {
+        printf("%s: missing graph header\n", fileName);
+    } else if (count != edges) {
+        printf("%s: header announces %d edges but %d were read\n", fileName, edges, count);
+    } else {
+        graph = createGraphFromEdges(vertices, edges, sources, destinations, weights);
+    }
+    free(sources);
+    free(destinations);
+    free(weights);
+    return graph;
+}
+
+// Function to compute the FNV-1a checksum weighted_graph stores over every snapshot section
+unsigned long long snapshotChecksum(const char* data, const SnapshotHeader* header) {
+    unsigned long long hash = SNAPSHOT_CHECKSUM_SEED;
+    for (int s = 0; s < SNAPSHOT_SECTIONS; s++) {
+        const int* words = (const int*)(data + header->sections[s].offset);
+        for (long long i = 0; i < header->sections[s].count; i++) {
+            hash ^= (unsigned int)words[i];
+            hash *= 0x100000001b3ULL;
+        }
+    }
+    return hash;
+}
+
+// Function to use the graph of a mapped snapshot in place; the graph takes over the mapping.
+// The arrays are checked in one pass; verify also checks the stored checksum (all sections).
+Graph* openSnapshotGraph(char* data, size_t size, const char* fileName, int verify) {
+    const SnapshotHeader* header = (const SnapshotHeader*)data;
+    int n = header->numVertices;
+    int m = header->numEdges;
+    long long counts[3] = { (long long)n + 1, m, m };
+    int valid = size >= SNAPSHOT_PAGE && header->version == SNAPSHOT_VERSION && n > 0 && m >= 0;
+    for (int s = 0; s < 3 && valid; s++) {
+        valid = header->sections[s].count == counts[s] && header->sections[s].offset % SNAPSHOT_PAGE == 0
+             && header->sections[s].offset >= SNAPSHOT_PAGE
+             && (size_t)header->sections[s].offset + counts[s] * sizeof(int) <= size;
+    }
+    if (!valid) {
+        printf("%s: unsupported version or corrupt snapshot header\n", fileName);
+        munmap(data, size);
+        return NULL;
+    }
+
+    // The other sections belong to the hierarchy; the checksum covers them too
+    for (int s = 3; s < SNAPSHOT_SECTIONS && valid && verify; s++) {
+        valid = header->sections[s].count >= 0 && header->sections[s].offset >= 0
+             && (size_t)header->sections[s].offset + header->sections[s].count * sizeof(int) <= size;
+    }
+    if (!valid) {
+        printf("%s: unsupported version or corrupt snapshot header\n", fileName);
+        munmap(data, size);
+        return NULL;
+    }
+    if (verify && !(header->flags & SNAPSHOT_CHECKSUM)) {
+        printf("%s: no checksum stored, skipping verification\n", fileName);
+    } else if (verify && snapshotChecksum(data, header) != header->checksum) {
+        printf("%s: checksum mismatch\n", fileName);
+        munmap(data, size);
+        return NULL;
+    }
+
+    Graph* graph = createCsrGraph(n);
+    graph->numEdges = m;
+    graph->offsets = (int*)(data + header->sections[0].offset);
+    graph->destinations = (int*)(data + header->sections[1].offset);
+    graph->weights = (int*)(data + header->sections[2].offset);
+    graph->mapping = data;
+    graph->mappingSize = size;
+    if (!validCsrArrays(graph)) {
+        printf("%s: corrupt snapshot\n", fileName);
+        freeGraph(graph);
+        return NULL;
+    }
+    return graph;
+}
+
+// Function to load a graph file: binary graphs and snapshots are recognized by their magic
+// number, anything else is parsed as DIMACS or edge-list text. verify applies to snapshots.
+Graph* loadGraph(const char* fileName, int verify) {
+    int fd = open(fileName, O_RDONLY);
+    if (fd < 0) {
+        perror("Failed to open graph file");
+        return NULL;
+    }
+
+    struct stat info;
+    if (fstat(fd, &info) != 0 || info.st_size == 0) {
+        printf("%s: empty or unreadable graph file\n", fileName);
+        close(fd);
+        return NULL;
+    }
+
+    size_t size = info.st_size;
+    // Shared and read-only, so processes opening the same snapshot share its page-cache copy
+    char* data = (char*)mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        perror("Failed to map graph file");
+        return NULL;
+    }
+    if (size >= sizeof(int) && *(const int*)data == SNAPSHOT_MAGIC) {
+        return openSnapshotGraph(data, size, fileName, verify);
+    }
+    madvise(data, size, MADV_SEQUENTIAL);
+
+    Graph* graph;
+    if (size >= sizeof(int) && *(const int*)data == GRAPH_BINARY_MAGIC) {
+        graph = readBinaryGraph(data, size, fileName);
+    } else {
+        graph = parseTextGraph(data, size, fileName);
+    }
+
+    munmap(data, size);
+    return graph;
+}
+
+// Main function: dijkstra_bellman_ford [graph file [verify]], the graph is typed in when no file
+// is given; verify checks the checksum of a snapshot
+int main(int argc, char* argv[]) {
     int vertices, edges;
-    printf("Enter number of vertices: ");
-    scanf("%d", &vertices);
+    Graph* graph;
+
+    if (argc > 1) {
+        graph = loadGraph(argv[1], argc > 2 && strcmp(argv[2], "verify") == 0);
+        if (graph == NULL) {
+            return 1;
+        }
+        printf("Loaded %d vertices and %d edges from %s\n", graph->numVertices, graph->numEdges, argv[1]);
+    } else {
+        printf("Enter number of vertices: ");
+        scanf("%d", &vertices);
+        if (vertices <= 0) {
+            printf("Number of vertices must be positive\n");
+            return 1;
+        }
+
+        graph = createGraph(vertices);
 
-    Graph* graph = createGraph(vertices);
+        printf("Enter number of edges: ");
+        scanf("%d", &edges);
 
-    printf("Enter number of edges: ");
-    scanf("%d", &edges);
-    
-    printf("Enter edges (source destination weight):\n");
-    for (int i = 0; i < edges; i++) {
-        int src, dest, weight;
-        scanf("%d %d %d", &src, &dest, &weight);
-        addEdge(graph, src, dest, weight);
+        printf("Enter edges (source destination weight):\n");
+        for (int i = 0; i < edges; i++) {
+            int src, dest, weight;
+            scanf("%d %d %d", &src, &dest, &weight);
+            addEdge(graph, src, dest, weight);
+        }
+        finalizeGraph(graph);
+
+        // Draw the graph
+        drawGraph(graph);
     }
 
-    // Draw the graph
-    drawGraph(graph);
+    // One workspace serves every query on this graph
+    Workspace* ws = createWorkspace(graph->numVertices);
 
     int startVertex;
     printf("Enter starting vertex for Dijkstra's algorithm: ");
     scanf("%d", &startVertex);
-    Dijkstra(graph, startVertex);
+    if (startVertex >= 0 && startVertex < graph->numVertices) {
+        Dijkstra(graph, ws, startVertex);
+    } else {
+        printf("Invalid starting vertex %d\n", startVertex);
+    }
 
     printf("Enter starting vertex for Bellman-Ford algorithm: ");
     scanf("%d", &startVertex);
-    BellmanFord(graph, startVertex);
+    if (startVertex >= 0 && startVertex < graph->numVertices) {
+        BellmanFord(graph, ws, startVertex);
+    } else {
+        printf("Invalid starting vertex %d\n", startVertex);
+    }
 
+    freeWorkspace(ws);
     freeGraph(graph);
     return 0;
 }
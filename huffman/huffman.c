@@ -1,229 +1,2231 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <sys/wait.h>
+#include <sys/resource.h>
+#include <limits.h>
 
 #define MAX_TREE_NODES 256
+#define MAX_SYMBOLS 286
+#define TREE_SIZE (2 * MAX_SYMBOLS - 1)
+#define KEY_INDEX_BITS 9
+#define HUFFMAN_MAGIC "HUF4"
+#define STREAM_MAGIC "HUFS"
+#define BLOCK_SIZE (1 << 20)
+#define BLOCKS_PER_THREAD 4
+#define MAX_CODE_LENGTH 12
+#define DECODE_TABLE_SIZE (1 << MAX_CODE_LENGTH)
+#define DECODE_SYMBOLS 4
+#define LOOKUPS_PER_LOAD (57 / MAX_CODE_LENGTH)
+#define TABLE_BYTES (MAX_TREE_NODES / 2)
+#define HISTOGRAM_CHUNK ((size_t)1 << 30)
+#define PAGE_SIZE 4096
+#define MAX_WRITE_BUFFERS 1024
+#define STREAM_CHUNK (64 << 10)
+#define STREAM_WINDOW (256 << 10)
+#define STREAM_RAW 0x80000000u
+#define BLOCK_STORED 0
+#define BLOCK_HUFFMAN 1
+#define BLOCK_LZ 2
+#define BLOCK_HUFFMAN4 3
+#define JUMP_TABLE_BYTES 12
+#define MULTI_STREAM_MIN (16 << 10)
+#define LITERAL_CODES 286
+#define DISTANCE_CODES 40
+#define END_OF_BLOCK 256
+#define LZ_TABLE_BYTES ((LITERAL_CODES + DISTANCE_CODES) / 2)
+#define MIN_MATCH 3
+#define MAX_MATCH 258
+#define TOO_FAR 4096
+#define HASH_BITS 16
+#define MIN_WINDOW_BITS 10
+#define MAX_WINDOW_BITS 20
+#define DEFAULT_WINDOW_BITS 16
+#define MAX_LEVEL 9
+#define BENCH_DEFAULT_SIZE (4 << 20)
+#define BENCH_WORDS 2048
+#define BENCH_IMAGE_WIDTH 1024
 
-// Node structure for Huffman tree
-typedef struct Node {
-    char character;
-    int frequency;
-    struct Node *left;
-    struct Node *right;
-} Node;
+// Huffman tree in a fixed array, so building one allocates nothing. Entries below leaves are
+// the leaves in order of increasing frequency; the internal nodes follow in the order they were
+// created, which puts the root last. Nodes refer to their parent by index.
+typedef struct HuffmanTree {
+    uint64_t frequency[TREE_SIZE];
+    int parent[TREE_SIZE];
+    int symbol[MAX_SYMBOLS];
+    int leaves;
+    int size;
+} HuffmanTree;
 
-// Priority queue structure for Huffman coding
+// Priority queue of (frequency, index) pairs, each packed into one integer with the index in
+// the low KEY_INDEX_BITS bits: comparing two keys compares the frequencies and breaks ties by
+// index, without looking anything up
 typedef struct PriorityQueue {
-    Node *array[MAX_TREE_NODES];
+    uint64_t array[MAX_SYMBOLS];
     int size;
 } PriorityQueue;
 
+// Huffman code of one symbol: the low length bits of bits, sent most significant bit first
+typedef struct HuffmanCode {
+    uint64_t bits;
+    int length;
+} HuffmanCode;
+
+// Bit writer: codes are packed into a 64-bit accumulator, and every full word is stored
+// big-endian into a buffer large enough for the whole block
+typedef struct BitWriter {
+    unsigned char *buffer;
+    size_t used;
+    uint64_t accumulator;
+    int bits;
+} BitWriter;
+
+// Decode table entry for one MAX_CODE_LENGTH-bit window: the whole symbols the window holds
+// (up to DECODE_SYMBOLS, first symbol in the lowest byte), the bits they take together and the
+// bits of the first one. A length of 0 means no code starts with these bits.
+typedef struct DecodeEntry {
+    uint32_t symbols;
+    uint8_t count;
+    uint8_t length;
+    uint8_t firstLength;
+} DecodeEntry;
+
+// Decode table entry for one symbol of a large alphabet: the symbol whose code starts the
+// MAX_CODE_LENGTH-bit window and its code length (0 if no code starts with these bits)
+typedef struct CodeEntry {
+    uint16_t symbol;
+    uint8_t length;
+} CodeEntry;
+
+// Match search effort of one compression level: how many earlier positions with the same hash
+// are compared, the match length that ends the search, and up to which length the next
+// position is tried for a longer match (lazy matching, 0 takes every match at once); a quarter
+// of the chain is enough once the match to beat is goodLength long. Greedy levels do not index
+// the positions inside matches longer than maxInsert.
+typedef struct LevelParams {
+    int maxChain;
+    int niceLength;
+    int lazyLength;
+    int goodLength;
+    int maxInsert;
+} LevelParams;
+
+// Match finder state of one thread: the last position of every 3-byte hash, the previous
+// position with the same hash for every position of the window (a ring indexed by position
+// modulo the window size, so only the window is touched) and the block's tokens
+typedef struct MatchFinder {
+    int32_t head[1 << HASH_BITS];
+    int32_t *previous;
+    uint32_t *tokens;
+} MatchFinder;
+
+// Arguments of one worker thread
+typedef struct ThreadArgs {
+    int threadId;
+    int numThreads;
+    void *shared;
+} ThreadArgs;
+
+// A batch of consecutive blocks handed to the worker threads; each thread claims the next
+// block from nextBlock until none are left. Input blocks point into the mapped input or into
+// buffer; output blocks are outputStride bytes apart in one page-aligned allocation.
+typedef struct BlockBatch {
+    const unsigned char **input;
+    size_t *inputSize;
+    unsigned char *buffer;
+    unsigned char *output;
+    size_t outputStride;
+    size_t *outputSize;
+    int numBlocks;
+    int nextBlock;
+    int failed;
+    int level;
+    int windowBits;
+    MatchFinder **finders;
+} BlockBatch;
+
+// Statistics shared by the two ends of a stream: byte counts over the recent input, halved
+// whenever they exceed STREAM_WINDOW bytes, and the codes built from them for the next chunk.
+// Only the decompressor fills in the decode table, with buildDecodeTable() after each update.
+typedef struct StreamModel {
+    uint64_t counts[MAX_TREE_NODES];
+    uint64_t total;
+    int lengths[MAX_TREE_NODES];
+    HuffmanCode codes[MAX_TREE_NODES];
+    DecodeEntry table[DECODE_TABLE_SIZE];
+} StreamModel;
+
+// One benchmark run of the compress or decompress command: its output size (-1 on errors),
+// wall time, time stamp counter cycles and the peak resident set size of its process
+typedef struct BenchRun {
+    long long bytes;
+    double seconds;
+    uint64_t cycles;
+    long peakKb;
+} BenchRun;
+
+// Benchmark result of one input at one level
+typedef struct BenchResult {
+    const char *input;
+    long long bytes;
+    int level;
+    BenchRun compressed;
+    BenchRun restored;
+    int ok;
+} BenchResult;
+
 // Function prototypes for Huffman coding
-Node* createNode(char character, int frequency);
-PriorityQueue* createPriorityQueue();
-void insert(PriorityQueue *pq, Node *node);
-Node* extractMin(PriorityQueue *pq);
-void buildHuffmanTree(PriorityQueue *pq);
-void generateCodes(Node *root, char codes[MAX_TREE_NODES][MAX_TREE_NODES], char *code, int depth);
-void compressFile(const char *inputFile, const char *outputFile, char codes[MAX_TREE_NODES][MAX_TREE_NODES]);
-void decompressFile(const char *inputFile, const char *outputFile, Node *root);
-void freeTree(Node *root);
-void countFrequency(const char *inputFile, int frequency[MAX_TREE_NODES]);
+void insert(PriorityQueue *pq, uint64_t key);
+uint64_t extractMin(PriorityQueue *pq);
+void createLeaves(HuffmanTree *tree, const uint64_t frequency[], int numSymbols);
+void buildHuffmanTree(HuffmanTree *tree);
+void generateCodeLengths(const HuffmanTree *tree, int lengths[], int numSymbols);
+void limitCodeLengths(const uint64_t frequency[], int lengths[], int numSymbols, int maxLength);
+int assignCanonicalCodes(const int lengths[], HuffmanCode codes[], int numSymbols);
+int buildDecodeTable(const int lengths[MAX_TREE_NODES], DecodeEntry table[DECODE_TABLE_SIZE]);
+void buildCodeLengths(const uint64_t frequency[], int lengths[], int numSymbols);
+size_t compressBlock(const unsigned char *input, size_t size, unsigned char *output, int level, int windowBits,
+                     MatchFinder *finder);
+int decompressBlock(const unsigned char *block, size_t blockBytes, unsigned char *output, size_t size);
+long long compressFile(const char *inputFile, const char *outputFile, int numThreads, int level, int windowBits,
+                       long long *inputBytes);
+long long decompressFile(const char *inputFile, const char *outputFile, int numThreads, long long *inputBytes);
+long long readBlock(const char *inputFile, long long block, const char *outputFile);
+long long compressStream(const char *inputFile, const char *outputFile, long long *inputBytes);
+long long decompressStream(int in, const char *inputFile, const char *outputFile, long long *inputBytes);
+int runBenchmark(int argc, char *argv[]);
+MatchFinder* createMatchFinder();
+void freeMatchFinder(MatchFinder *finder);
+void countFrequency(const unsigned char *data, size_t size, uint64_t frequency[MAX_TREE_NODES]);
 int parent(int index);
+void initBitWriter(BitWriter *writer, unsigned char *buffer);
+void writeBits(BitWriter *writer, uint64_t value, int length);
+size_t finishBitWriter(BitWriter *writer);
+int defaultThreadCount();
+void runThreads(int numThreads, void *(*worker)(void *), void *shared);
+double currentTime();
 
 int main(int argc, char *argv[]) {
-    if (argc != 3) {
-        printf("Usage: %s <input_file> <output_file>\n", argv[0]);
-        return 1;
+    if (argc == 5 && strcmp(argv[1], "block") == 0) {
+        return readBlock(argv[2], atoll(argv[3]), argv[4]) < 0;
+    }
+    if (argc >= 2 && strcmp(argv[1], "bench") == 0) {
+        return runBenchmark(argc - 2, argv + 2);
     }
 
-    const char *inputFile = argv[1];
-    const char *outputFile = argv[2];
-
-    int frequency[MAX_TREE_NODES] = {0};
-    countFrequency(inputFile, frequency);
-
-    PriorityQueue *pq = createPriorityQueue();
-    for (int i = 0; i < MAX_TREE_NODES; i++) {
-        if (frequency[i] > 0) {
-            insert(pq, createNode(i, frequency[i]));
+    // Options come before the file names: -0 to -9 select the level, -w the window size
+    int level = 0, windowBits = DEFAULT_WINDOW_BITS, arg = 2, badOption = 0;
+    while (arg < argc && argv[arg][0] == '-' && argv[arg][1] != '\0' && !badOption) {
+        if (argv[arg][1] >= '0' && argv[arg][1] <= '9' && argv[arg][2] == '\0') {
+            level = argv[arg][1] - '0';
+        } else if (strcmp(argv[arg], "-w") == 0 && arg + 1 < argc) {
+            windowBits = atoi(argv[++arg]);
+        } else {
+            badOption = 1;
         }
+        arg++;
     }
+    badOption = badOption || windowBits < MIN_WINDOW_BITS || windowBits > MAX_WINDOW_BITS;
 
-    buildHuffmanTree(pq);
-    Node *root = extractMin(pq);
+    int stream = argc >= 2 && strcmp(argv[1], "stream") == 0;
+    int compress = stream || (argc >= 2 && strcmp(argv[1], "compress") == 0);
+    int decompress = argc >= 2 && strcmp(argv[1], "decompress") == 0;
+    int files = argc - arg;
+    if ((!compress && !decompress) || (files != 2 && files != 3) || badOption || (arg > 2 && (stream || decompress))) {
+        fprintf(stderr, "Usage: %s compress [-0..-9] [-w window_bits] <input_file> <output_file> [threads]\n", argv[0]);
+        fprintf(stderr, "       %s stream <input_file> <output_file>\n", argv[0]);
+        fprintf(stderr, "       %s decompress <input_file> <output_file> [threads]\n", argv[0]);
+        fprintf(stderr, "       %s block <compressed_file> <block> <output_file>\n", argv[0]);
+        fprintf(stderr, "       %s bench [-l levels] [-w window_bits] [-t threads] [-r repeats] [-s size]\n", argv[0]);
+        fprintf(stderr, "             [-j results.json] [-c results.csv] [file | @text | @random | @skewed | @image]...\n");
+        fprintf(stderr, "A file name of - means standard input or output. Levels 1 to 9 add LZ77 matching, with\n");
+        fprintf(stderr, "more search effort at higher levels (default 0: Huffman only); windows span 2^%d to 2^%d\n",
+                MIN_WINDOW_BITS, MAX_WINDOW_BITS);
+        fprintf(stderr, "bytes (default 2^%d).\n", DEFAULT_WINDOW_BITS);
+        return 1;
+    }
 
-    char codes[MAX_TREE_NODES][MAX_TREE_NODES] = {0};
-    generateCodes(root, codes, "", 0);
+    const char *inputFile = argv[arg];
+    const char *outputFile = argv[arg + 1];
+    int numThreads = files == 3 ? atoi(argv[arg + 2]) : defaultThreadCount();
+    if (numThreads < 1) numThreads = 1;
 
-    compressFile(inputFile, outputFile, codes);
-    decompressFile(outputFile, "decompressed.txt", root);
+    // The output may be standard output, so statistics go to standard error
+    long long inputBytes = 0;
+    double start = currentTime();
+    long long outputBytes;
+    if (stream) {
+        outputBytes = compressStream(inputFile, outputFile, &inputBytes);
+    } else if (compress) {
+        outputBytes = compressFile(inputFile, outputFile, numThreads, level, windowBits, &inputBytes);
+    } else {
+        outputBytes = decompressFile(inputFile, outputFile, numThreads, &inputBytes);
+    }
+    double elapsed = currentTime() - start;
+    if (outputBytes < 0) {
+        return 1;
+    }
 
-    // Clean up memory
-    freeTree(root);
-    free(pq);
+    long long original = compress ? inputBytes : outputBytes;
+    long long compressed = compress ? outputBytes : inputBytes;
+    fprintf(stderr, "Original size:   %lld bytes\n", original);
+    fprintf(stderr, "Compressed size: %lld bytes (ratio %.3f, %.1f%% saved)\n", compressed,
+            original > 0 ? (double)compressed / original : 0.0, original > 0 ? 100.0 * (original - compressed) / original : 0.0);
+    fprintf(stderr, "%-17s%.1f MB/s\n", compress ? "Compression:" : "Decompression:", original / 1e6 / (elapsed > 0 ? elapsed : 1e-9));
 
     return 0;
 }
 
-// Create a new node for the Huffman tree
-Node* createNode(char character, int frequency) {
-    Node *node = (Node *)malloc(sizeof(Node));
-    node->character = character;
-    node->frequency = frequency;
-    node->left = node->right = NULL;
-    return node;
-}
-
-// Create a priority queue
-PriorityQueue* createPriorityQueue() {
-    PriorityQueue *pq = (PriorityQueue *)malloc(sizeof(PriorityQueue));
-    pq->size = 0;
-    return pq;
-}
-
 // Calculate parent index in the priority queue
 int parent(int index) {
     return (index - 1) / 2;
 }
 
-// Insert a node into the priority queue
-void insert(PriorityQueue *pq, Node *node) {
-    pq->array[pq->size++] = node;
-    int index = pq->size - 1;
+// Insert a key into the priority queue
+void insert(PriorityQueue *pq, uint64_t key) {
+    int index = pq->size++;
 
-    // Bubble up the new node to maintain heap property
-    while (index > 0 && pq->array[parent(index)]->frequency > pq->array[index]->frequency) {
-        Node *temp = pq->array[parent(index)];
-        pq->array[parent(index)] = pq->array[index];
-        pq->array[index] = temp;
+    // Bubble up the new key to maintain heap property
+    while (index > 0 && pq->array[parent(index)] > key) {
+        pq->array[index] = pq->array[parent(index)];
         index = parent(index);
     }
+    pq->array[index] = key;
 }
 
-// Extract the minimum node from the priority queue
-Node* extractMin(PriorityQueue *pq) {
-    Node *minNode = pq->array[0];
-    pq->array[0] = pq->array[--pq->size];
+// Extract the minimum key from the priority queue
+uint64_t extractMin(PriorityQueue *pq) {
+    uint64_t minKey = pq->array[0];
+    uint64_t last = pq->array[--pq->size];
 
-    // Bubble down the root node to maintain heap property
+    // Bubble down the last key from the root to maintain heap property
     int index = 0;
-    while (index < pq->size) {
-        int left = 2 * index + 1;
-        int right = 2 * index + 2;
-        int smallest = index;
-
-        if (left < pq->size && pq->array[left]->frequency < pq->array[smallest]->frequency) {
-            smallest = left;
-        }
-        if (right < pq->size && pq->array[right]->frequency < pq->array[smallest]->frequency) {
-            smallest = right;
+    while (2 * index + 1 < pq->size) {
+        int smallest = 2 * index + 1;
+        if (smallest + 1 < pq->size && pq->array[smallest + 1] < pq->array[smallest]) {
+            smallest++;
         }
-        if (smallest == index) break;
+        if (pq->array[smallest] >= last) break;
 
-        Node *temp = pq->array[index];
         pq->array[index] = pq->array[smallest];
-        pq->array[smallest] = temp;
         index = smallest;
     }
+    pq->array[index] = last;
 
-    return minNode;
+    return minKey;
 }
 
-// Build the Huffman tree from the priority queue
-void buildHuffmanTree(PriorityQueue *pq) {
-    while (pq->size > 1) {
-        Node *left = extractMin(pq);
-        Node *right = extractMin(pq);
-        Node *parent = createNode('\0', left->frequency + right->frequency);
-        parent->left = left;
-        parent->right = right;
-        insert(pq, parent);
+// Put the symbols that occur into the tree as leaves, sorted by frequency through the priority
+// queue. Symbols are numbered from 0 to numSymbols - 1 (at most MAX_SYMBOLS).
+void createLeaves(HuffmanTree *tree, const uint64_t frequency[], int numSymbols) {
+    PriorityQueue pq;
+    pq.size = 0;
+    for (int c = 0; c < numSymbols; c++) {
+        if (frequency[c] > 0) {
+            insert(&pq, frequency[c] << KEY_INDEX_BITS | c);
+        }
+    }
+
+    tree->leaves = 0;
+    while (pq.size > 0) {
+        uint64_t key = extractMin(&pq);
+        tree->symbol[tree->leaves] = (int)(key & ((1 << KEY_INDEX_BITS) - 1));
+        tree->frequency[tree->leaves++] = key >> KEY_INDEX_BITS;
+    }
+    tree->size = tree->leaves;
+}
+
+// Index of the lighter of the next unused leaf and the next unused internal node
+static int takeSmallest(const HuffmanTree *tree, int *leaf, int *node) {
+    if (*leaf < tree->leaves && (*node == tree->size || tree->frequency[*leaf] <= tree->frequency[*node])) {
+        return (*leaf)++;
+    }
+    return (*node)++;
+}
+
+// Build the Huffman tree over sorted leaves in linear time (two-queue merge): internal nodes
+// are created in order of increasing frequency, so the two lightest nodes are always at the
+// front of either the leaves or the internal nodes
+void buildHuffmanTree(HuffmanTree *tree) {
+    int leaf = 0, node = tree->leaves;
+    while (tree->size < 2 * tree->leaves - 1) {
+        int left = takeSmallest(tree, &leaf, &node);
+        int right = takeSmallest(tree, &leaf, &node);
+        tree->frequency[tree->size] = tree->frequency[left] + tree->frequency[right];
+        tree->parent[left] = tree->parent[right] = tree->size;
+        tree->size++;
+    }
+}
+
+// Generate the Huffman code length of each symbol from its depth in the tree. A parent is
+// always created after its children, so one backward pass from the root finds every depth.
+void generateCodeLengths(const HuffmanTree *tree, int lengths[], int numSymbols) {
+    int depth[TREE_SIZE];
+    memset(lengths, 0, numSymbols * sizeof(int));
+    if (tree->leaves == 0) return;
+
+    depth[tree->size - 1] = 0;
+    for (int i = tree->size - 2; i >= 0; i--) {
+        depth[i] = depth[tree->parent[i]] + 1;
+    }
+
+    // A single distinct symbol still needs one bit
+    for (int i = 0; i < tree->leaves; i++) {
+        lengths[tree->symbol[i]] = depth[i] > 0 ? depth[i] : 1;
     }
 }
 
-// Generate Huffman codes for each character
-void generateCodes(Node *root, char codes[MAX_TREE_NODES][MAX_TREE_NODES], char *code, int depth) {
-    if (root->left == NULL && root->right == NULL) {
-        code[depth] = '\0';
-        strcpy(codes[(unsigned char)root->character], code);
+// Replace code lengths above maxLength by optimal length-limited ones (package-merge). Level
+// maxLength holds the symbols sorted by frequency; every higher level merges them with packages
+// of adjacent pairs from the level below. Taking the 2n - 2 cheapest items of level 1 and, for
+// each package taken, its two parts one level down, a symbol's code length is the number of
+// levels at which it was taken. Since symbols appear in frequency order at every level, the
+// symbols taken at a level are always the least frequent ones.
+void limitCodeLengths(const uint64_t frequency[], int lengths[], int numSymbols, int maxLength) {
+    int symbols[MAX_SYMBOLS];
+    int n = 0, longest = 0;
+    for (int c = 0; c < numSymbols; c++) {
+        if (lengths[c] > 0) {
+            symbols[n++] = c;
+            longest = lengths[c] > longest ? lengths[c] : longest;
+        }
+    }
+    if (longest <= maxLength || n < 2) return;
+
+    // Sort the symbols by increasing frequency
+    for (int i = 1; i < n; i++) {
+        int c = symbols[i], j = i;
+        while (j > 0 && frequency[symbols[j - 1]] > frequency[c]) {
+            symbols[j] = symbols[j - 1];
+            j--;
+        }
+        symbols[j] = c;
+    }
+
+    unsigned char isPackage[MAX_CODE_LENGTH + 1][2 * MAX_SYMBOLS];
+    uint64_t weights[2][2 * MAX_SYMBOLS];
+    int size[MAX_CODE_LENGTH + 1];
+    for (int i = 0; i < n; i++) {
+        weights[maxLength & 1][i] = frequency[symbols[i]];
+        isPackage[maxLength][i] = 0;
+    }
+    size[maxLength] = n;
+
+    for (int level = maxLength - 1; level >= 1; level--) {
+        uint64_t *below = weights[(level + 1) & 1];
+        uint64_t *merged = weights[level & 1];
+        int packages = size[level + 1] / 2;
+        int leaf = 0, package = 0, count = 0;
+        while (leaf < n || package < packages) {
+            uint64_t packageWeight = package < packages ? below[2 * package] + below[2 * package + 1] : UINT64_MAX;
+            if (leaf < n && frequency[symbols[leaf]] <= packageWeight) {
+                merged[count] = frequency[symbols[leaf++]];
+                isPackage[level][count++] = 0;
+            } else {
+                merged[count] = packageWeight;
+                isPackage[level][count++] = 1;
+                package++;
+            }
+        }
+        size[level] = count;
+    }
+
+    for (int i = 0; i < n; i++) {
+        lengths[symbols[i]] = 0;
+    }
+    int take = 2 * n - 2;
+    for (int level = 1; level <= maxLength && take > 0; level++) {
+        int leaves = 0, packages = 0;
+        for (int i = 0; i < take; i++) {
+            if (isPackage[level][i]) {
+                packages++;
+            } else {
+                lengths[symbols[leaves++]]++;
+            }
+        }
+        take = 2 * packages;
+    }
+}
+
+// Assign canonical codes: shorter codes first, equal lengths in symbol order. Returns 0 if the
+// lengths do not form a prefix code (more codes than a length can hold).
+int assignCanonicalCodes(const int lengths[], HuffmanCode codes[], int numSymbols) {
+    int count[MAX_CODE_LENGTH + 1] = {0};
+    uint64_t nextCode[MAX_CODE_LENGTH + 2];
+    for (int c = 0; c < numSymbols; c++) {
+        if (lengths[c] < 0 || lengths[c] > MAX_CODE_LENGTH) return 0;
+        count[lengths[c]]++;
+    }
+
+    uint64_t code = 0;
+    count[0] = 0;
+    for (int length = 1; length <= MAX_CODE_LENGTH; length++) {
+        code = (code + count[length - 1]) << 1;
+        nextCode[length] = code;
+    }
+    if (code + count[MAX_CODE_LENGTH] > DECODE_TABLE_SIZE) return 0;
+
+    for (int c = 0; c < numSymbols; c++) {
+        codes[c].length = lengths[c];
+        codes[c].bits = lengths[c] > 0 ? nextCode[lengths[c]]++ : 0;
+    }
+    return 1;
+}
+
+// Build the table that decodes every MAX_CODE_LENGTH-bit window at once: each window gets its
+// first symbol plus the further symbols that still lie completely inside the window. Returns 0
+// if the code lengths are invalid.
+int buildDecodeTable(const int lengths[MAX_TREE_NODES], DecodeEntry table[DECODE_TABLE_SIZE]) {
+    HuffmanCode codes[MAX_TREE_NODES];
+    if (!assignCanonicalCodes(lengths, codes, MAX_TREE_NODES)) return 0;
+
+    // First pass: the single symbol each window starts with
+    unsigned char symbol[DECODE_TABLE_SIZE];
+    unsigned char symbolLength[DECODE_TABLE_SIZE];
+    memset(symbolLength, 0, sizeof(symbolLength));
+    for (int c = 0; c < MAX_TREE_NODES; c++) {
+        if (codes[c].length == 0) continue;
+        int shift = MAX_CODE_LENGTH - codes[c].length;
+        for (int i = 0; i < 1 << shift; i++) {
+            symbol[(codes[c].bits << shift) + i] = (unsigned char)c;
+            symbolLength[(codes[c].bits << shift) + i] = (unsigned char)codes[c].length;
+        }
+    }
+
+    // Second pass: keep decoding the rest of the window, which is zero-padded, as long as the
+    // decoded code fits into the bits that are really there
+    for (int window = 0; window < DECODE_TABLE_SIZE; window++) {
+        DecodeEntry entry = {0, 0, 0, symbolLength[window]};
+        while (entry.count < DECODE_SYMBOLS) {
+            int next = (window << entry.length) & (DECODE_TABLE_SIZE - 1);
+            if (symbolLength[next] == 0 || symbolLength[next] > MAX_CODE_LENGTH - entry.length) break;
+            entry.symbols |= (uint32_t)symbol[next] << (8 * entry.count);
+            entry.count++;
+            entry.length += symbolLength[next];
+        }
+        table[window] = entry;
+    }
+    return 1;
+}
+
+// Start writing bits to buffer
+void initBitWriter(BitWriter *writer, unsigned char *buffer) {
+    writer->buffer = buffer;
+    writer->used = 0;
+    writer->accumulator = 0;
+    writer->bits = 0;
+}
+
+static void writeWord(BitWriter *writer, uint64_t word) {
+    for (int i = 0; i < 8; i++) {
+        writer->buffer[writer->used + i] = (unsigned char)(word >> (56 - 8 * i));
+    }
+    writer->used += 8;
+}
+
+// Append the low length bits of value (length <= 64), most significant first
+void writeBits(BitWriter *writer, uint64_t value, int length) {
+    int space = 64 - writer->bits;
+    if (length < space) {
+        writer->accumulator = (writer->accumulator << length) | value;
+        writer->bits += length;
         return;
     }
 
-    if (root->left) {
-        code[depth] = '0';
-        generateCodes(root->left, codes, code, depth + 1);
+    // The accumulator fills up: emit one word and keep the bits that did not fit
+    int rest = length - space;
+    uint64_t word = writer->bits == 0 ? value >> rest : (writer->accumulator << space) | (value >> rest);
+    writeWord(writer, word);
+    writer->accumulator = rest > 0 ? value & ((1ULL << rest) - 1) : 0;
+    writer->bits = rest;
+}
+
+// Pad the last byte with zero bits; returns the number of bytes written
+size_t finishBitWriter(BitWriter *writer) {
+    while (writer->bits > 0) {
+        int take = writer->bits >= 8 ? 8 : writer->bits;
+        writer->buffer[writer->used++] = (unsigned char)((writer->accumulator >> (writer->bits - take)) << (8 - take));
+        writer->bits -= take;
+    }
+    return writer->used;
+}
+
+// Load 8 bytes as a big-endian word
+static inline uint64_t loadWord(const unsigned char *data) {
+#if defined(__GNUC__) && defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    uint64_t word;
+    memcpy(&word, data, 8);
+    return __builtin_bswap64(word);
+#else
+    uint64_t word = 0;
+    for (int i = 0; i < 8; i++) {
+        word = (word << 8) | data[i];
+    }
+    return word;
+#endif
+}
+
+// One table lookup: store the symbols of the window at the top of *word (all DECODE_SYMBOLS
+// bytes, of which entry.count are valid) and consume their bits. Returns 0 if no code starts
+// there.
+static inline int decodeStep(const DecodeEntry table[DECODE_TABLE_SIZE], uint64_t *word, uint64_t *bit,
+                             unsigned char **out) {
+    DecodeEntry entry = table[*word >> (64 - MAX_CODE_LENGTH)];
+    (*out)[0] = (unsigned char)entry.symbols;
+    (*out)[1] = (unsigned char)(entry.symbols >> 8);
+    (*out)[2] = (unsigned char)(entry.symbols >> 16);
+    (*out)[3] = (unsigned char)(entry.symbols >> 24);
+    *out += entry.count;
+    *word <<= entry.length;
+    *bit += entry.length;
+    return entry.length != 0;
+}
+
+// Decode count symbols from the bitstream starting at bit *position. Each step looks up the
+// next MAX_CODE_LENGTH bits in the table and stores up to DECODE_SYMBOLS symbols at once, so
+// output needs DECODE_SYMBOLS bytes of slack; one 8-byte load serves LOOKUPS_PER_LOAD lookups,
+// as 57 bits are valid after a load. The data must be followed by 8 readable bytes. Returns 0
+// on bit patterns that are no code or on reading past endBit.
+static int decodeSymbols(const DecodeEntry table[DECODE_TABLE_SIZE], const unsigned char *data, uint64_t *position,
+                         uint64_t endBit, unsigned char *output, size_t count) {
+    uint64_t bit = *position;
+    unsigned char *out = output;
+    size_t margin = LOOKUPS_PER_LOAD * DECODE_SYMBOLS;
+    unsigned char *fastEnd = count >= margin ? output + count - margin : output;
+
+    while (out < fastEnd && bit <= endBit) {
+        uint64_t word = loadWord(data + (bit >> 3)) << (bit & 7);
+        for (int i = 0; i < LOOKUPS_PER_LOAD; i++) {
+            if (!decodeStep(table, &word, &bit, &out)) return 0;
+        }
+    }
+
+    // The last symbols one at a time, so that no more than count are decoded
+    while (out < output + count && bit <= endBit) {
+        uint64_t word = loadWord(data + (bit >> 3)) << (bit & 7);
+        DecodeEntry entry = table[word >> (64 - MAX_CODE_LENGTH)];
+        if (entry.length == 0) return 0;
+        *out++ = (unsigned char)entry.symbols;
+        bit += entry.firstLength;
+    }
+
+    *position = bit;
+    return out == output + count && bit <= endBit;
+}
+
+// Decode the four streams of a multi-stream block, stream k into the k-th quarter of output
+// (the last one takes the rest). The bit readers are independent, so the lookups of one stream
+// overlap with those of the others instead of each waiting for the one before it; every step
+// stays inside the stream's own quarter, so no stream overwrites the next. Once one stream
+// nears the end of its quarter, each finishes on its own. Every stream must be followed by 8
+// readable bytes. Returns 0 on invalid data.
+static int decodeFourStreams(const DecodeEntry table[DECODE_TABLE_SIZE], const unsigned char *data[4],
+                             const uint64_t endBit[4], unsigned char *output, size_t size) {
+    size_t segment = (size + 3) / 4;
+    size_t margin = LOOKUPS_PER_LOAD * DECODE_SYMBOLS;
+    if (size < 4 * margin) return 0;
+    uint64_t bit0 = 0, bit1 = 0, bit2 = 0, bit3 = 0;
+    unsigned char *out0 = output, *out1 = output + segment, *out2 = output + 2 * segment, *out3 = output + 3 * segment;
+    unsigned char *fast0 = out1 - margin, *fast1 = out2 - margin, *fast2 = out3 - margin, *fast3 = output + size - margin;
+
+    // An invalid window stops its stream without advancing it, which decodeSymbols() reports
+    // below; the round limit ends the loop if all four are stuck
+    size_t rounds = segment / LOOKUPS_PER_LOAD + 1;
+    while (rounds-- > 0 && out0 < fast0 && out1 < fast1 && out2 < fast2 && out3 < fast3
+           && bit0 <= endBit[0] && bit1 <= endBit[1] && bit2 <= endBit[2] && bit3 <= endBit[3]) {
+        uint64_t word0 = loadWord(data[0] + (bit0 >> 3)) << (bit0 & 7);
+        uint64_t word1 = loadWord(data[1] + (bit1 >> 3)) << (bit1 & 7);
+        uint64_t word2 = loadWord(data[2] + (bit2 >> 3)) << (bit2 & 7);
+        uint64_t word3 = loadWord(data[3] + (bit3 >> 3)) << (bit3 & 7);
+        for (int i = 0; i < LOOKUPS_PER_LOAD; i++) {
+            decodeStep(table, &word0, &bit0, &out0);
+            decodeStep(table, &word1, &bit1, &out1);
+            decodeStep(table, &word2, &bit2, &out2);
+            decodeStep(table, &word3, &bit3, &out3);
+        }
+    }
+
+    // Copied out, so that the bit positions above can stay in registers
+    uint64_t position[4] = { bit0, bit1, bit2, bit3 };
+    return decodeSymbols(table, data[0], &position[0], endBit[0], out0, output + segment - out0)
+        && decodeSymbols(table, data[1], &position[1], endBit[1], out1, output + 2 * segment - out1)
+        && decodeSymbols(table, data[2], &position[2], endBit[2], out2, output + 3 * segment - out2)
+        && decodeSymbols(table, data[3], &position[3], endBit[3], out3, output + size - out3);
+}
+
+static void writeStreamSize(unsigned char *output, uint32_t size) {
+    for (int i = 0; i < 4; i++) {
+        output[i] = (unsigned char)(size >> (8 * i));
+    }
+}
+
+static uint32_t readStreamSize(const unsigned char *input) {
+    return (uint32_t)input[0] | (uint32_t)input[1] << 8 | (uint32_t)input[2] << 16 | (uint32_t)input[3] << 24;
+}
+
+// Largest compressed block: the block type plus the block stored as it is
+static size_t maxCompressedBlock(size_t size) {
+    return 1 + size;
+}
+
+// Build Huffman code lengths for the counts of numSymbols symbols, limited to MAX_CODE_LENGTH
+// bits. Everything lives on the stack, so this does not allocate.
+void buildCodeLengths(const uint64_t frequency[], int lengths[], int numSymbols) {
+    HuffmanTree tree;
+    createLeaves(&tree, frequency, numSymbols);
+    buildHuffmanTree(&tree);
+    generateCodeLengths(&tree, lengths, numSymbols);
+    limitCodeLengths(frequency, lengths, numSymbols, MAX_CODE_LENGTH);
+}
+
+// Store the code lengths of an alphabet with an even number of symbols as 4-bit nibbles, high
+// nibble first
+static void packLengths(const int lengths[], int numSymbols, unsigned char *output) {
+    for (int c = 0; c < numSymbols; c += 2) {
+        output[c / 2] = (unsigned char)(lengths[c] << 4 | lengths[c + 1]);
+    }
+}
+
+// Read code lengths stored by packLengths(); returns the number of symbols that have a code
+static int unpackLengths(const unsigned char *input, int numSymbols, int lengths[]) {
+    int symbols = 0;
+    for (int c = 0; c < numSymbols; c += 2) {
+        lengths[c] = input[c / 2] >> 4;
+        lengths[c + 1] = input[c / 2] & 15;
+        symbols += (lengths[c] > 0) + (lengths[c + 1] > 0);
     }
-    if (root->right) {
-        code[depth] = '1';
-        generateCodes(root->right, codes, code, depth + 1);
+    return symbols;
+}
+
+// Build the table that decodes the first symbol of every MAX_CODE_LENGTH-bit window of an
+// alphabet too large for byte-sized DecodeEntry symbols. Returns 0 if the code lengths are
+// invalid.
+static int buildCodeTable(const int lengths[], int numSymbols, CodeEntry table[DECODE_TABLE_SIZE]) {
+    HuffmanCode codes[MAX_SYMBOLS];
+    if (!assignCanonicalCodes(lengths, codes, numSymbols)) return 0;
+
+    memset(table, 0, DECODE_TABLE_SIZE * sizeof(CodeEntry));
+    for (int c = 0; c < numSymbols; c++) {
+        if (codes[c].length == 0) continue;
+        int shift = MAX_CODE_LENGTH - codes[c].length;
+        for (int i = 0; i < 1 << shift; i++) {
+            table[(codes[c].bits << shift) + i].symbol = (uint16_t)c;
+            table[(codes[c].bits << shift) + i].length = (uint8_t)codes[c].length;
+        }
     }
+    return 1;
+}
+
+// Search effort per level, the same as zlib's; level 0 does no matching
+static const LevelParams levelParams[MAX_LEVEL + 1] = {
+    {0, 0, 0, 0, 0},
+    {4, 8, 0, 4, 4},
+    {8, 16, 0, 4, 5},
+    {32, 32, 0, 4, 6},
+    {16, 16, 4, 4, MAX_MATCH},
+    {32, 32, 16, 8, MAX_MATCH},
+    {128, 128, 16, 8, MAX_MATCH},
+    {256, 128, 32, 8, MAX_MATCH},
+    {1024, MAX_MATCH, 128, 32, MAX_MATCH},
+    {4096, MAX_MATCH, MAX_MATCH, 32, MAX_MATCH},
+};
+
+// Index of the highest set bit of a nonzero value
+static inline int highestBit(uint32_t value) {
+    return 31 - __builtin_clz(value);
+}
+
+// Literal/length symbol of a match length, as in deflate: lengths 3 to 10 have a symbol each,
+// every following group of four symbols covers twice as many lengths as the group before, told
+// apart by extra bits, and 258 has a symbol of its own
+static int lengthSymbol(int length) {
+    int value = length - MIN_MATCH;
+    if (value < 8) return END_OF_BLOCK + 1 + value;
+    if (length == MAX_MATCH) return LITERAL_CODES - 1;
+    int top = highestBit(value);
+    return END_OF_BLOCK + 1 + 4 * (top - 1) + ((value >> (top - 2)) & 3);
 }
 
-// Compress the input file using Huffman codes
-void compressFile(const char *inputFile, const char *outputFile, char codes[MAX_TREE_NODES][MAX_TREE_NODES]) {
-    FILE *in = fopen(inputFile, "r");
-    FILE *out = fopen(outputFile, "wb");
-    if (!in || !out) {
+static int lengthExtraBits(int symbol) {
+    int code = symbol - END_OF_BLOCK - 1;
+    return code < 8 || symbol == LITERAL_CODES - 1 ? 0 : code / 4 - 1;
+}
+
+static int lengthBase(int symbol) {
+    int code = symbol - END_OF_BLOCK - 1;
+    if (code < 8) return MIN_MATCH + code;
+    if (symbol == LITERAL_CODES - 1) return MAX_MATCH;
+    return MIN_MATCH + ((4 | (code & 3)) << (code / 4 - 1));
+}
+
+// Distance code, as in deflate but continued up to 2^20: distances 1 to 4 have a code each,
+// then two codes per power of two with extra bits for the rest
+static int distanceCode(uint32_t distance) {
+    uint32_t value = distance - 1;
+    if (value < 4) return value;
+    int top = highestBit(value);
+    return 2 * top + ((value >> (top - 1)) & 1);
+}
+
+static int distanceExtraBits(int code) {
+    return code < 4 ? 0 : code / 2 - 1;
+}
+
+static uint32_t distanceBase(int code) {
+    return code < 4 ? (uint32_t)code + 1 : ((2u | (code & 1)) << (code / 2 - 1)) + 1;
+}
+
+// Allocate the match finder of one thread; it is reused for every block the thread compresses
+MatchFinder* createMatchFinder() {
+    MatchFinder *finder = (MatchFinder *)malloc(sizeof(MatchFinder));
+    finder->previous = (int32_t *)malloc(((size_t)1 << MAX_WINDOW_BITS) * sizeof(int32_t));
+    finder->tokens = (uint32_t *)malloc(BLOCK_SIZE * sizeof(uint32_t));
+    return finder;
+}
+
+void freeMatchFinder(MatchFinder *finder) {
+    if (finder) {
+        free(finder->previous);
+        free(finder->tokens);
+        free(finder);
+    }
+}
+
+// Hash of the three bytes at data
+static inline uint32_t hashBytes(const unsigned char *data) {
+    uint32_t value = (uint32_t)data[0] << 16 | (uint32_t)data[1] << 8 | data[2];
+    return (value * 2654435761u) >> (32 - HASH_BITS);
+}
+
+// Number of equal bytes at a and b, at most limit
+static inline int matchLength(const unsigned char *a, const unsigned char *b, int limit) {
+    int length = 0;
+#if defined(__GNUC__) && defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    // Eight bytes at a time; the lowest differing bit is in the first differing byte
+    for (; length + 8 <= limit; length += 8) {
+        uint64_t x, y;
+        memcpy(&x, a + length, 8);
+        memcpy(&y, b + length, 8);
+        if (x != y) return length + (__builtin_ctzll(x ^ y) >> 3);
+    }
+#endif
+    while (length < limit && a[length] == b[length]) {
+        length++;
+    }
+    return length;
+}
+
+// Add the positions from *indexed up to end to the hash chains
+static inline void indexPositions(MatchFinder *finder, const unsigned char *input, size_t *indexed, size_t end,
+                                  size_t window) {
+    for (; *indexed < end; (*indexed)++) {
+        uint32_t hash = hashBytes(input + *indexed);
+        finder->previous[*indexed & (window - 1)] = finder->head[hash];
+        finder->head[hash] = (int32_t)*indexed;
+    }
+}
+
+// Longest match for position among the earlier positions with the same hash, following at most
+// chain links and stopping at niceLength. The positions before position must be indexed and
+// position itself not yet; it is indexed afterwards. A link is followed only from a position
+// inside the window, whose ring entry cannot have been overwritten yet. Returns the length and
+// sets *distance, or returns 0 if there is no match worth coding.
+static int findMatch(MatchFinder *finder, const unsigned char *input, size_t size, size_t position, size_t *indexed,
+                     const LevelParams *params, int chain, size_t window, uint32_t *distance) {
+    size_t indexEnd = size >= MIN_MATCH ? size - MIN_MATCH + 1 : 0;
+    indexPositions(finder, input, indexed, position < indexEnd ? position : indexEnd, window);
+
+    int limit = size - position < MAX_MATCH ? (int)(size - position) : MAX_MATCH;
+    int best = 0;
+    if (limit >= MIN_MATCH) {
+        const unsigned char *current = input + position;
+        best = MIN_MATCH - 1;
+        for (int32_t candidate = finder->head[hashBytes(current)]; candidate >= 0 && position - candidate <= window
+             && chain-- > 0; candidate = finder->previous[candidate & (window - 1)]) {
+            // Only a match that also agrees at the current best length can be longer
+            const unsigned char *match = input + candidate;
+            if (match[best] != current[best]) continue;
+
+            int length = matchLength(match, current, limit);
+            if (length > best) {
+                best = length;
+                *distance = (uint32_t)(position - candidate);
+                // Nothing can beat a match that reaches the end, and checking match[best] then
+                // would read past it
+                if (length >= params->niceLength || length == limit) break;
+            }
+        }
+
+        // A distant 3-byte match costs more bits than three literals
+        if (best < MIN_MATCH || (best == MIN_MATCH && *distance > TOO_FAR)) {
+            best = 0;
+        }
+    }
+
+    indexPositions(finder, input, indexed, position + 1 < indexEnd ? position + 1 : indexEnd, window);
+    return best;
+}
+
+// Split a block into literals and matches using hash chains over a window of window bytes;
+// returns the number of tokens. A literal token is the byte, a match token is
+// length << 20 | (distance - 1).
+static size_t findMatches(MatchFinder *finder, const unsigned char *input, size_t size, const LevelParams *params,
+                          size_t window) {
+    memset(finder->head, -1, sizeof(finder->head));
+    size_t position = 0, indexed = 0, numTokens = 0;
+
+    while (position < size) {
+        uint32_t distance = 0;
+        int length = findMatch(finder, input, size, position, &indexed, params, params->maxChain, window, &distance);
+
+        // Lazy matching: while the match is short, a longer one starting at the next byte
+        // turns this byte into a literal
+        while (length > 0 && length < params->lazyLength) {
+            uint32_t nextDistance = 0;
+            int chain = length >= params->goodLength ? params->maxChain / 4 : params->maxChain;
+            int nextLength = findMatch(finder, input, size, position + 1, &indexed, params, chain, window, &nextDistance);
+            if (nextLength <= length) break;
+            finder->tokens[numTokens++] = input[position++];
+            length = nextLength;
+            distance = nextDistance;
+        }
+
+        if (length == 0) {
+            finder->tokens[numTokens++] = input[position++];
+            continue;
+        }
+        finder->tokens[numTokens++] = (uint32_t)length << 20 | (distance - 1);
+        position += length;
+        if (length > params->maxInsert) {
+            indexed = position;
+        }
+    }
+    return numTokens;
+}
+
+// Compress a block as LZ77 tokens coded with two Huffman codes, one for literals, match lengths
+// and the end of the block and one for match distances: the block type, the code lengths of
+// both alphabets as nibbles (LZ_TABLE_BYTES), then the bitstream, in which every match length
+// and distance symbol is followed by its extra bits. Returns 0 without writing anything if the
+// result would not be smaller than limit bytes.
+static size_t compressLzBlock(const unsigned char *input, size_t size, unsigned char *output, size_t limit, int level,
+                              int windowBits, MatchFinder *finder) {
+    size_t numTokens = findMatches(finder, input, size, &levelParams[level], (size_t)1 << windowBits);
+
+    uint64_t literalFrequency[LITERAL_CODES] = {0};
+    uint64_t distanceFrequency[DISTANCE_CODES] = {0};
+    uint64_t bits = 0;
+    for (size_t i = 0; i < numTokens; i++) {
+        uint32_t token = finder->tokens[i];
+        if (token <= 255) {
+            literalFrequency[token]++;
+            continue;
+        }
+        int symbol = lengthSymbol(token >> 20);
+        int code = distanceCode((token & 0xfffff) + 1);
+        literalFrequency[symbol]++;
+        distanceFrequency[code]++;
+        bits += lengthExtraBits(symbol) + distanceExtraBits(code);
+    }
+    literalFrequency[END_OF_BLOCK] = 1;
+
+    int literalLengths[LITERAL_CODES], distanceLengths[DISTANCE_CODES];
+    HuffmanCode literalCodes[LITERAL_CODES], distanceCodes[DISTANCE_CODES];
+    buildCodeLengths(literalFrequency, literalLengths, LITERAL_CODES);
+    buildCodeLengths(distanceFrequency, distanceLengths, DISTANCE_CODES);
+    assignCanonicalCodes(literalLengths, literalCodes, LITERAL_CODES);
+    assignCanonicalCodes(distanceLengths, distanceCodes, DISTANCE_CODES);
+    for (int c = 0; c < LITERAL_CODES; c++) {
+        bits += literalFrequency[c] * literalCodes[c].length;
+    }
+    for (int c = 0; c < DISTANCE_CODES; c++) {
+        bits += distanceFrequency[c] * distanceCodes[c].length;
+    }
+    if (1 + LZ_TABLE_BYTES + (bits + 7) / 8 >= limit) return 0;
+
+    output[0] = BLOCK_LZ;
+    packLengths(literalLengths, LITERAL_CODES, output + 1);
+    packLengths(distanceLengths, DISTANCE_CODES, output + 1 + LITERAL_CODES / 2);
+    BitWriter writer;
+    initBitWriter(&writer, output + 1 + LZ_TABLE_BYTES);
+    for (size_t i = 0; i < numTokens; i++) {
+        uint32_t token = finder->tokens[i];
+        if (token <= 255) {
+            writeBits(&writer, literalCodes[token].bits, literalCodes[token].length);
+            continue;
+        }
+
+        // A whole match takes at most 47 bits, so it goes out in one write
+        int length = token >> 20;
+        uint32_t distance = (token & 0xfffff) + 1;
+        int symbol = lengthSymbol(length), code = distanceCode(distance);
+        int lengthExtra = lengthExtraBits(symbol), distanceExtra = distanceExtraBits(code);
+        uint64_t value = literalCodes[symbol].bits;
+        value = value << lengthExtra | (uint64_t)(length - lengthBase(symbol));
+        value = value << distanceCodes[code].length | distanceCodes[code].bits;
+        value = value << distanceExtra | (distance - distanceBase(code));
+        writeBits(&writer, value, literalCodes[symbol].length + lengthExtra + distanceCodes[code].length + distanceExtra);
+    }
+    writeBits(&writer, literalCodes[END_OF_BLOCK].bits, literalCodes[END_OF_BLOCK].length);
+    return 1 + LZ_TABLE_BYTES + finishBitWriter(&writer);
+}
+
+// Copy a match from distance bytes back; a match that overlaps its own output repeats
+static inline void copyMatch(unsigned char *out, size_t distance, size_t length) {
+    const unsigned char *from = out - distance;
+    size_t i = 0;
+    if (distance >= 8) {
+        for (; i + 8 <= length; i += 8) {
+            memcpy(out + i, from + i, 8);
+        }
+    }
+    for (; i < length; i++) {
+        out[i] = from[i];
+    }
+}
+
+// Decompress a block written by compressLzBlock() into size bytes; the block must be followed
+// by 8 readable bytes. Returns 0 if the block is corrupt.
+static int decompressLzBlock(const unsigned char *block, size_t blockBytes, unsigned char *output, size_t size) {
+    if (blockBytes < 1 + LZ_TABLE_BYTES) return 0;
+
+    int literalLengths[LITERAL_CODES], distanceLengths[DISTANCE_CODES];
+    CodeEntry literalTable[DECODE_TABLE_SIZE], distanceTable[DECODE_TABLE_SIZE];
+    unpackLengths(block + 1, LITERAL_CODES, literalLengths);
+    unpackLengths(block + 1 + LITERAL_CODES / 2, DISTANCE_CODES, distanceLengths);
+    if (!buildCodeTable(literalLengths, LITERAL_CODES, literalTable)
+        || !buildCodeTable(distanceLengths, DISTANCE_CODES, distanceTable)) return 0;
+
+    const unsigned char *data = block + 1 + LZ_TABLE_BYTES;
+    uint64_t bit = 0, endBit = (uint64_t)(blockBytes - 1 - LZ_TABLE_BYTES) * 8;
+    unsigned char *out = output, *end = output + size;
+    while (bit <= endBit) {
+        // 57 bits are valid after a load, enough for a whole match
+        uint64_t word = loadWord(data + (bit >> 3)) << (bit & 7);
+        CodeEntry entry = literalTable[word >> (64 - MAX_CODE_LENGTH)];
+        if (entry.length == 0) return 0;
+        word <<= entry.length;
+        bit += entry.length;
+        if (entry.symbol < END_OF_BLOCK) {
+            if (out == end) return 0;
+            *out++ = (unsigned char)entry.symbol;
+            continue;
+        }
+        if (entry.symbol == END_OF_BLOCK) {
+            return out == end && bit <= endBit;
+        }
+
+        int extra = lengthExtraBits(entry.symbol);
+        size_t length = lengthBase(entry.symbol) + (extra > 0 ? word >> (64 - extra) : 0);
+        word <<= extra;
+        bit += extra;
+        CodeEntry code = distanceTable[word >> (64 - MAX_CODE_LENGTH)];
+        if (code.length == 0) return 0;
+        word <<= code.length;
+        bit += code.length;
+        extra = distanceExtraBits(code.symbol);
+        size_t distance = distanceBase(code.symbol) + (extra > 0 ? word >> (64 - extra) : 0);
+        bit += extra;
+
+        if (distance > (size_t)(out - output) || length > (size_t)(end - out)) return 0;
+        copyMatch(out, distance, length);
+        out += length;
+    }
+    return 0;
+}
+
+// Compress one block into a block type byte and its payload. Huffman blocks hold the code
+// length of every byte value as 4-bit nibbles (TABLE_BYTES) and the bitstream of canonical
+// codes. Blocks of at least MULTI_STREAM_MIN bytes are split into four quarters coded as
+// separate bitstreams, which the decoder reads in parallel; a jump table of the byte sizes of
+// the first three (4 bytes each, little-endian) follows the code lengths. Levels above 0 also
+// try LZ77 matching over a window of 2^windowBits bytes, using the thread's finder; the block
+// keeps whichever of LZ77, Huffman only and the bytes stored as they are comes out smallest.
+// output must hold maxCompressedBlock(size) + 8 bytes; returns the number of bytes written.
+size_t compressBlock(const unsigned char *input, size_t size, unsigned char *output, int level, int windowBits,
+                     MatchFinder *finder) {
+    uint64_t frequency[MAX_TREE_NODES] = {0};
+    countFrequency(input, size, frequency);
+
+    // The codes are canonical, so the block only has to store the lengths
+    int lengths[MAX_TREE_NODES];
+    buildCodeLengths(frequency, lengths, MAX_TREE_NODES);
+    HuffmanCode codes[MAX_TREE_NODES];
+    assignCanonicalCodes(lengths, codes, MAX_TREE_NODES);
+
+    uint64_t bits = 0;
+    for (int c = 0; c < MAX_TREE_NODES; c++) {
+        bits += frequency[c] * codes[c].length;
+    }
+    // Four streams pad up to three more bytes than one
+    int multiStream = size >= MULTI_STREAM_MIN;
+    size_t huffmanBytes = 1 + TABLE_BYTES + (bits + 7) / 8 + (multiStream ? JUMP_TABLE_BYTES + 3 : 0);
+    size_t limit = huffmanBytes < 1 + size ? huffmanBytes : 1 + size;
+    if (level > 0) {
+        size_t lzBytes = compressLzBlock(input, size, output, limit, level, windowBits, finder);
+        if (lzBytes > 0) return lzBytes;
+    }
+    if (huffmanBytes >= 1 + size) {
+        output[0] = BLOCK_STORED;
+        memcpy(output + 1, input, size);
+        return 1 + size;
+    }
+
+    output[0] = multiStream ? BLOCK_HUFFMAN4 : BLOCK_HUFFMAN;
+    packLengths(lengths, MAX_TREE_NODES, output + 1);
+    int numStreams = multiStream ? 4 : 1;
+    size_t segment = (size + numStreams - 1) / numStreams;
+    size_t used = 1 + TABLE_BYTES + (multiStream ? JUMP_TABLE_BYTES : 0);
+    for (int k = 0; k < numStreams; k++) {
+        size_t end = k + 1 < numStreams ? (k + 1) * segment : size;
+        BitWriter writer;
+        initBitWriter(&writer, output + used);
+        for (size_t i = k * segment; i < end; i++) {
+            writeBits(&writer, codes[input[i]].bits, codes[input[i]].length);
+        }
+        size_t streamBytes = finishBitWriter(&writer);
+        if (k + 1 < numStreams) {
+            writeStreamSize(output + 1 + TABLE_BYTES + 4 * k, (uint32_t)streamBytes);
+        }
+        used += streamBytes;
+    }
+    return used;
+}
+
+// Decompress one block of size bytes written by compressBlock(); block must be followed by
+// 8 readable bytes and output needs DECODE_SYMBOLS bytes of slack. Returns 0 if the block is
+// corrupt.
+int decompressBlock(const unsigned char *block, size_t blockBytes, unsigned char *output, size_t size) {
+    if (blockBytes < 1) return 0;
+    if (block[0] == BLOCK_STORED) {
+        if (blockBytes - 1 != size) return 0;
+        memcpy(output, block + 1, size);
+        return 1;
+    }
+    if (block[0] == BLOCK_LZ) {
+        return decompressLzBlock(block, blockBytes, output, size);
+    }
+    int multiStream = block[0] == BLOCK_HUFFMAN4;
+    size_t headerBytes = 1 + TABLE_BYTES + (multiStream ? JUMP_TABLE_BYTES : 0);
+    if ((block[0] != BLOCK_HUFFMAN && !multiStream) || blockBytes < headerBytes) return 0;
+
+    int lengths[MAX_TREE_NODES];
+    unpackLengths(block + 1, MAX_TREE_NODES, lengths);
+    DecodeEntry table[DECODE_TABLE_SIZE];
+    if (!buildDecodeTable(lengths, table)) return 0;
+    if (!multiStream) {
+        uint64_t position = 0;
+        return decodeSymbols(table, block + headerBytes, &position, (uint64_t)(blockBytes - headerBytes) * 8, output, size);
+    }
+
+    // Streams 1 to 3 start where the jump table says the stream before them ends
+    const unsigned char *data[4];
+    uint64_t endBit[4];
+    size_t start = headerBytes;
+    for (int k = 0; k < 4; k++) {
+        size_t streamBytes = k < 3 ? readStreamSize(block + 1 + TABLE_BYTES + 4 * k) : blockBytes - start;
+        if (streamBytes > blockBytes - start) return 0;
+        data[k] = block + start;
+        endBit[k] = (uint64_t)streamBytes * 8;
+        start += streamBytes;
+    }
+    return decodeFourStreams(table, data, endBit, output, size);
+}
+
+static void* compressWorker(void *arg) {
+    ThreadArgs *args = (ThreadArgs *)arg;
+    BlockBatch *batch = (BlockBatch *)args->shared;
+
+    // Each thread keeps its match finder from batch to batch
+    MatchFinder *finder = NULL;
+    if (batch->level > 0) {
+        if (batch->finders[args->threadId] == NULL) {
+            batch->finders[args->threadId] = createMatchFinder();
+        }
+        finder = batch->finders[args->threadId];
+    }
+
+    int block;
+    while ((block = __atomic_fetch_add(&batch->nextBlock, 1, __ATOMIC_RELAXED)) < batch->numBlocks) {
+        batch->outputSize[block] = compressBlock(batch->input[block], batch->inputSize[block],
+                                                 batch->output + block * batch->outputStride, batch->level,
+                                                 batch->windowBits, finder);
+    }
+    return NULL;
+}
+
+static void* decompressWorker(void *arg) {
+    BlockBatch *batch = (BlockBatch *)((ThreadArgs *)arg)->shared;
+    int block;
+    while ((block = __atomic_fetch_add(&batch->nextBlock, 1, __ATOMIC_RELAXED)) < batch->numBlocks) {
+        if (!decompressBlock(batch->input[block], batch->inputSize[block],
+                             batch->output + block * batch->outputStride, batch->outputSize[block])) {
+            __atomic_store_n(&batch->failed, 1, __ATOMIC_RELAXED);
+        }
+    }
+    return NULL;
+}
+
+// A batch of numBlocks blocks; bufferStride > 0 also allocates a buffer for reading input blocks
+static BlockBatch* createBlockBatch(int numBlocks, size_t bufferStride, size_t outputBytes) {
+    BlockBatch *batch = (BlockBatch *)malloc(sizeof(BlockBatch));
+    void *output = NULL;
+    batch->outputStride = (outputBytes + PAGE_SIZE - 1) / PAGE_SIZE * PAGE_SIZE;
+    if (posix_memalign(&output, PAGE_SIZE, numBlocks * batch->outputStride) != 0) {
+        output = NULL;
+    }
+    batch->output = (unsigned char *)output;
+    batch->buffer = bufferStride > 0 ? (unsigned char *)malloc(numBlocks * bufferStride) : NULL;
+    batch->input = (const unsigned char **)malloc(numBlocks * sizeof(unsigned char *));
+    batch->inputSize = (size_t *)malloc(numBlocks * sizeof(size_t));
+    batch->outputSize = (size_t *)malloc(numBlocks * sizeof(size_t));
+    batch->numBlocks = 0;
+    batch->nextBlock = 0;
+    batch->failed = 0;
+    batch->level = 0;
+    batch->windowBits = DEFAULT_WINDOW_BITS;
+    batch->finders = NULL;
+    return batch;
+}
+
+static void freeBlockBatch(BlockBatch *batch) {
+    free(batch->input);
+    free(batch->buffer);
+    free(batch->output);
+    free(batch->inputSize);
+    free(batch->outputSize);
+    free(batch);
+}
+
+static void writeLength(unsigned char header[8], uint64_t length) {
+    for (int i = 0; i < 8; i++) {
+        header[i] = (unsigned char)(length >> (8 * i));
+    }
+}
+
+static uint64_t readLength(const unsigned char header[8]) {
+    uint64_t length = 0;
+    for (int i = 0; i < 8; i++) {
+        length |= (uint64_t)header[i] << (8 * i);
+    }
+    return length;
+}
+
+// True for a regular file that can be mapped; "-" is standard input or output
+static int isRegularFile(const char *fileName) {
+    struct stat info;
+    return strcmp(fileName, "-") != 0 && stat(fileName, &info) == 0 && S_ISREG(info.st_mode);
+}
+
+// Read fd up to its end into memory, after prefixLength bytes already read from it, followed by
+// 8 zero bytes; NULL on errors
+static unsigned char* readRemaining(int fd, const unsigned char *prefix, size_t prefixLength, size_t *size) {
+    size_t capacity = 1 << 20;
+    unsigned char *data = (unsigned char *)malloc(capacity + 8);
+    ssize_t count = 0;
+    memcpy(data, prefix, prefixLength);
+    *size = prefixLength;
+    while ((count = read(fd, data + *size, capacity - *size)) > 0) {
+        *size += count;
+        if (*size == capacity) {
+            capacity *= 2;
+            data = (unsigned char *)realloc(data, capacity + 8);
+        }
+    }
+    if (count < 0) {
+        perror("Failed to read input");
+        free(data);
+        return NULL;
+    }
+    memset(data + *size, 0, 8);
+    return data;
+}
+
+// Read up to length bytes, fewer only at the end of the input; -1 on errors
+static ssize_t readFully(int fd, unsigned char *buffer, size_t length) {
+    size_t done = 0;
+    while (done < length) {
+        ssize_t count = read(fd, buffer + done, length - done);
+        if (count < 0) return -1;
+        if (count == 0) break;
+        done += count;
+    }
+    return done;
+}
+
+// Map a regular file read-only with a sequential access hint, or read a pipe or standard input
+// into memory (followed by 8 zero bytes). *mapped tells which one to release. NULL on errors.
+static unsigned char* loadInput(const char *fileName, size_t *size, int *mapped) {
+    int fd = strcmp(fileName, "-") == 0 ? STDIN_FILENO : open(fileName, O_RDONLY);
+    if (fd < 0) {
         perror("Failed to open file");
-        return;
+        return NULL;
     }
 
-    int c;
-    while ((c = fgetc(in)) != EOF) {
-        fputs(codes[(unsigned char)c], out);
+    struct stat info;
+    *mapped = 0;
+    if (fstat(fd, &info) == 0 && S_ISREG(info.st_mode) && info.st_size > 0) {
+        *size = info.st_size;
+        unsigned char *data = (unsigned char *)mmap(NULL, *size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data != MAP_FAILED) {
+            madvise(data, *size, MADV_SEQUENTIAL);
+            if (fd != STDIN_FILENO) close(fd);
+            *mapped = 1;
+            return data;
+        }
     }
 
-    fclose(in);
-    fclose(out);
+    unsigned char *data = readRemaining(fd, NULL, 0, size);
+    if (fd != STDIN_FILENO) close(fd);
+    return data;
 }
 
-// Decompress the output file using the Huffman tree
-void decompressFile(const char *inputFile, const char *outputFile, Node *root) {
-    FILE *in = fopen(inputFile, "rb");
-    FILE *out = fopen(outputFile, "w");
-    if (!in || !out) {
+static void releaseInput(unsigned char *data, size_t size, int mapped) {
+    if (mapped) {
+        munmap(data, size);
+    } else {
+        free(data);
+    }
+}
+
+// Open the output file, or standard output for "-"; -1 (with a message) on errors
+static int openOutput(const char *fileName) {
+    int fd = strcmp(fileName, "-") == 0 ? STDOUT_FILENO : open(fileName, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
         perror("Failed to open file");
-        return;
     }
+    return fd;
+}
 
-    Node *current = root;
-    int bit;
-    while ((bit = fgetc(in)) != EOF) {
-        current = (bit == '0') ? current->left : current->right;
+static int closeOutput(int fd) {
+    return fd == STDOUT_FILENO || close(fd) == 0;
+}
 
-        // When we reach a leaf node, output the character
-        if (current->left == NULL && current->right == NULL) {
-            fputc(current->character, out);
-            current = root; // Go back to the root
+// Write all count buffers with as few writev() calls as possible, resuming after short writes;
+// returns 0 on errors
+static int writeBuffers(int fd, struct iovec *iov, int count) {
+    while (count > 0) {
+        ssize_t written = writev(fd, iov, count < MAX_WRITE_BUFFERS ? count : MAX_WRITE_BUFFERS);
+        if (written < 0) {
+            perror("Failed to write output");
+            return 0;
+        }
+        while (count > 0 && (size_t)written >= iov->iov_len) {
+            written -= iov->iov_len;
+            iov++;
+            count--;
+        }
+        if (count > 0) {
+            iov->iov_base = (char *)iov->iov_base + written;
+            iov->iov_len -= written;
         }
     }
+    return 1;
+}
 
-    fclose(in);
-    fclose(out);
+// Write the first count output blocks of a batch in one go
+static int writeBatch(int fd, BlockBatch *batch, int count) {
+    struct iovec *iov = (struct iovec *)malloc((count > 0 ? count : 1) * sizeof(struct iovec));
+    for (int b = 0; b < count; b++) {
+        iov[b].iov_base = batch->output + b * batch->outputStride;
+        iov[b].iov_len = batch->outputSize[b];
+    }
+    int ok = writeBuffers(fd, iov, count);
+    free(iov);
+    return ok;
 }
 
-// Free the memory allocated for the Huffman tree
-void freeTree(Node *root) {
-    if (root) {
-        freeTree(root->left);
-        freeTree(root->right);
-        free(root);
+// Compress the input file in independent blocks of BLOCK_SIZE bytes on numThreads threads, with
+// LZ77 matching at levels above 0 (see compressBlock()). The output is the magic "HUF4", the
+// blocks, then the block index: the end offset of every block (8 bytes, little-endian) followed
+// by the original length and the block count. Regular files are mapped and compressed in place;
+// pipes and standard input ("-") are read a batch of blocks at a time. Returns the compressed
+// size, or -1 on errors.
+long long compressFile(const char *inputFile, const char *outputFile, int numThreads, int level, int windowBits,
+                       long long *inputBytes) {
+    unsigned char *data = NULL;
+    size_t size = 0;
+    int mapped = 0;
+    FILE *in = NULL;
+    if (isRegularFile(inputFile)) {
+        data = loadInput(inputFile, &size, &mapped);
+        if (!data) return -1;
+    } else {
+        in = strcmp(inputFile, "-") == 0 ? stdin : fopen(inputFile, "rb");
+        if (!in) {
+            perror("Failed to open file");
+            return -1;
+        }
     }
+    int fd = openOutput(outputFile);
+    if (fd < 0) {
+        if (data) releaseInput(data, size, mapped);
+        if (in && in != stdin) fclose(in);
+        return -1;
+    }
+
+    // Blocks are compressed and written a batch at a time, so memory stays bounded
+    int batchBlocks = numThreads * BLOCKS_PER_THREAD;
+    BlockBatch *batch = createBlockBatch(batchBlocks, in ? BLOCK_SIZE : 0, maxCompressedBlock(BLOCK_SIZE) + 8);
+    batch->level = level;
+    batch->windowBits = windowBits;
+    batch->finders = (MatchFinder **)calloc(numThreads, sizeof(MatchFinder *));
+    uint64_t *index = NULL;
+    size_t numBlocks = 0, capacity = 0;
+    uint64_t offset = 4, length = 0;
+    struct iovec magic = { (void *)HUFFMAN_MAGIC, 4 };
+    int ok = batch->output != NULL && writeBuffers(fd, &magic, 1);
+
+    while (ok) {
+        batch->numBlocks = 0;
+        batch->nextBlock = 0;
+        while (batch->numBlocks < batchBlocks) {
+            size_t count;
+            if (in) {
+                unsigned char *buffer = batch->buffer + (size_t)batch->numBlocks * BLOCK_SIZE;
+                count = fread(buffer, 1, BLOCK_SIZE, in);
+                batch->input[batch->numBlocks] = buffer;
+            } else {
+                count = size - length < BLOCK_SIZE ? size - length : BLOCK_SIZE;
+                batch->input[batch->numBlocks] = data + length;
+            }
+            if (count == 0) break;
+            batch->inputSize[batch->numBlocks++] = count;
+            length += count;
+        }
+        runThreads(numThreads < batch->numBlocks ? numThreads : batch->numBlocks, compressWorker, batch);
+        ok = writeBatch(fd, batch, batch->numBlocks);
+
+        for (int b = 0; b < batch->numBlocks; b++) {
+            if (numBlocks == capacity) {
+                capacity = capacity ? capacity * 2 : 64;
+                index = (uint64_t *)realloc(index, capacity * sizeof(uint64_t));
+            }
+            offset += batch->outputSize[b];
+            index[numBlocks++] = offset;
+        }
+        if (batch->numBlocks < batchBlocks) break;
+    }
+
+    unsigned char *trailer = (unsigned char *)malloc(8 * numBlocks + 16);
+    for (size_t b = 0; b < numBlocks; b++) {
+        writeLength(trailer + 8 * b, index[b]);
+    }
+    writeLength(trailer + 8 * numBlocks, length);
+    writeLength(trailer + 8 * numBlocks + 8, numBlocks);
+    struct iovec iov = { trailer, 8 * numBlocks + 16 };
+    ok = ok && writeBuffers(fd, &iov, 1) && !(in && ferror(in));
+
+    if (!closeOutput(fd) || !ok) {
+        fprintf(stderr, "Failed to write %s\n", outputFile);
+        ok = 0;
+    }
+    if (data) releaseInput(data, size, mapped);
+    if (in && in != stdin) fclose(in);
+    for (int t = 0; t < numThreads; t++) {
+        freeMatchFinder(batch->finders[t]);
+    }
+    free(batch->finders);
+    freeBlockBatch(batch);
+    free(index);
+    free(trailer);
+    *inputBytes = length;
+    return ok ? (long long)(offset + 8 * numBlocks + 16) : -1;
 }
 
-// Count the frequency of each character in the input file
-void countFrequency(const char *inputFile, int frequency[MAX_TREE_NODES]) {
-    FILE *file = fopen(inputFile, "r");
-    if (!file) {
+// Block index of a compressed file: the end offset of every block
+typedef struct BlockIndex {
+    uint64_t *end;
+    uint64_t numBlocks;
+    uint64_t length;
+} BlockIndex;
+
+// Check the magic and trailer of a compressed file of size bytes and read its block index;
+// 0 if it is not a valid compressed file
+static int readBlockIndex(const unsigned char *data, uint64_t size, BlockIndex *index) {
+    index->end = NULL;
+    if (size < 20 || memcmp(data, HUFFMAN_MAGIC, 4) != 0) return 0;
+    index->length = readLength(data + size - 16);
+    index->numBlocks = readLength(data + size - 8);
+    if (index->numBlocks != (index->length + BLOCK_SIZE - 1) / BLOCK_SIZE || index->numBlocks > (size - 20) / 8) return 0;
+
+    uint64_t indexStart = size - 16 - 8 * index->numBlocks;
+    index->end = (uint64_t *)malloc(sizeof(uint64_t) * (index->numBlocks + 1));
+    uint64_t previous = 4;
+    for (uint64_t b = 0; b < index->numBlocks; b++) {
+        index->end[b] = readLength(data + indexStart + 8 * b);
+        if (index->end[b] < previous + 1 || index->end[b] > indexStart
+            || index->end[b] - previous > maxCompressedBlock(BLOCK_SIZE)) return 0;
+        previous = index->end[b];
+    }
+    return previous == indexStart;
+}
+
+// Start offset of a block in the file
+static uint64_t blockStart(const BlockIndex *index, uint64_t block) {
+    return block == 0 ? 4 : index->end[block - 1];
+}
+
+// Original size of a block
+static size_t blockLength(const BlockIndex *index, uint64_t block) {
+    return block + 1 < index->numBlocks ? BLOCK_SIZE : index->length - block * (uint64_t)BLOCK_SIZE;
+}
+
+// Load a compressed file and read its block index; NULL (with a message) on errors
+static unsigned char* openCompressedFile(const char *inputFile, size_t *size, int *mapped, BlockIndex *index) {
+    unsigned char *data = loadInput(inputFile, size, mapped);
+    if (data && !readBlockIndex(data, *size, index)) {
+        fprintf(stderr, "%s: not a compressed file or corrupt block index\n", inputFile);
+        free(index->end);
+        releaseInput(data, *size, *mapped);
+        return NULL;
+    }
+    return data;
+}
+
+// Decompress a file written by compressFile(), numThreads blocks at a time. The blocks are
+// decoded straight from the mapped file; a batch of them is written with one writev() call.
+// Returns the decompressed size, or -1 if the input is not a valid compressed file.
+long long decompressFile(const char *inputFile, const char *outputFile, int numThreads, long long *inputBytes) {
+    // Streams are recognized by their magic and decoded as they are read
+    unsigned char magic[4];
+    int in = strcmp(inputFile, "-") == 0 ? STDIN_FILENO : open(inputFile, O_RDONLY);
+    ssize_t got = in >= 0 ? readFully(in, magic, 4) : -1;
+    if (got == 4 && memcmp(magic, STREAM_MAGIC, 4) == 0) {
+        long long length = decompressStream(in, inputFile, outputFile, inputBytes);
+        if (in != STDIN_FILENO) close(in);
+        return length;
+    }
+    if (got < 0) {
+        perror("Failed to read input");
+        if (in > STDIN_FILENO) close(in);
+        return -1;
+    }
+
+    // Block files are mapped again from the start; a pipe is read to its end
+    BlockIndex index;
+    size_t size;
+    int mapped = 0;
+    unsigned char *data;
+    if (!isRegularFile(inputFile)) {
+        data = readRemaining(in, magic, got, &size);
+        if (in != STDIN_FILENO) close(in);
+        if (data && !readBlockIndex(data, size, &index)) {
+            fprintf(stderr, "%s: not a compressed file or corrupt block index\n", inputFile);
+            free(index.end);
+            free(data);
+            data = NULL;
+        }
+    } else {
+        close(in);
+        data = openCompressedFile(inputFile, &size, &mapped, &index);
+    }
+    if (!data) return -1;
+    *inputBytes = size;
+    int fd = openOutput(outputFile);
+    if (fd < 0) {
+        free(index.end);
+        releaseInput(data, size, mapped);
+        return -1;
+    }
+
+    // The trailer behind the last block provides the 8 readable bytes the decoder needs
+    int batchBlocks = numThreads * BLOCKS_PER_THREAD;
+    BlockBatch *batch = createBlockBatch(batchBlocks, 0, BLOCK_SIZE + DECODE_SYMBOLS);
+    int valid = batch->output != NULL, ok = 1;
+    for (uint64_t first = 0; first < index.numBlocks && valid && ok; first += batchBlocks) {
+        batch->numBlocks = index.numBlocks - first < (uint64_t)batchBlocks ? (int)(index.numBlocks - first) : batchBlocks;
+        batch->nextBlock = 0;
+        for (int b = 0; b < batch->numBlocks; b++) {
+            batch->input[b] = data + blockStart(&index, first + b);
+            batch->inputSize[b] = index.end[first + b] - blockStart(&index, first + b);
+            batch->outputSize[b] = blockLength(&index, first + b);
+        }
+
+        runThreads(numThreads < batch->numBlocks ? numThreads : batch->numBlocks, decompressWorker, batch);
+        valid = !batch->failed;
+        ok = valid && writeBatch(fd, batch, batch->numBlocks);
+    }
+    if (!valid) {
+        fprintf(stderr, "%s: corrupt compressed data\n", inputFile);
+    }
+
+    if (!closeOutput(fd)) {
+        ok = 0;
+    }
+    freeBlockBatch(batch);
+    free(index.end);
+    releaseInput(data, size, mapped);
+    return valid && ok ? (long long)index.length : -1;
+}
+
+// Decompress only the given block of a compressed file. The file is mapped, so nothing but the
+// block index and that block is read. Returns the block's size, or -1 on errors.
+long long readBlock(const char *inputFile, long long block, const char *outputFile) {
+    BlockIndex index;
+    size_t size;
+    int mapped;
+    unsigned char *data = openCompressedFile(inputFile, &size, &mapped, &index);
+    if (!data) return -1;
+    if (block < 0 || (uint64_t)block >= index.numBlocks) {
+        fprintf(stderr, "%s has %llu blocks\n", inputFile, (unsigned long long)index.numBlocks);
+        free(index.end);
+        releaseInput(data, size, mapped);
+        return -1;
+    }
+
+    size_t length = blockLength(&index, block);
+    unsigned char *output = (unsigned char *)malloc(length + DECODE_SYMBOLS);
+    int valid = decompressBlock(data + blockStart(&index, block), index.end[block] - blockStart(&index, block), output, length);
+    int ok = 0;
+    if (!valid) {
+        fprintf(stderr, "%s: corrupt compressed data\n", inputFile);
+    } else {
+        int fd = openOutput(outputFile);
+        struct iovec iov = { output, length };
+        ok = fd >= 0 && writeBuffers(fd, &iov, 1);
+        ok = fd >= 0 && closeOutput(fd) && ok;
+    }
+    free(output);
+    free(index.end);
+    releaseInput(data, size, mapped);
+    return ok ? (long long)length : -1;
+}
+
+// Start a stream with no statistics: every byte value gets an 8-bit code
+static void initStreamModel(StreamModel *model) {
+    memset(model->counts, 0, sizeof(model->counts));
+    model->total = 0;
+    for (int c = 0; c < MAX_TREE_NODES; c++) {
+        model->lengths[c] = 8;
+    }
+    assignCanonicalCodes(model->lengths, model->codes, MAX_TREE_NODES);
+}
+
+// Add a chunk to the statistics and build the codes for the next chunk. Every count is one
+// more than observed, so byte values that did not occur recently stay codable.
+static void updateStreamModel(StreamModel *model, const unsigned char *data, size_t size) {
+    countFrequency(data, size, model->counts);
+    model->total += size;
+    while (model->total > STREAM_WINDOW) {
+        model->total = 0;
+        for (int c = 0; c < MAX_TREE_NODES; c++) {
+            model->counts[c] /= 2;
+            model->total += model->counts[c];
+        }
+    }
+
+    uint64_t frequency[MAX_TREE_NODES];
+    for (int c = 0; c < MAX_TREE_NODES; c++) {
+        frequency[c] = model->counts[c] + 1;
+    }
+    buildCodeLengths(frequency, model->lengths, MAX_TREE_NODES);
+    assignCanonicalCodes(model->lengths, model->codes, MAX_TREE_NODES);
+}
+
+// Compress a stream chunk by chunk in a single pass. Each chunk is whatever one read returns
+// (at most STREAM_CHUNK bytes), so data from a pipe goes out as soon as it arrives. A chunk is
+// coded with the codes built from the chunks before it, which the decoder rebuilds the same
+// way, so no code tables are sent. The output is the magic "HUFS" and a frame per chunk: the
+// chunk length (4 bytes, little-endian, top bit set if the chunk is stored as it is), the
+// payload size (4 bytes) and the payload; a frame of length 0 ends the stream. Memory stays
+// bounded by one chunk. Returns the compressed size, or -1 on errors.
+long long compressStream(const char *inputFile, const char *outputFile, long long *inputBytes) {
+    int in = strcmp(inputFile, "-") == 0 ? STDIN_FILENO : open(inputFile, O_RDONLY);
+    if (in < 0) {
         perror("Failed to open file");
-        return;
+        return -1;
     }
+    int out = openOutput(outputFile);
+    if (out < 0) {
+        if (in != STDIN_FILENO) close(in);
+        return -1;
+    }
+
+    StreamModel *model = (StreamModel *)malloc(sizeof(StreamModel));
+    initStreamModel(model);
+    unsigned char *chunk = (unsigned char *)malloc(STREAM_CHUNK);
+    unsigned char *payload = (unsigned char *)malloc(STREAM_CHUNK * MAX_CODE_LENGTH / 8 + 16);
+    unsigned char header[8];
+    uint64_t written = 4;
+    *inputBytes = 0;
+
+    struct iovec magic = { (void *)STREAM_MAGIC, 4 };
+    int ok = writeBuffers(out, &magic, 1);
+    ssize_t count = 0;
+    while (ok && (count = read(in, chunk, STREAM_CHUNK)) > 0) {
+        BitWriter writer;
+        initBitWriter(&writer, payload);
+        for (ssize_t i = 0; i < count; i++) {
+            writeBits(&writer, model->codes[chunk[i]].bits, model->codes[chunk[i]].length);
+        }
+        size_t payloadBytes = finishBitWriter(&writer);
+        int raw = payloadBytes >= (size_t)count;
+
+        struct iovec iov[2] = { { header, 8 }, { raw ? chunk : payload, raw ? (size_t)count : payloadBytes } };
+        writeLength(header, (uint64_t)count | (raw ? STREAM_RAW : 0) | (uint64_t)iov[1].iov_len << 32);
+        ok = writeBuffers(out, iov, 2);
+        written += 8 + iov[1].iov_len;
+        *inputBytes += count;
+        updateStreamModel(model, chunk, count);
+    }
+    if (count < 0) {
+        perror("Failed to read input");
+        ok = 0;
+    }
+
+    memset(header, 0, 8);
+    struct iovec end = { header, 8 };
+    ok = ok && writeBuffers(out, &end, 1);
+    written += 8;
+    if (!closeOutput(out) || !ok) {
+        fprintf(stderr, "Failed to write %s\n", outputFile);
+        ok = 0;
+    }
+    if (in != STDIN_FILENO) close(in);
+    free(model);
+    free(chunk);
+    free(payload);
+    return ok ? (long long)written : -1;
+}
+
+// Decode a stream written by compressStream() frame by frame as it is read from in, after its
+// magic; each chunk is written out as soon as it is decoded. Returns the decompressed size, or
+// -1 if the stream is corrupt or truncated.
+long long decompressStream(int in, const char *inputFile, const char *outputFile, long long *inputBytes) {
+    int out = openOutput(outputFile);
+    if (out < 0) return -1;
+
+    StreamModel *model = (StreamModel *)malloc(sizeof(StreamModel));
+    initStreamModel(model);
+    buildDecodeTable(model->lengths, model->table);
+    unsigned char *chunk = (unsigned char *)malloc(STREAM_CHUNK + DECODE_SYMBOLS);
+    unsigned char *payload = (unsigned char *)malloc(STREAM_CHUNK * MAX_CODE_LENGTH / 8 + 16);
+    unsigned char header[8];
+    long long length = 0;
+    int valid = 0, ok = 1;
+    *inputBytes = 4;
+
+    while (ok && readFully(in, header, 8) == 8) {
+        uint64_t field = readLength(header) & 0xffffffffu;
+        size_t count = field & ~STREAM_RAW;
+        size_t payloadBytes = (readLength(header) >> 32) & 0xffffffffu;
+        int raw = (field & STREAM_RAW) != 0;
+        *inputBytes += 8 + payloadBytes;
+        if (count == 0) {
+            valid = payloadBytes == 0 && !raw;
+            break;
+        }
+
+        if (count > STREAM_CHUNK || payloadBytes > STREAM_CHUNK * MAX_CODE_LENGTH / 8 + 8 || (raw && payloadBytes != count)
+            || readFully(in, raw ? chunk : payload, payloadBytes) != (ssize_t)payloadBytes) break;
+        if (!raw) {
+            uint64_t position = 0;
+            memset(payload + payloadBytes, 0, 8);
+            if (!decodeSymbols(model->table, payload, &position, (uint64_t)payloadBytes * 8, chunk, count)) break;
+        }
 
-    int c;
-    while ((c = fgetc(file)) != EOF) {
-        frequency[c]++;
+        struct iovec iov = { chunk, count };
+        ok = writeBuffers(out, &iov, 1);
+        length += count;
+        updateStreamModel(model, chunk, count);
+        buildDecodeTable(model->lengths, model->table);
     }
+    if (!valid && ok) {
+        fprintf(stderr, "%s: corrupt or truncated stream\n", inputFile);
+    }
+
+    if (!closeOutput(out)) {
+        ok = 0;
+    }
+    free(model);
+    free(chunk);
+    free(payload);
+    return valid && ok ? length : -1;
+}
+
+// Next pseudo-random number of a benchmark input (xorshift64*), so every build generates the
+// same corpus
+static uint64_t nextRandom(uint64_t *state) {
+    *state ^= *state >> 12;
+    *state ^= *state << 25;
+    *state ^= *state >> 27;
+    return *state * 0x2545F4914F6CDD1DULL;
+}
+
+// English-like text: words drawn from a made-up vocabulary with a few common words much more
+// frequent than the rest, in sentences and lines of about 70 characters
+static void generateText(unsigned char *output, size_t size, uint64_t *state) {
+    static const char *syllables[] = {"the", "an", "re", "in", "er", "on", "at", "en", "es", "or", "ti", "ed",
+                                      "is", "al", "ar", "st", "to", "nt", "ng", "se", "ha", "ou", "io", "le"};
+    char words[BENCH_WORDS][16];
+    for (int w = 0; w < BENCH_WORDS; w++) {
+        int parts = 1 + (int)(nextRandom(state) % 3), length = 0;
+        for (int p = 0; p < parts; p++) {
+            length += sprintf(words[w] + length, "%s", syllables[nextRandom(state) % 24]);
+        }
+    }
+
+    size_t i = 0, line = 0;
+    int capital = 1;
+    while (i < size) {
+        // The product of two uniform ranks favours the first words of the vocabulary
+        uint64_t r = nextRandom(state);
+        const char *word = words[((r & 0xFFFF) * ((r >> 16) & 0xFFFF) >> 16) * BENCH_WORDS >> 16];
+        for (int c = 0; word[c] != '\0' && i < size; c++, line++) {
+            output[i++] = capital && c == 0 ? word[c] - 'a' + 'A' : word[c];
+        }
+        capital = (r >> 40) % 12 == 0;
+        const char *separator = capital ? "." : (r >> 48) % 9 == 0 ? "," : "";
+        for (int c = 0; separator[c] != '\0' && i < size; c++, line++) {
+            output[i++] = separator[c];
+        }
+        if (i < size) {
+            output[i++] = line > 70 ? '\n' : ' ';
+            line = line > 70 ? 0 : line + 1;
+        }
+    }
+}
+
+static void generateRandom(unsigned char *output, size_t size, uint64_t *state) {
+    for (size_t i = 0; i < size; i++) {
+        output[i] = (unsigned char)(nextRandom(state) >> 56);
+    }
+}
+
+// Bytes from a geometric distribution (each group of four symbols half as likely as the one
+// before), about 4 bits of entropy per byte and no repeated strings
+static void generateSkewed(unsigned char *output, size_t size, uint64_t *state) {
+    for (size_t i = 0; i < size; i++) {
+        uint64_t r = nextRandom(state);
+        int group = __builtin_ctzll(r | 1ULL << 60);
+        output[i] = (unsigned char)(group * 4 + (r >> 62));
+    }
+}
+
+// Greyscale PGM image: a diagonal gradient with shaded discs and flat rectangles on top and a
+// little sensor noise, so neighbouring pixels are close but rarely equal
+static void generateImage(unsigned char *output, size_t size, uint64_t *state) {
+    int width = BENCH_IMAGE_WIDTH;
+    int header = snprintf((char *)output, size, "P5\n%d %zu\n255\n", width, size / width);
+    int discs[8][4];
+    for (int d = 0; d < 8; d++) {
+        discs[d][0] = nextRandom(state) % width;
+        discs[d][1] = nextRandom(state) % (size / width + 1);
+        discs[d][2] = 40 + nextRandom(state) % 200;
+        discs[d][3] = nextRandom(state) % 256;
+    }
+
+    size_t start = header > 0 && (size_t)header < size ? (size_t)header : size;
+    for (size_t i = start; i < size; i++) {
+        int x = (i - header) % width, y = (i - header) / width;
+        int value = (x + y) * 160 / (width + (int)(size / width) + 1) + 48;
+        for (int d = 0; d < 8; d++) {
+            int dx = x - discs[d][0], dy = y - discs[d][1], r = discs[d][2];
+            if (dx * dx + dy * dy < r * r) {
+                value = discs[d][3] - (dx * dx + dy * dy) * 64 / (r * r);
+            }
+        }
+        if ((x / 128 + y / 96) % 7 == 3) {
+            value = 200;
+        }
+        value += (int)(nextRandom(state) >> 62) - 1;
+        output[i] = (unsigned char)(value < 0 ? 0 : value > 255 ? 255 : value);
+    }
+}
+
+static const struct {
+    const char *name;
+    void (*generate)(unsigned char *output, size_t size, uint64_t *state);
+} syntheticInputs[] = {
+    {"text", generateText}, {"random", generateRandom}, {"skewed", generateSkewed}, {"image", generateImage}};
+
+#define SYNTHETIC_INPUTS (int)(sizeof(syntheticInputs) / sizeof(syntheticInputs[0]))
+
+// Write size bytes of the synthetic input with this name to fileName; 0 if there is no such
+// input or the file cannot be written
+static int writeSynthetic(const char *name, size_t size, const char *fileName) {
+    int which = 0;
+    while (which < SYNTHETIC_INPUTS && strcmp(syntheticInputs[which].name, name) != 0) which++;
+    if (which == SYNTHETIC_INPUTS) {
+        fprintf(stderr, "Unknown synthetic input @%s\n", name);
+        return 0;
+    }
+
+    unsigned char *data = (unsigned char *)malloc(size > 0 ? size : 1);
+    uint64_t state = 0x9E3779B97F4A7C15ULL + which;
+    syntheticInputs[which].generate(data, size, &state);
+    int fd = openOutput(fileName);
+    struct iovec iov = {data, size};
+    int ok = fd >= 0 && writeBuffers(fd, &iov, 1) && closeOutput(fd);
+    free(data);
+    return ok;
+}
+
+// Time stamp counter on x86; elsewhere there is no cycle count and it stays 0
+static inline uint64_t readCycles() {
+#if defined(__x86_64__) || defined(__i386__)
+    return __builtin_ia32_rdtsc();
+#else
+    return 0;
+#endif
+}
+
+// Compress or decompress input to output in a child process, so the peak resident set size
+// reported by wait4() belongs to this run alone. The child times the call and sends the result
+// back through a pipe. Returns 0 if the run failed.
+static int timedRun(int compress, const char *input, const char *output, int numThreads, int level, int windowBits,
+                    BenchRun *run) {
+    int fds[2];
+    if (pipe(fds) != 0) {
+        perror("Failed to create pipe");
+        return 0;
+    }
+    fflush(stdout);
+    fflush(stderr);
+    pid_t pid = fork();
+    if (pid == 0) {
+        close(fds[0]);
+        long long inputBytes = 0;
+        double start = currentTime();
+        uint64_t cycles = readCycles();
+        run->bytes = compress ? compressFile(input, output, numThreads, level, windowBits, &inputBytes)
+                              : decompressFile(input, output, numThreads, &inputBytes);
+        run->cycles = readCycles() - cycles;
+        run->seconds = currentTime() - start;
+        _exit(write(fds[1], run, sizeof(BenchRun)) == sizeof(BenchRun) ? 0 : 1);
+    }
+    close(fds[1]);
+    if (pid < 0) {
+        perror("Failed to fork");
+        close(fds[0]);
+        return 0;
+    }
+
+    int status = 0;
+    struct rusage usage;
+    int received = readFully(fds[0], (unsigned char *)run, sizeof(BenchRun)) == sizeof(BenchRun);
+    close(fds[0]);
+    if (wait4(pid, &status, 0, &usage) != pid) {
+        return 0;
+    }
+    run->peakKb = usage.ru_maxrss;
+    return received && WIFEXITED(status) && WEXITSTATUS(status) == 0 && run->bytes >= 0;
+}
+
+// Whether two files have the same contents, byte for byte
+static int sameContents(const char *first, const char *second) {
+    size_t sizes[2];
+    int mapped[2];
+    unsigned char *a = loadInput(first, &sizes[0], &mapped[0]);
+    unsigned char *b = a ? loadInput(second, &sizes[1], &mapped[1]) : NULL;
+    int same = b && sizes[0] == sizes[1] && memcmp(a, b, sizes[0]) == 0;
+    if (a) releaseInput(a, sizes[0], mapped[0]);
+    if (b) releaseInput(b, sizes[1], mapped[1]);
+    return same;
+}
+
+// Parse a level list such as "0,1,6-9" into levels[]; returns the count, 0 if it is invalid
+static int parseLevels(const char *text, int levels[MAX_LEVEL + 1]) {
+    int count = 0;
+    while (*text != '\0') {
+        char *end;
+        long first = strtol(text, &end, 10), last = first;
+        if (end == text) return 0;
+        if (*end == '-') {
+            text = end + 1;
+            last = strtol(text, &end, 10);
+            if (end == text) return 0;
+        }
+        if (first < 0 || last > MAX_LEVEL || first > last || count + last - first + 1 > MAX_LEVEL + 1) return 0;
+        for (long level = first; level <= last; level++) {
+            levels[count++] = (int)level;
+        }
+        if (*end != ',' && *end != '\0') return 0;
+        text = *end == ',' ? end + 1 : end;
+    }
+    return count;
+}
+
+// Parse a byte count with an optional K, M or G suffix (powers of 1024); 0 if it is invalid
+static size_t parseSize(const char *text) {
+    char *end;
+    unsigned long long size = strtoull(text, &end, 10);
+    int shift = *end == 'K' || *end == 'k' ? 10 : *end == 'M' || *end == 'm' ? 20 : *end == 'G' || *end == 'g' ? 30 : 0;
+    if (end == text || (shift > 0 && end[1] != '\0') || (shift == 0 && *end != '\0')) return 0;
+    return (size_t)(size << shift);
+}
+
+// Write text as a JSON string
+static void writeJsonString(FILE *out, const char *text) {
+    fputc('"', out);
+    for (; *text != '\0'; text++) {
+        if (*text == '"' || *text == '\\') {
+            fprintf(out, "\\%c", *text);
+        } else if ((unsigned char)*text < 0x20) {
+            fprintf(out, "\\u%04x", (unsigned char)*text);
+        } else {
+            fputc(*text, out);
+        }
+    }
+    fputc('"', out);
+}
+
+static double megabytesPerSecond(long long bytes, double seconds) {
+    return bytes / 1e6 / (seconds > 0 ? seconds : 1e-9);
+}
+
+static double cyclesPerByte(uint64_t cycles, long long bytes) {
+    return bytes > 0 ? (double)cycles / bytes : 0.0;
+}
+
+// Write the results as JSON (one object per input and level) or CSV (one line each); 0 if the
+// file cannot be written
+static int writeBenchResults(const char *fileName, int json, const BenchResult *results, int count, int numThreads,
+                             int windowBits) {
+    FILE *out = fopen(fileName, "w");
+    if (!out) {
+        perror("Failed to open file");
+        return 0;
+    }
+
+    if (json) {
+        fprintf(out, "{\n  \"threads\": %d,\n  \"window_bits\": %d,\n  \"cycle_counter\": %s,\n  \"results\": [\n",
+                numThreads, windowBits, readCycles() != 0 ? "true" : "false");
+    } else {
+        fprintf(out, "input,bytes,level,compressed,ratio,compress_mb_s,decompress_mb_s,compress_cycles_per_byte,"
+                     "decompress_cycles_per_byte,compress_peak_rss_kb,decompress_peak_rss_kb,round_trip\n");
+    }
+    for (int i = 0; i < count; i++) {
+        const BenchResult *r = &results[i];
+        double ratio = r->bytes > 0 ? (double)r->compressed.bytes / r->bytes : 0.0;
+        if (json) {
+            fprintf(out, "    {\"input\": ");
+            writeJsonString(out, r->input);
+            fprintf(out, ", \"bytes\": %lld, \"level\": %d, \"compressed\": %lld, \"ratio\": %.4f, ", r->bytes, r->level,
+                    r->compressed.bytes, ratio);
+            fprintf(out, "\"compress_mb_s\": %.1f, \"decompress_mb_s\": %.1f, ", megabytesPerSecond(r->bytes, r->compressed.seconds),
+                    megabytesPerSecond(r->bytes, r->restored.seconds));
+            fprintf(out, "\"compress_cycles_per_byte\": %.2f, \"decompress_cycles_per_byte\": %.2f, ",
+                    cyclesPerByte(r->compressed.cycles, r->bytes), cyclesPerByte(r->restored.cycles, r->bytes));
+            fprintf(out, "\"compress_peak_rss_kb\": %ld, \"decompress_peak_rss_kb\": %ld, \"round_trip\": %s}%s\n",
+                    r->compressed.peakKb, r->restored.peakKb, r->ok ? "true" : "false", i + 1 < count ? "," : "");
+        } else {
+            fputc('"', out);
+            for (const char *c = r->input; *c != '\0'; c++) {
+                if (*c == '"') fputc('"', out);
+                fputc(*c, out);
+            }
+            fprintf(out, "\",%lld,%d,%lld,%.4f,%.1f,%.1f,%.2f,%.2f,%ld,%ld,%d\n", r->bytes, r->level, r->compressed.bytes,
+                    ratio, megabytesPerSecond(r->bytes, r->compressed.seconds),
+                    megabytesPerSecond(r->bytes, r->restored.seconds), cyclesPerByte(r->compressed.cycles, r->bytes),
+                    cyclesPerByte(r->restored.cycles, r->bytes), r->compressed.peakKb, r->restored.peakKb, r->ok);
+        }
+    }
+    if (json) {
+        fprintf(out, "  ]\n}\n");
+    }
+    return fclose(out) == 0;
+}
+
+// Benchmark the compress and decompress commands over a corpus of files and synthetic inputs
+// (@text, @random, @skewed, @image; all four when none is given). Every input is compressed at
+// each level and decompressed again, each run in its own process for its peak RSS and keeping
+// the fastest of the repeats, and the output is compared with the input byte for byte. The
+// files go through the page cache in a temporary directory, so speeds include that I/O.
+// Results are printed as a table and optionally written as JSON and CSV. Returns 1 on usage
+// errors, failed runs or round trips that do not match.
+int runBenchmark(int argc, char *argv[]) {
+    int levels[MAX_LEVEL + 1], numLevels = MAX_LEVEL + 1;
+    int windowBits = DEFAULT_WINDOW_BITS, numThreads = 1, repeats = 1, arg = 0, badOption = 0;
+    size_t syntheticSize = BENCH_DEFAULT_SIZE;
+    const char *jsonFile = NULL, *csvFile = NULL;
+    for (int l = 0; l <= MAX_LEVEL; l++) levels[l] = l;
+
+    while (arg < argc && argv[arg][0] == '-' && !badOption) {
+        const char *value = arg + 1 < argc ? argv[arg + 1] : NULL;
+        if (value && strcmp(argv[arg], "-l") == 0) {
+            numLevels = parseLevels(value, levels);
+            badOption = numLevels == 0;
+        } else if (value && strcmp(argv[arg], "-w") == 0) {
+            windowBits = atoi(value);
+            badOption = windowBits < MIN_WINDOW_BITS || windowBits > MAX_WINDOW_BITS;
+        } else if (value && strcmp(argv[arg], "-t") == 0) {
+            numThreads = atoi(value);
+            badOption = numThreads < 1;
+        } else if (value && strcmp(argv[arg], "-r") == 0) {
+            repeats = atoi(value);
+            badOption = repeats < 1;
+        } else if (value && strcmp(argv[arg], "-s") == 0) {
+            syntheticSize = parseSize(value);
+            badOption = syntheticSize == 0;
+        } else if (value && strcmp(argv[arg], "-j") == 0) {
+            jsonFile = value;
+        } else if (value && strcmp(argv[arg], "-c") == 0) {
+            csvFile = value;
+        } else {
+            badOption = 1;
+        }
+        arg += 2;
+    }
+    if (badOption) {
+        fprintf(stderr, "Usage: huffman bench [-l levels] [-w window_bits] [-t threads] [-r repeats] [-s size]\n");
+        fprintf(stderr, "                     [-j results.json] [-c results.csv] [file | @text | @random | @skewed | @image]...\n");
+        fprintf(stderr, "Levels are a list such as 0,1,6-9 (default 0-%d); synthetic inputs are size bytes (K, M\n", MAX_LEVEL);
+        fprintf(stderr, "or G suffix, default %dM) and all four are used when no input is given.\n", BENCH_DEFAULT_SIZE >> 20);
+        return 1;
+    }
+
+    static char *allSynthetic[] = {"@text", "@random", "@skewed", "@image"};
+    char **inputs = arg < argc ? argv + arg : allSynthetic;
+    int numInputs = arg < argc ? argc - arg : SYNTHETIC_INPUTS;
+
+    const char *tmp = getenv("TMPDIR");
+    char directory[PATH_MAX - 16], syntheticFile[PATH_MAX], compressedFile[PATH_MAX], restoredFile[PATH_MAX];
+    snprintf(directory, sizeof(directory), "%s/huffbench.XXXXXX", tmp && *tmp ? tmp : "/tmp");
+    if (!mkdtemp(directory)) {
+        perror("Failed to create temporary directory");
+        return 1;
+    }
+    snprintf(compressedFile, sizeof(compressedFile), "%s/compressed", directory);
+    snprintf(restoredFile, sizeof(restoredFile), "%s/restored", directory);
+    snprintf(syntheticFile, sizeof(syntheticFile), "%s/input", directory);
+
+    BenchResult *results = (BenchResult *)calloc((size_t)numInputs * numLevels, sizeof(BenchResult));
+    int count = 0, ok = 1;
+    printf("Window 2^%d, %d thread%s, best of %d\n", windowBits, numThreads, numThreads == 1 ? "" : "s", repeats);
+    printf("%-20s%6s%12s%13s%8s%10s%10s%9s%9s%9s%9s\n", "Input", "Level", "Bytes", "Compressed", "Ratio", "Comp MB/s",
+           "Dec MB/s", "Comp c/B", "Dec c/B", "Comp MiB", "Dec MiB");
+
+    for (int i = 0; i < numInputs; i++) {
+        const char *inputFile = inputs[i];
+        if (inputs[i][0] == '@') {
+            if (!writeSynthetic(inputs[i] + 1, syntheticSize, syntheticFile)) {
+                ok = 0;
+                continue;
+            }
+            inputFile = syntheticFile;
+        }
+        struct stat info;
+        if (stat(inputFile, &info) != 0 || !S_ISREG(info.st_mode)) {
+            fprintf(stderr, "%s: not a regular file\n", inputs[i]);
+            ok = 0;
+            continue;
+        }
+
+        for (int l = 0; l < numLevels; l++) {
+            BenchResult *r = &results[count++];
+            r->input = inputs[i];
+            r->bytes = info.st_size;
+            r->level = levels[l];
+            r->ok = 1;
+            for (int repeat = 0; repeat < repeats && r->ok; repeat++) {
+                BenchRun compressed = {0}, restored = {0};
+                r->ok = timedRun(1, inputFile, compressedFile, numThreads, levels[l], windowBits, &compressed) &&
+                        timedRun(0, compressedFile, restoredFile, numThreads, levels[l], windowBits, &restored) &&
+                        restored.bytes == r->bytes && sameContents(inputFile, restoredFile);
+                if (repeat == 0 || compressed.seconds < r->compressed.seconds) r->compressed = compressed;
+                if (repeat == 0 || restored.seconds < r->restored.seconds) r->restored = restored;
+                if (compressed.peakKb > r->compressed.peakKb) r->compressed.peakKb = compressed.peakKb;
+                if (restored.peakKb > r->restored.peakKb) r->restored.peakKb = restored.peakKb;
+            }
+            if (!r->ok) {
+                fprintf(stderr, "%s: round trip failed at level %d\n", inputs[i], levels[l]);
+                ok = 0;
+                continue;
+            }
+            printf("%-20s%6d%12lld%13lld%8.3f%10.1f%10.1f%9.2f%9.2f%9.1f%9.1f\n", inputs[i], r->level, r->bytes,
+                   r->compressed.bytes, r->bytes > 0 ? (double)r->compressed.bytes / r->bytes : 0.0,
+                   megabytesPerSecond(r->bytes, r->compressed.seconds), megabytesPerSecond(r->bytes, r->restored.seconds),
+                   cyclesPerByte(r->compressed.cycles, r->bytes), cyclesPerByte(r->restored.cycles, r->bytes),
+                   r->compressed.peakKb / 1024.0, r->restored.peakKb / 1024.0);
+        }
+        if (inputFile == syntheticFile) unlink(syntheticFile);
+    }
+    unlink(compressedFile);
+    unlink(restoredFile);
+    rmdir(directory);
+
+    if (jsonFile) ok = writeBenchResults(jsonFile, 1, results, count, numThreads, windowBits) && ok;
+    if (csvFile) ok = writeBenchResults(csvFile, 0, results, count, numThreads, windowBits) && ok;
+    free(results);
+    return ok ? 0 : 1;
+}
+
+// Count the frequency of each character in data, adding to frequency. Bytes are counted into
+// four interleaved sub-histograms, so runs of the same byte increment different counters
+// instead of waiting for the previous increment of one counter to be stored. The 32-bit
+// sub-counts are added to the 64-bit totals before they could overflow.
+void countFrequency(const unsigned char *data, size_t size, uint64_t frequency[MAX_TREE_NODES]) {
+    uint32_t counts[4][MAX_TREE_NODES];
+    size_t i = 0;
+
+    while (i < size) {
+        memset(counts, 0, sizeof(counts));
+        size_t end = size - i > HISTOGRAM_CHUNK ? i + HISTOGRAM_CHUNK : size;
+
+        // One 8-byte load per step; each byte goes to the table of its position in the word
+        for (; i + 8 <= end; i += 8) {
+            uint64_t word;
+            memcpy(&word, data + i, 8);
+            counts[0][word & 255]++;
+            counts[1][(word >> 8) & 255]++;
+            counts[2][(word >> 16) & 255]++;
+            counts[3][(word >> 24) & 255]++;
+            counts[0][(word >> 32) & 255]++;
+            counts[1][(word >> 40) & 255]++;
+            counts[2][(word >> 48) & 255]++;
+            counts[3][word >> 56]++;
+        }
+        for (; i < end; i++) {
+            counts[i & 3][data[i]]++;
+        }
+
+        for (int c = 0; c < MAX_TREE_NODES; c++) {
+            frequency[c] += (uint64_t)counts[0][c] + counts[1][c] + counts[2][c] + counts[3][c];
+        }
+    }
+}
+
+int defaultThreadCount() {
+    long cores = sysconf(_SC_NPROCESSORS_ONLN);
+    return cores > 0 ? (int)cores : 1;
+}
+
+// Run worker on numThreads threads (the caller being thread 0) and wait for all of them
+void runThreads(int numThreads, void *(*worker)(void *), void *shared) {
+    pthread_t *threads = (pthread_t *)malloc(numThreads * sizeof(pthread_t));
+    ThreadArgs *args = (ThreadArgs *)malloc(numThreads * sizeof(ThreadArgs));
+
+    for (int i = 0; i < numThreads; i++) {
+        args[i].threadId = i;
+        args[i].numThreads = numThreads;
+        args[i].shared = shared;
+    }
+    for (int i = 1; i < numThreads; i++) {
+        pthread_create(&threads[i], NULL, worker, &args[i]);
+    }
+    if (numThreads > 0) {
+        worker(&args[0]);
+    }
+    for (int i = 1; i < numThreads; i++) {
+        pthread_join(threads[i], NULL);
+    }
+
+    free(threads);
+    free(args);
+}
 
-    fclose(file);
+double currentTime() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
 }
@@ -1,6 +1,41 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <limits.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+#define RADIX_BUCKETS 33
+#define MIN_DELTA_SLOTS 64
+#define MAX_DELTA_SLOTS (1 << 16)
+#define BENCH_SCAN_LIMIT 20000
+#define BENCH_CHECK_QUERIES 10
+#define DISTANCE_MATRIX_MAGIC 0x4D444757 // "WGDM"
+#define DISTANCE_MATRIX_HEADER (3 * sizeof(int))
+#define ROUTING_LANDMARKS 8
+#define HIERARCHY_MAGIC 0x48434757 // "WGCH"
+#define HIERARCHY_VERSION 1
+#define WITNESS_SETTLE_LIMIT 500
+#define GRAPH_BINARY_MAGIC 0x42524757 // "WGRB"
+#define GRAPH_BINARY_VERSION 1
+#define GRAPH_BINARY_HEADER (4 * sizeof(int))
+#define TEXT_WRITE_BUFFER (1 << 20)
+#define SNAPSHOT_MAGIC 0x53534757 // "WGSS"
+#define SNAPSHOT_VERSION 1
+#define SNAPSHOT_PAGE 4096
+#define SNAPSHOT_CHECKSUM 1
+#define SNAPSHOT_HIERARCHY 2
+#define SNAPSHOT_CHECKSUM_SEED 0xcbf29ce484222325ULL
 
 typedef struct Edge {
     int dest;
@@ -8,50 +43,652 @@ typedef struct Edge {
     struct Edge* next;
 } Edge;
 
+// adjacency lists are only used while the graph is built, finalizeGraph() freezes
+// them into CSR arrays: the edges of u are offsets[u] .. offsets[u + 1] - 1.
+// mapped graphs point into a snapshot mapping and do not own their arrays.
+// after reorderGraph() vertex v is shown as labels[v] and the id typed as x is vertexOf[x];
+// both are NULL while vertices keep the ids they were entered with.
 typedef struct Graph {
     int numVertices;
+    int numEdges;
     Edge** adjList;
+    int* offsets;
+    int* targets;
+    int* weights;
+    int mapped;
+    int* labels;
+    int* vertexOf;
 } Graph;
 
+// priority queue used to pick the next vertex in Dijkstra's algorithm
+typedef enum QueueType {
+    QUEUE_LINEAR_SCAN,
+    QUEUE_BINARY_HEAP,
+    QUEUE_RADIX_HEAP
+} QueueType;
+
+// Bellman-Ford variants
+typedef enum BellmanFordMode {
+    BF_CLASSIC,
+    BF_QUEUE,
+    BF_PARALLEL,
+    BF_VECTOR
+} BellmanFordMode;
+
+// vertex renumbering used by reorderGraph()
+typedef enum VertexOrder {
+    ORDER_BFS,     // breadth-first discovery order
+    ORDER_RCM,     // reverse Cuthill-McKee: low-degree start, neighbours by degree, reversed
+    ORDER_DEGREE   // hubs first, by decreasing out-degree
+} VertexOrder;
+
+// arguments handed to every thread started by runThreads()
+typedef struct ThreadArgs {
+    int threadId;
+    int numThreads;
+    void* shared;
+} ThreadArgs;
+
+// indexed binary min-heap of vertices keyed by an external distance array
+typedef struct IndexedHeap {
+    int* heap;
+    int* position;
+    const int* keys;
+    int size;
+} IndexedHeap;
+
+// scratch for repeated binary-heap Dijkstra queries, one per thread
+typedef struct DijkstraWorkspace {
+    int capacity;
+    int* distances;
+    IndexedHeap* heap;
+} DijkstraWorkspace;
+
+// point-to-point query strategies
+typedef enum QueryMethod {
+    QUERY_DIJKSTRA,
+    QUERY_BIDIRECTIONAL,
+    QUERY_ALT
+} QueryMethod;
+
+// labels of one search direction; a label is valid only when stamp[v] equals the current query
+typedef struct SearchSide {
+    int* distances;
+    int* parent;
+    int* keys;
+    int* stamp;
+    IndexedHeap* heap;
+} SearchSide;
+
+// point-to-point query engine: reverse graph and landmark distance tables (landmark-major)
+typedef struct RoutingEngine {
+    Graph* graph;
+    Graph* reverse;
+    int numLandmarks;
+    int* landmarks;
+    int* fromLandmark;
+    int* toLandmark;
+    SearchSide forward;
+    SearchSide backward;
+    int query;
+    int settled;
+} RoutingEngine;
+
+// a route: vertices[0 .. length - 1], and the CSR index of each of the length - 1 edges taken
+typedef struct Path {
+    int distance;
+    int length;
+    int* vertices;
+    int* edges;
+} Path;
+
+// state of the hop-limited search: vertex reached after hops edges at distance, parent label index
+typedef struct HopLabel {
+    int vertex;
+    int hops;
+    int distance;
+    int parent;
+    int edge;
+} HopLabel;
+
+// alternative-route engine: k shortest loopless paths (Yen) and hop-limited paths. All scratch
+// space is allocated once and reused by every spur search and query; toTarget is the exact
+// distance to the current target on the full graph, the A* heuristic of every search.
+typedef struct PathFinder {
+    Graph* graph;
+    Graph* reverse;
+    DijkstraWorkspace* toTarget;
+    int* hopsToTarget;
+    int target;
+    SearchSide side;
+    int* parentEdge;
+    int query;
+    int* blockedVertex;
+    char* blockedEdge;
+    int blockRound;
+    int* bestHops;
+    HopLabel* labels;
+    int numLabels;
+    int labelCapacity;
+    int* labelHeap;
+    int labelHeapSize;
+    int settled;
+    int spurSearches;
+} PathFinder;
+
+// contraction hierarchy: upward holds the edges u -> v with rank[u] < rank[v], downward the
+// edges u -> v with rank[u] > rank[v] stored reversed at v; middle[e] is the vertex a shortcut
+// bypasses, -1 for original edges
+typedef struct ContractionHierarchy {
+    int numVertices;
+    int* rank;
+    Graph* upward;
+    Graph* downward;
+    int* upwardMiddle;
+    int* downwardMiddle;
+    int mapped;
+    SearchSide forward;
+    SearchSide backward;
+    int query;
+    int settled;
+} ContractionHierarchy;
+
+// growable list of vertex ids
+typedef struct VertexList {
+    int* items;
+    int size;
+    int capacity;
+} VertexList;
+
+typedef struct DynamicEdge {
+    int target;
+    int weight;
+} DynamicEdge;
+
+typedef struct DynamicEdgeList {
+    DynamicEdge* edges;
+    int size;
+    int capacity;
+} DynamicEdgeList;
+
+// graph whose edges can be inserted, re-weighted and deleted; in[v] mirrors out[] so the
+// edges into v can be scanned too. An edge is identified by (src, dest), without parallel edges.
+typedef struct DynamicGraph {
+    int numVertices;
+    int numEdges;
+    DynamicEdgeList* out;
+    DynamicEdgeList* in;
+} DynamicGraph;
+
+typedef enum EdgeChangeType {
+    EDGE_INSERT,
+    EDGE_UPDATE,
+    EDGE_DELETE
+} EdgeChangeType;
+
+// one change of a batch; weight is ignored for deletions
+typedef struct EdgeChange {
+    EdgeChangeType type;
+    int src;
+    int dest;
+    int weight;
+} EdgeChange;
+
+// shortest-path tree from source kept valid across edge changes; processed counts the
+// vertices settled by the last update
+typedef struct DynamicSSSP {
+    DynamicGraph* graph;
+    int source;
+    int* distances;
+    int* parent;
+    char* affected;
+    VertexList invalidated;
+    IndexedHeap* heap;
+    int processed;
+} DynamicSSSP;
+
+// snapshot sections, each an int array starting on a page boundary
+typedef enum SnapshotSectionType {
+    SECTION_OFFSETS,
+    SECTION_TARGETS,
+    SECTION_WEIGHTS,
+    SECTION_RANK,
+    SECTION_UPWARD_OFFSETS,
+    SECTION_UPWARD_TARGETS,
+    SECTION_UPWARD_WEIGHTS,
+    SECTION_UPWARD_MIDDLE,
+    SECTION_DOWNWARD_OFFSETS,
+    SECTION_DOWNWARD_TARGETS,
+    SECTION_DOWNWARD_WEIGHTS,
+    SECTION_DOWNWARD_MIDDLE,
+    SNAPSHOT_SECTIONS
+} SnapshotSectionType;
+
+// byte offset and number of ints of a section; absent sections have count 0
+typedef struct SnapshotSection {
+    long long offset;
+    long long count;
+} SnapshotSection;
+
+// first page of a snapshot file
+typedef struct SnapshotHeader {
+    int magic;
+    int version;
+    int flags;
+    int numVertices;
+    int numEdges;
+    int upwardEdges;
+    int downwardEdges;
+    int reserved;
+    unsigned long long checksum;
+    SnapshotSection sections[SNAPSHOT_SECTIONS];
+} SnapshotHeader;
+
+// an open snapshot: the graph and optional hierarchy are views into the mapping
+typedef struct GraphSnapshot {
+    void* data;
+    size_t size;
+    Graph* graph;
+    ContractionHierarchy* hierarchy;
+} GraphSnapshot;
+
+typedef struct RadixEntry {
+    unsigned int key;
+    int vertex;
+} RadixEntry;
+
+typedef struct RadixBucket {
+    RadixEntry* entries;
+    int size;
+    int capacity;
+} RadixBucket;
+
+// monotone radix heap for non-negative integer keys
+typedef struct RadixHeap {
+    RadixBucket buckets[RADIX_BUCKETS];
+    unsigned int last;
+    int size;
+} RadixHeap;
+
 Graph* createGraph(int vertices);
+Graph* createGraphFromEdges(int vertices, int edges, const int* src, const int* dest, const int* weight);
 void addEdge(Graph* graph, int src, int dest, int weight);
-void dijkstra(Graph* graph, int startVertex);
-void bellmanFord(Graph* graph, int startVertex);
+void finalizeGraph(Graph* graph);
+int hasNegativeWeights(Graph* graph);
+Graph* createReverseGraph(Graph* graph);
+void computeDijkstra(Graph* graph, int startVertex, int* distances, QueueType queue);
+void dijkstra(Graph* graph, int startVertex, QueueType queue);
+int computeBellmanFord(Graph* graph, int startVertex, int* distances, int* parent, int* cycle, BellmanFordMode mode, int numThreads);
+void bellmanFord(Graph* graph, int startVertex, BellmanFordMode mode, int numThreads);
+int defaultDelta(Graph* graph);
+int boundedDelta(Graph* graph, int delta);
+int computeDeltaStepping(Graph* graph, int startVertex, int* distances, int delta, int numThreads);
+void deltaStepping(Graph* graph, int startVertex, int delta, int numThreads);
+DijkstraWorkspace* createDijkstraWorkspace(int capacity);
+void freeDijkstraWorkspace(DijkstraWorkspace* ws);
+void workspaceDijkstra(Graph* graph, int startVertex, DijkstraWorkspace* ws);
+int computeDistanceMatrix(Graph* graph, const int* sources, int numSources, int* matrix, int fd, int numThreads);
+int computeJohnson(Graph* graph, const int* sources, int numSources, int* matrix, int fd, int numThreads, int* cycle);
+void distanceMatrix(Graph* graph, const int* sources, int numSources, const char* outputFile, int numThreads);
+RoutingEngine* createRoutingEngine(Graph* graph, int numLandmarks);
+void freeRoutingEngine(RoutingEngine* engine);
+int shortestPathQuery(RoutingEngine* engine, int source, int target, QueryMethod method, int* path, int* pathLength);
+void shortestPath(RoutingEngine* engine, int source, int target, QueryMethod method);
+const char* queryMethodName(QueryMethod method);
+PathFinder* createPathFinder(Graph* graph);
+void freePathFinder(PathFinder* finder);
+int kShortestPaths(PathFinder* finder, int source, int target, int k, Path* paths);
+int hopLimitedPath(PathFinder* finder, int source, int target, int maxHops, Path* path);
+void freePath(Path* path);
+void alternativeRoutes(PathFinder* finder, int source, int target, int k);
+void hopLimitedRoute(PathFinder* finder, int source, int target, int maxHops);
+ContractionHierarchy* buildContractionHierarchy(Graph* graph);
+void freeContractionHierarchy(ContractionHierarchy* ch);
+int hierarchyShortcuts(ContractionHierarchy* ch);
+int hierarchyQuery(ContractionHierarchy* ch, int source, int target, int* path, int* pathLength);
+void hierarchyShortestPath(ContractionHierarchy* ch, Graph* graph, int source, int target);
+int saveContractionHierarchy(ContractionHierarchy* ch, const char* fileName);
+ContractionHierarchy* loadContractionHierarchy(const char* fileName);
+Graph* loadGraph(const char* fileName, int numThreads);
+int saveGraphBinary(Graph* graph, const char* fileName);
+int saveGraphText(Graph* graph, const char* fileName, int dimacs);
+int convertGraph(const char* input, const char* output, int numThreads);
+int saveGraphSnapshot(Graph* graph, ContractionHierarchy* ch, const char* fileName, int checksum);
+int isGraphSnapshot(const char* fileName);
+GraphSnapshot* openGraphSnapshot(const char* fileName, int verify);
+void closeGraphSnapshot(GraphSnapshot* snapshot);
+int createSnapshotFile(const char* input, const char* output, int withHierarchy, int checksum, int numThreads);
+DynamicGraph* createDynamicGraph(Graph* graph);
+int dynamicInsertEdge(DynamicGraph* graph, int src, int dest, int weight);
+int dynamicUpdateWeight(DynamicGraph* graph, int src, int dest, int weight);
+int dynamicDeleteEdge(DynamicGraph* graph, int src, int dest);
+void freeDynamicGraph(DynamicGraph* graph);
+DynamicSSSP* createDynamicSSSP(DynamicGraph* graph, int source);
+int applyEdgeChanges(DynamicSSSP* sssp, const EdgeChange* changes, int numChanges);
+void dynamicRecompute(DynamicSSSP* sssp);
+void freeDynamicSSSP(DynamicSSSP* sssp);
+int vertexLabel(Graph* graph, int v);
+int vertexIndex(Graph* graph, int id);
+void computeBFS(Graph* graph, int startVertex, int* levels);
+int* computeVertexOrder(Graph* graph, VertexOrder order);
+Graph* permuteGraph(Graph* graph, const int* newId);
+Graph* reorderGraph(Graph* graph, VertexOrder order);
+const char* vertexOrderName(VertexOrder order);
 void freeGraph(Graph* graph);
+IndexedHeap* createIndexedHeap(int capacity, const int* keys);
+void heapPush(IndexedHeap* heap, int vertex);
+void heapDecreaseKey(IndexedHeap* heap, int vertex);
+void heapUpdate(IndexedHeap* heap, int vertex);
+int heapPop(IndexedHeap* heap);
+void freeIndexedHeap(IndexedHeap* heap);
+RadixHeap* createRadixHeap();
+void radixPush(RadixHeap* heap, unsigned int key, int vertex);
+RadixEntry radixPop(RadixHeap* heap);
+void freeRadixHeap(RadixHeap* heap);
+const char* queueName(QueueType queue);
+const char* bellmanFordModeName(BellmanFordMode mode);
+int defaultThreadCount();
+double currentTime();
+void runThreads(int numThreads, void* (*worker)(void*), void* shared);
+Graph* generateRandomGraph(int vertices, int degree, int maxWeight, unsigned int seed);
+Graph* generateGridGraph(int rows, int cols, int maxWeight, unsigned int seed);
+int runBenchmark(int argc, char* argv[]);
 
-int main() {
+int main(int argc, char* argv[]) {
     int vertices, edges, src, dest, weight, choice;
+    QueueType queue = QUEUE_BINARY_HEAP;
+    int numThreads = defaultThreadCount();
+    RoutingEngine* engine = NULL;
+    ContractionHierarchy* hierarchy = NULL;
+    PathFinder* finder = NULL;
 
-    printf("Enter number of vertices: ");
-    scanf("%d", &vertices);
-    
-    Graph* graph = createGraph(vertices);
+    if (argc > 1 && strcmp(argv[1], "bench") == 0) {
+        return runBenchmark(argc - 2, argv + 2);
+    }
+    if (argc > 1 && strcmp(argv[1], "convert") == 0) {
+        if (argc != 4) {
+            printf("Usage: weighted_graph convert <input> <output.gr|output.txt|output.bin>\n");
+            return 1;
+        }
+        return convertGraph(argv[2], argv[3], numThreads);
+    }
+    if (argc > 1 && strcmp(argv[1], "snapshot") == 0) {
+        int withHierarchy = 0, checksum = 0, valid = argc >= 4;
+        for (int i = 4; i < argc && valid; i++) {
+            withHierarchy |= strcmp(argv[i], "ch") == 0;
+            checksum |= strcmp(argv[i], "checksum") == 0;
+            valid = strcmp(argv[i], "ch") == 0 || strcmp(argv[i], "checksum") == 0;
+        }
+        if (!valid) {
+            printf("Usage: weighted_graph snapshot <graph file> <output> [ch] [checksum]\n");
+            return 1;
+        }
+        return createSnapshotFile(argv[2], argv[3], withHierarchy, checksum, numThreads);
+    }
 
-    printf("Enter number of edges: ");
-    scanf("%d", &edges);
-    for (int i = 0; i < edges; i++) {
-        printf("Enter edge (src dest weight): ");
-        scanf("%d %d %d", &src, &dest, &weight);
-        addEdge(graph, src, dest, weight);
+    Graph* graph;
+    GraphSnapshot* snapshot = NULL;
+    if (argc > 1 && isGraphSnapshot(argv[1])) {
+        // weighted_graph <snapshot> [verify]: the mapped arrays are used in place
+        double start = currentTime();
+        snapshot = openGraphSnapshot(argv[1], argc > 2 && strcmp(argv[2], "verify") == 0);
+        if (snapshot == NULL) {
+            return 1;
+        }
+        graph = snapshot->graph;
+        hierarchy = snapshot->hierarchy;
+        printf("Mapped snapshot with %d vertices and %d edges%s in %.3f ms\n", graph->numVertices, graph->numEdges,
+               hierarchy != NULL ? " and a contraction hierarchy" : "", (currentTime() - start) * 1000);
+    } else if (argc > 1) {
+        // weighted_graph <graph file>: DIMACS .gr, edge list or binary graph instead of typed input
+        double start = currentTime();
+        graph = loadGraph(argv[1], numThreads);
+        if (graph == NULL) {
+            return 1;
+        }
+        double elapsed = currentTime() - start;
+        printf("Loaded %d vertices and %d edges in %.3f s (%.1f M edges/s)\n", graph->numVertices,
+               graph->numEdges, elapsed, graph->numEdges / (elapsed > 0 ? elapsed : 1e-9) / 1e6);
+    } else {
+        printf("Enter number of vertices: ");
+        scanf("%d", &vertices);
+
+        graph = createGraph(vertices);
+
+        printf("Enter number of edges: ");
+        scanf("%d", &edges);
+        printf("Enter edges (src dest weight), one per line:\n");
+        for (int i = 0; i < edges; i++) {
+            scanf("%d %d %d", &src, &dest, &weight);
+            addEdge(graph, src, dest, weight);
+        }
+        finalizeGraph(graph);
     }
 
     while (1) {
-        printf("\n1. Dijkstra's Algorithm\n2. Bellman-Ford Algorithm\n3. Exit\nChoose an option: ");
+        printf("\n1. Dijkstra's Algorithm\n2. Bellman-Ford Algorithm\n3. Delta-stepping (parallel)\n4. Distance matrix (multi-source / all pairs)\n5. Shortest path between two vertices\n6. Select Dijkstra priority queue (current: %s)\n7. Contraction hierarchy (build / save / load)\n8. Reorder vertices for locality\n9. Alternative routes (k shortest / hop-limited)\n10. Exit\nChoose an option: ", queueName(queue));
         scanf("%d", &choice);
         
         switch (choice) {
             case 1:
                 printf("Enter starting vertex for Dijkstra's: ");
                 scanf("%d", &src);
-                dijkstra(graph, src);
+                dijkstra(graph, vertexIndex(graph, src), queue);
                 break;
             case 2:
                 printf("Enter starting vertex for Bellman-Ford: ");
                 scanf("%d", &src);
-                bellmanFord(graph, src);
+                printf("1. Classic (stops early once settled)\n2. Queue-based (SPFA)\n3. Parallel (%d threads)\n4. Vectorized (AVX-512 / AVX2 when available)\nChoose a variant: ", numThreads);
+                scanf("%d", &choice);
+                if (choice < 1 || choice > 4) {
+                    printf("Invalid choice. Please try again.\n");
+                    break;
+                }
+                bellmanFord(graph, vertexIndex(graph, src), (BellmanFordMode)(choice - 1), numThreads);
                 break;
             case 3:
+                printf("Enter starting vertex for delta-stepping: ");
+                scanf("%d", &src);
+                printf("Enter bucket width delta (0 for automatic): ");
+                scanf("%d", &weight);
+                deltaStepping(graph, vertexIndex(graph, src), weight, numThreads);
+                break;
+            case 4: {
+                int numSources;
+                char outputFile[256];
+                printf("Enter number of sources (0 for all vertices): ");
+                scanf("%d", &numSources);
+                if (numSources < 0 || numSources > graph->numVertices) {
+                    printf("Invalid number of sources.\n");
+                    break;
+                }
+
+                int all = numSources == 0;
+                if (all) {
+                    numSources = graph->numVertices;
+                }
+                int* sources = malloc(numSources * sizeof(int));
+                int valid = 1;
+                if (!all) {
+                    printf("Enter the sources: ");
+                }
+                for (int i = 0; i < numSources; i++) {
+                    if (all) {
+                        sources[i] = vertexIndex(graph, i);
+                    } else {
+                        scanf("%d", &sources[i]);
+                        valid = valid && sources[i] >= 0 && sources[i] < graph->numVertices;
+                        sources[i] = vertexIndex(graph, sources[i]);
+                    }
+                }
+
+                printf("Enter output file (- to print): ");
+                scanf("%255s", outputFile);
+                if (valid) {
+                    distanceMatrix(graph, sources, numSources, strcmp(outputFile, "-") == 0 ? NULL : outputFile, numThreads);
+                } else {
+                    printf("Invalid source vertex.\n");
+                }
+                free(sources);
+                break;
+            }
+            case 5:
+                printf("Enter source and target vertices: ");
+                scanf("%d %d", &src, &dest);
+                printf("1. Dijkstra (stops at the target)\n2. Bidirectional Dijkstra\n3. A* with landmarks (ALT)\n4. Contraction hierarchy\nChoose a method: ");
+                scanf("%d", &choice);
+                if (choice < 1 || choice > 4) {
+                    printf("Invalid choice. Please try again.\n");
+                    break;
+                }
+                if (hasNegativeWeights(graph)) {
+                    printf("Point-to-point queries need non-negative weights, use Bellman-Ford instead\n");
+                    break;
+                }
+                src = vertexIndex(graph, src);
+                dest = vertexIndex(graph, dest);
+                if (choice == 4) {
+                    if (hierarchy == NULL) {
+                        hierarchy = buildContractionHierarchy(graph);
+                    }
+                    hierarchyShortestPath(hierarchy, graph, src, dest);
+                    break;
+                }
+                if (engine == NULL) {
+                    engine = createRoutingEngine(graph, ROUTING_LANDMARKS);
+                }
+                shortestPath(engine, src, dest, (QueryMethod)(choice - 1));
+                break;
+            case 6:
+                printf("1. Linear scan\n2. Binary heap\n3. Radix heap (non-negative weights)\nChoose a queue: ");
+                scanf("%d", &choice);
+                if (choice >= 1 && choice <= 3) {
+                    queue = (QueueType)(choice - 1);
+                } else {
+                    printf("Invalid choice. Keeping %s.\n", queueName(queue));
+                }
+                break;
+            case 7: {
+                char fileName[256];
+                printf("1. Build from the current graph\n2. Save to file\n3. Load from file\nChoose an action: ");
+                scanf("%d", &choice);
+                if (choice == 1) {
+                    if (hasNegativeWeights(graph)) {
+                        printf("Contraction hierarchies need non-negative weights\n");
+                        break;
+                    }
+                    if (hierarchy != NULL) {
+                        freeContractionHierarchy(hierarchy);
+                    }
+                    double start = currentTime();
+                    hierarchy = buildContractionHierarchy(graph);
+                    printf("Built hierarchy with %d shortcuts in %.3f s\n", hierarchyShortcuts(hierarchy), currentTime() - start);
+                } else if (choice == 2 || choice == 3) {
+                    if (choice == 2 && hierarchy == NULL) {
+                        printf("No hierarchy built yet.\n");
+                        break;
+                    }
+                    // hierarchy files hold the engine's numbering, which only matches a graph that was not reordered
+                    if (graph->labels != NULL) {
+                        printf("Hierarchy files cannot be used after reordering; reload the graph first.\n");
+                        break;
+                    }
+                    printf("Enter file name: ");
+                    scanf("%255s", fileName);
+                    if (choice == 2) {
+                        if (saveContractionHierarchy(hierarchy, fileName)) {
+                            printf("Saved hierarchy to %s\n", fileName);
+                        } else {
+                            printf("Failed to write %s\n", fileName);
+                        }
+                        break;
+                    }
+
+                    ContractionHierarchy* loaded = loadContractionHierarchy(fileName);
+                    if (loaded != NULL && loaded->numVertices != graph->numVertices) {
+                        printf("%s was built for a graph with %d vertices\n", fileName, loaded->numVertices);
+                        freeContractionHierarchy(loaded);
+                        loaded = NULL;
+                    }
+                    if (loaded != NULL) {
+                        if (hierarchy != NULL) {
+                            freeContractionHierarchy(hierarchy);
+                        }
+                        hierarchy = loaded;
+                        printf("Loaded hierarchy from %s\n", fileName);
+                    }
+                } else {
+                    printf("Invalid choice. Please try again.\n");
+                }
+                break;
+            }
+            case 8: {
+                printf("1. Breadth-first\n2. Reverse Cuthill-McKee\n3. Hubs first (degree)\nChoose an order: ");
+                scanf("%d", &choice);
+                if (choice < 1 || choice > 3) {
+                    printf("Invalid choice. Please try again.\n");
+                    break;
+                }
+
+                // vertices keep their ids on input and output, the engines only see the new numbering
+                double start = currentTime();
+                Graph* reordered = reorderGraph(graph, (VertexOrder)(choice - 1));
+                if (engine != NULL) {
+                    freeRoutingEngine(engine);
+                    engine = NULL;
+                }
+                if (hierarchy != NULL) {
+                    freeContractionHierarchy(hierarchy);
+                    hierarchy = NULL;
+                }
+                if (finder != NULL) {
+                    freePathFinder(finder);
+                    finder = NULL;
+                }
+                freeGraph(graph);
+                graph = reordered;
+                printf("Reordered %d vertices (%s) in %.3f s\n", graph->numVertices, vertexOrderName((VertexOrder)(choice - 1)),
+                       currentTime() - start);
+                break;
+            }
+            case 9:
+                printf("Enter source and target vertices: ");
+                scanf("%d %d", &src, &dest);
+                printf("1. K shortest loopless paths (Yen)\n2. Shortest path with at most N edges\nChoose a method: ");
+                scanf("%d", &choice);
+                if (choice < 1 || choice > 2) {
+                    printf("Invalid choice. Please try again.\n");
+                    break;
+                }
+                printf(choice == 1 ? "Enter number of routes k: " : "Enter maximum number of edges: ");
+                scanf("%d", &weight);
+                if (hasNegativeWeights(graph)) {
+                    printf("Alternative routes need non-negative weights\n");
+                    break;
+                }
+                if (finder == NULL) {
+                    finder = createPathFinder(graph);
+                }
+                if (choice == 1) {
+                    alternativeRoutes(finder, vertexIndex(graph, src), vertexIndex(graph, dest), weight);
+                } else {
+                    hopLimitedRoute(finder, vertexIndex(graph, src), vertexIndex(graph, dest), weight);
+                }
+                break;
+            case 10:
+                if (engine != NULL) {
+                    freeRoutingEngine(engine);
+                }
+                if (finder != NULL) {
+                    freePathFinder(finder);
+                }
+                if (hierarchy != NULL) {
+                    freeContractionHierarchy(hierarchy);
+                }
                 freeGraph(graph);
+                if (snapshot != NULL) {
+                    closeGraphSnapshot(snapshot);
+                }
                 return 0;
             default:
                 printf("Invalid choice. Please try again.\n");
@@ -65,7 +702,14 @@ int main() {
 Graph* createGraph(int vertices) {
     Graph* graph = malloc(sizeof(Graph));
     graph->numVertices = vertices;
+    graph->numEdges = 0;
     graph->adjList = malloc(vertices * sizeof(Edge*));
+    graph->offsets = NULL;
+    graph->targets = NULL;
+    graph->weights = NULL;
+    graph->mapped = 0;
+    graph->labels = NULL;
+    graph->vertexOf = NULL;
     
     for (int i = 0; i < vertices; i++) {
         graph->adjList[i] = NULL;
@@ -74,8 +718,56 @@ Graph* createGraph(int vertices) {
     return graph;
 }
 
+// function to bulk-load a finalized graph from parallel edge arrays (counting sort by source)
+Graph* createGraphFromEdges(int vertices, int edges, const int* src, const int* dest, const int* weight) {
+    Graph* graph = malloc(sizeof(Graph));
+    graph->numVertices = vertices;
+    graph->numEdges = edges;
+    graph->adjList = NULL;
+    graph->mapped = 0;
+    graph->labels = NULL;
+    graph->vertexOf = NULL;
+    graph->offsets = calloc(vertices + 1, sizeof(int));
+    graph->targets = malloc(edges * sizeof(int));
+    graph->weights = malloc(edges * sizeof(int));
+
+    for (int i = 0; i < edges; i++) {
+        graph->offsets[src[i] + 1]++;
+    }
+    for (int i = 0; i < vertices; i++) {
+        graph->offsets[i + 1] += graph->offsets[i];
+    }
+
+    // place edges in input order, using offsets[u] as the insertion cursor of u for now
+    for (int i = 0; i < edges; i++) {
+        int slot = graph->offsets[src[i]]++;
+        graph->targets[slot] = dest[i];
+        graph->weights[slot] = weight[i];
+    }
+    for (int i = vertices; i > 0; i--) {
+        graph->offsets[i] = graph->offsets[i - 1];
+    }
+    graph->offsets[0] = 0;
+
+    return graph;
+}
+
+// function to check a finalized graph for negative edge weights
+int hasNegativeWeights(Graph* graph) {
+    for (int e = 0; e < graph->numEdges; e++) {
+        if (graph->weights[e] < 0) return 1;
+    }
+    return 0;
+}
+
 // function to add an edge to the graph - directed graph
 void addEdge(Graph* graph, int src, int dest, int weight) {
+    if (graph->offsets != NULL) {
+        printf("Graph is finalized, edge %d -> %d was not added\n", src, dest);
+        return;
+    }
+
+    graph->numEdges++;
     Edge* newEdge = malloc(sizeof(Edge));
     newEdge->dest = dest;
     newEdge->weight = weight;
@@ -83,21 +775,40 @@ void addEdge(Graph* graph, int src, int dest, int weight) {
     graph->adjList[src] = newEdge;
 }
 
-// Dijkstra's algorithm - check for negative-weight cycles
-void dijkstra(Graph* graph, int startVertex) {
-    int* distances = malloc(graph->numVertices * sizeof(int));
-    int* visited = malloc(graph->numVertices * sizeof(int));
-    
+// function to freeze the adjacency lists into contiguous CSR arrays
+void finalizeGraph(Graph* graph) {
+    if (graph->offsets != NULL) return;
+
+    graph->offsets = malloc((graph->numVertices + 1) * sizeof(int));
+    graph->targets = malloc(graph->numEdges * sizeof(int));
+    graph->weights = malloc(graph->numEdges * sizeof(int));
+
+    int slot = 0;
     for (int i = 0; i < graph->numVertices; i++) {
-        distances[i] = INT_MAX;
-        visited[i] = 0;
+        graph->offsets[i] = slot;
+        Edge* edge = graph->adjList[i];
+        while (edge != NULL) {
+            Edge* temp = edge;
+            graph->targets[slot] = edge->dest;
+            graph->weights[slot] = edge->weight;
+            slot++;
+            edge = edge->next;
+            free(temp);
+        }
     }
+    graph->offsets[graph->numVertices] = slot;
 
-    distances[startVertex] = 0;
+    free(graph->adjList);
+    graph->adjList = NULL;
+}
+
+// Dijkstra's algorithm - linear scan for the closest unvisited vertex, O(V^2)
+static void dijkstraLinearScan(Graph* graph, int* distances) {
+    int* visited = calloc(graph->numVertices, sizeof(int));
 
     for (int i = 0; i < graph->numVertices - 1; i++) {
         int minDistance = INT_MAX;
-        int minVertex;
+        int minVertex = -1;
 
         for (int j = 0; j < graph->numVertices; j++) {
             if (!visited[j] && distances[j] < minDistance) {
@@ -106,88 +817,4825 @@ void dijkstra(Graph* graph, int startVertex) {
             }
         }
 
+        if (minVertex == -1) break; // remaining vertices are unreachable
         visited[minVertex] = 1;
 
-        Edge* edge = graph->adjList[minVertex];
-        while (edge != NULL) {
-            int newDistance = distances[minVertex] + edge->weight;
-            if (newDistance < distances[edge->dest]) {
-                distances[edge->dest] = newDistance;
+        for (int e = graph->offsets[minVertex]; e < graph->offsets[minVertex + 1]; e++) {
+            int newDistance = distances[minVertex] + graph->weights[e];
+            if (newDistance < distances[graph->targets[e]]) {
+                distances[graph->targets[e]] = newDistance;
             }
-            edge = edge->next;
         }
     }
 
-    printf("Dijkstra's Algorithm: Shortest distances from vertex %d:\n", startVertex);
-    for (int i = 0; i < graph->numVertices; i++) {
-        if (distances[i] == INT_MAX) {
-            printf("Vertex %d: INF\n", i);
-        } else {
-            printf("Vertex %d: %d\n", i, distances[i]);
+    free(visited);
+}
+
+// Dijkstra's algorithm - indexed binary heap with decrease-key, O((V + E) log V).
+// The heap must be keyed on distances and is left empty for the next query.
+static void runHeapDijkstra(Graph* graph, int startVertex, int* distances, IndexedHeap* heap) {
+    heapPush(heap, startVertex);
+
+    while (heap->size > 0) {
+        int u = heapPop(heap);
+
+        for (int e = graph->offsets[u]; e < graph->offsets[u + 1]; e++) {
+            int v = graph->targets[e];
+            int newDistance = distances[u] + graph->weights[e];
+            if (newDistance < distances[v]) {
+                distances[v] = newDistance;
+                if (heap->position[v] >= 0) {
+                    heapDecreaseKey(heap, v);
+                } else {
+                    heapPush(heap, v);
+                }
+            }
+        }
+    }
+}
+
+static void dijkstraBinaryHeap(Graph* graph, int startVertex, int* distances) {
+    IndexedHeap* heap = createIndexedHeap(graph->numVertices, distances);
+    runHeapDijkstra(graph, startVertex, distances, heap);
+    freeIndexedHeap(heap);
+}
+
+// Dijkstra's algorithm - radix heap, O(E + V log C) for non-negative integer weights
+static void dijkstraRadixHeap(Graph* graph, int startVertex, int* distances) {
+    RadixHeap* heap = createRadixHeap();
+    int* visited = calloc(graph->numVertices, sizeof(int));
+    radixPush(heap, 0, startVertex);
+
+    while (heap->size > 0) {
+        RadixEntry entry = radixPop(heap);
+        int u = entry.vertex;
+
+        // entries are never removed on decrease, so skip the stale copies
+        if (visited[u] || entry.key != (unsigned int)distances[u]) continue;
+        visited[u] = 1;
+
+        for (int e = graph->offsets[u]; e < graph->offsets[u + 1]; e++) {
+            int v = graph->targets[e];
+            int newDistance = distances[u] + graph->weights[e];
+            if (newDistance < distances[v]) {
+                distances[v] = newDistance;
+                radixPush(heap, newDistance, v);
+            }
         }
     }
 
-    free(distances);
     free(visited);
+    freeRadixHeap(heap);
 }
 
-// Bellman-Ford algorithm - check for negative-weight cycles
-void bellmanFord(Graph* graph, int startVertex) {
-    int* distances = malloc(graph->numVertices * sizeof(int));
-    
+// fill distances with shortest distances from startVertex (INT_MAX if unreachable)
+void computeDijkstra(Graph* graph, int startVertex, int* distances, QueueType queue) {
     for (int i = 0; i < graph->numVertices; i++) {
         distances[i] = INT_MAX;
     }
-    
     distances[startVertex] = 0;
 
-    for (int i = 0; i < graph->numVertices - 1; i++) {
+    switch (queue) {
+        case QUEUE_LINEAR_SCAN:
+            dijkstraLinearScan(graph, distances);
+            break;
+        case QUEUE_RADIX_HEAP:
+            dijkstraRadixHeap(graph, startVertex, distances);
+            break;
+        default:
+            dijkstraBinaryHeap(graph, startVertex, distances);
+            break;
+    }
+}
+
+// print one line per vertex, in the order of the ids the user knows them by
+static void printDistances(Graph* graph, const int* distances) {
+    for (int id = 0; id < graph->numVertices; id++) {
+        int v = vertexIndex(graph, id);
+        if (distances[v] == INT_MAX) {
+            printf("Vertex %d: INF\n", id);
+        } else {
+            printf("Vertex %d: %d\n", id, distances[v]);
+        }
+    }
+}
+
+// Dijkstra's algorithm - print the shortest distances from startVertex
+void dijkstra(Graph* graph, int startVertex, QueueType queue) {
+    if (startVertex < 0 || startVertex >= graph->numVertices) {
+        printf("Invalid starting vertex %d\n", startVertex);
+        return;
+    }
+
+    // a heap-based search never terminates on a negative cycle, so refuse negative weights
+    if (hasNegativeWeights(graph)) {
+        printf("Dijkstra's algorithm needs non-negative weights, use Bellman-Ford instead\n");
+        return;
+    }
+
+    int* distances = malloc(graph->numVertices * sizeof(int));
+    computeDijkstra(graph, startVertex, distances, queue);
+
+    printf("Dijkstra's Algorithm (%s): Shortest distances from vertex %d:\n", queueName(queue), vertexLabel(graph, startVertex));
+    printDistances(graph, distances);
+
+    free(distances);
+}
+
+// write the cycle through x of the parent graph into cycle, in edge order
+static int traceCycle(const int* parent, int x, int* cycle) {
+    int length = 0;
+    int y = x;
+    do {
+        cycle[length++] = y;
+        y = parent[y];
+    } while (y != x);
+
+    // parent pointers run against the edges, so reverse the walk
+    for (int i = 0, j = length - 1; i < j; i++, j--) {
+        int temp = cycle[i];
+        cycle[i] = cycle[j];
+        cycle[j] = temp;
+    }
+    return length;
+}
+
+// keep relaxing until the parent graph closes a cycle; returns 0 if nothing relaxes any more
+static int findNegativeCycle(Graph* graph, int* distances, int* parent, int* cycle) {
+    while (1) {
+        int relaxed = 0;
+
+        for (int u = 0; u < graph->numVertices; u++) {
+            if (distances[u] == INT_MAX) continue;
+            for (int e = graph->offsets[u]; e < graph->offsets[u + 1]; e++) {
+                int v = graph->targets[e];
+                if (distances[u] + graph->weights[e] >= distances[v]) continue;
+
+                distances[v] = distances[u] + graph->weights[e];
+                parent[v] = u;
+                relaxed = 1;
+
+                // V steps without reaching the root can only mean we are walking around a cycle
+                int x = v;
+                for (int i = 0; i < graph->numVertices && x != -1; i++) {
+                    x = parent[x];
+                }
+                if (x != -1) {
+                    return traceCycle(parent, x, cycle);
+                }
+            }
+        }
+
+        if (!relaxed) return 0;
+    }
+}
+
+// Bellman-Ford algorithm - full rounds over all edges, stopping after a round without changes
+static int bellmanFordClassic(Graph* graph, int* distances, int* parent, int* cycle) {
+    int changed = 1;
+
+    for (int i = 0; i < graph->numVertices - 1 && changed; i++) {
+        changed = 0;
         for (int j = 0; j < graph->numVertices; j++) {
-            Edge* edge = graph->adjList[j];
-            while (edge != NULL) {
-                if (distances[j] != INT_MAX && distances[j] + edge->weight < distances[edge->dest]) {
-                    distances[edge->dest] = distances[j] + edge->weight;
+            if (distances[j] == INT_MAX) continue;
+            for (int e = graph->offsets[j]; e < graph->offsets[j + 1]; e++) {
+                if (distances[j] + graph->weights[e] < distances[graph->targets[e]]) {
+                    distances[graph->targets[e]] = distances[j] + graph->weights[e];
+                    parent[graph->targets[e]] = j;
+                    changed = 1;
                 }
-                edge = edge->next;
             }
         }
     }
 
-    // check for negative-weight cycles in the graph
-    for (int j = 0; j < graph->numVertices; j++) {
-        Edge* edge = graph->adjList[j];
-        while (edge != NULL) {
-            if (distances[j] != INT_MAX && distances[j] + edge->weight < distances[edge->dest]) {
-                printf("Graph contains negative weight cycle\n");
-                free(distances);
-                return;
+    // distances only settle into a fixed point when there is no reachable negative cycle
+    return changed ? findNegativeCycle(graph, distances, parent, cycle) : 0;
+}
+
+// Bellman-Ford algorithm - FIFO work-list (SPFA) with Tarjan's subtree disassembly.
+// The shortest-path tree is kept as a preorder thread; when a vertex improves, its
+// old subtree is detached, and finding the relaxing vertex inside it proves a negative cycle.
+static int bellmanFordQueue(Graph* graph, int startVertex, int* distances, int* parent, int* cycle) {
+    int n = graph->numVertices;
+    int* queue = malloc(n * sizeof(int));
+    int* threadNext = malloc(n * sizeof(int));
+    int* threadPrev = malloc(n * sizeof(int));
+    int* depth = malloc(n * sizeof(int));
+    char* inQueue = calloc(n, 1);
+    char* inTree = calloc(n, 1);
+    int head = 0, count = 0, cycleLength = 0;
+
+    threadNext[startVertex] = threadPrev[startVertex] = startVertex;
+    depth[startVertex] = 0;
+    inTree[startVertex] = 1;
+    queue[0] = startVertex;
+    inQueue[startVertex] = 1;
+    count = 1;
+
+    while (count > 0 && cycleLength == 0) {
+        int u = queue[head];
+        head = (head + 1) % n;
+        count--;
+        inQueue[u] = 0;
+
+        // a vertex detached from the tree waits until a better distance re-attaches it
+        if (!inTree[u]) continue;
+
+        for (int e = graph->offsets[u]; e < graph->offsets[u + 1]; e++) {
+            int v = graph->targets[e];
+            int newDistance = distances[u] + graph->weights[e];
+            if (newDistance >= distances[v]) continue;
+
+            if (inTree[v]) {
+                if (v == u) {
+                    cycle[0] = u;
+                    cycleLength = 1;
+                    break;
+                }
+
+                // the subtree of v is the run after v in the thread with larger depth
+                int x = threadNext[v];
+                int found = 0;
+                while (x != startVertex && depth[x] > depth[v]) {
+                    if (x == u) {
+                        found = 1;
+                        break;
+                    }
+                    inTree[x] = 0;
+                    x = threadNext[x];
+                }
+                if (found) {
+                    int length = 0;
+                    for (int y = u; y != v; y = parent[y]) {
+                        cycle[length++] = y;
+                    }
+                    cycle[length++] = v;
+                    for (int i = 0, j = length - 1; i < j; i++, j--) {
+                        int temp = cycle[i];
+                        cycle[i] = cycle[j];
+                        cycle[j] = temp;
+                    }
+                    cycleLength = length;
+                    break;
+                }
+
+                threadNext[threadPrev[v]] = x;
+                threadPrev[x] = threadPrev[v];
+            }
+
+            distances[v] = newDistance;
+            parent[v] = u;
+            depth[v] = depth[u] + 1;
+            inTree[v] = 1;
+            threadNext[v] = threadNext[u];
+            threadPrev[threadNext[u]] = v;
+            threadNext[u] = v;
+            threadPrev[v] = u;
+
+            if (!inQueue[v]) {
+                queue[(head + count) % n] = v;
+                count++;
+                inQueue[v] = 1;
             }
-            edge = edge->next;
         }
     }
 
-    printf("Bellman-Ford Algorithm: Shortest distances from vertex %d:\n", startVertex);
-    for (int i = 0; i < graph->numVertices; i++) {
-        if (distances[i] == INT_MAX) {
-            printf("Vertex %d: INF\n", i);
+    free(queue);
+    free(threadNext);
+    free(threadPrev);
+    free(depth);
+    free(inQueue);
+    free(inTree);
+    return cycleLength;
+}
+
+// distance and parent packed into one word so both change in a single atomic update
+static unsigned long long packLabel(int distance, int parent) {
+    return ((unsigned long long)(unsigned int)distance << 32) | (unsigned int)parent;
+}
+
+static int labelDistance(unsigned long long label) {
+    return (int)(unsigned int)(label >> 32);
+}
+
+typedef struct ParallelRelaxation {
+    Graph* graph;
+    unsigned long long* labels;
+    int changed[3];
+    int rounds;
+    pthread_barrier_t barrier;
+} ParallelRelaxation;
+
+// first vertex whose edges start at or after edge index target
+static int vertexAtEdge(Graph* graph, long long target) {
+    int low = 0, high = graph->numVertices;
+    while (low < high) {
+        int mid = low + (high - low) / 2;
+        if (graph->offsets[mid] < target) {
+            low = mid + 1;
         } else {
-            printf("Vertex %d: %d\n", i, distances[i]);
+            high = mid;
         }
     }
+    return low;
+}
 
-    free(distances);
+static void* parallelRelaxationWorker(void* arg) {
+    ThreadArgs* args = arg;
+    ParallelRelaxation* shared = args->shared;
+    Graph* graph = shared->graph;
+    unsigned long long* labels = shared->labels;
+
+    // every thread owns a vertex range holding about the same number of edges
+    int first = vertexAtEdge(graph, (long long)graph->numEdges * args->threadId / args->numThreads);
+    int last = args->threadId == args->numThreads - 1 ? graph->numVertices
+             : vertexAtEdge(graph, (long long)graph->numEdges * (args->threadId + 1) / args->numThreads);
+
+    for (int round = 0; round < graph->numVertices - 1; round++) {
+        int changed = 0;
+
+        for (int u = first; u < last; u++) {
+            int du = labelDistance(__atomic_load_n(&labels[u], __ATOMIC_RELAXED));
+            if (du == INT_MAX) continue;
+
+            for (int e = graph->offsets[u]; e < graph->offsets[u + 1]; e++) {
+                unsigned long long* target = &labels[graph->targets[e]];
+                int newDistance = du + graph->weights[e];
+                unsigned long long label = packLabel(newDistance, u);
+                unsigned long long current = __atomic_load_n(target, __ATOMIC_RELAXED);
+
+                // atomic min on the distance half only: swapping parents on ties could close zero-weight cycles
+                while (newDistance < labelDistance(current)) {
+                    if (__atomic_compare_exchange_n(target, &current, label, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+                        changed = 1;
+                        break;
+                    }
+                }
+            }
+        }
+
+        // three rotating flags: the one reset here was last read two barriers ago
+        if (args->threadId == 0) {
+            __atomic_store_n(&shared->changed[(round + 1) % 3], 0, __ATOMIC_RELAXED);
+        }
+        if (changed) {
+            __atomic_store_n(&shared->changed[round % 3], 1, __ATOMIC_RELAXED);
+        }
+        pthread_barrier_wait(&shared->barrier);
+
+        if (!__atomic_load_n(&shared->changed[round % 3], __ATOMIC_RELAXED)) break;
+        if (args->threadId == 0) {
+            shared->rounds = round + 1;
+        }
+    }
+
+    return NULL;
 }
 
-// function to free the graph
-void freeGraph(Graph* graph) {
+// Bellman-Ford algorithm - each round's edges are split across threads with atomic-min updates
+static int bellmanFordParallel(Graph* graph, int startVertex, int* distances, int* parent, int* cycle, int numThreads) {
+    ParallelRelaxation shared;
+    shared.graph = graph;
+    shared.labels = malloc(graph->numVertices * sizeof(unsigned long long));
+    shared.changed[0] = shared.changed[1] = shared.changed[2] = 0;
+    shared.rounds = 0;
+    pthread_barrier_init(&shared.barrier, NULL, numThreads);
+
     for (int i = 0; i < graph->numVertices; i++) {
-        Edge* edge = graph->adjList[i];
-        while (edge != NULL) {
-            Edge* temp = edge;
-            edge = edge->next;
-            free(temp);
+        shared.labels[i] = packLabel(INT_MAX, -1);
+    }
+    shared.labels[startVertex] = packLabel(0, -1);
+
+    runThreads(numThreads, parallelRelaxationWorker, &shared);
+
+    for (int i = 0; i < graph->numVertices; i++) {
+        distances[i] = labelDistance(shared.labels[i]);
+        parent[i] = (int)(unsigned int)shared.labels[i];
+    }
+
+    pthread_barrier_destroy(&shared.barrier);
+    free(shared.labels);
+
+    // every round changed something, so the remaining check is done serially
+    if (shared.rounds == graph->numVertices - 1) {
+        return findNegativeCycle(graph, distances, parent, cycle);
+    }
+    return 0;
+}
+
+// relaxation kernels for the vectorized rounds. They pull along in-edges: the edge list is kept
+// sorted by destination (struct of arrays: the reverse graph's offsets, sources and weights), so
+// each vertex takes the minimum over its in-edges in registers and is written once, without
+// scatter conflicts between lanes.
+typedef enum RelaxKernel {
+    KERNEL_SCALAR,
+    KERNEL_AVX2,
+    KERNEL_AVX512
+} RelaxKernel;
+
+// one round over all vertices in id order; returns 1 if any distance dropped
+static int relaxIncomingScalar(Graph* incoming, int* distances, int* parent) {
+    int changed = 0;
+    for (int v = 0; v < incoming->numVertices; v++) {
+        int best = distances[v], bestSource = -1;
+        for (int e = incoming->offsets[v]; e < incoming->offsets[v + 1]; e++) {
+            int du = distances[incoming->targets[e]];
+            if (du != INT_MAX && du + incoming->weights[e] < best) {
+                best = du + incoming->weights[e];
+                bestSource = incoming->targets[e];
+            }
+        }
+        if (bestSource >= 0) {
+            distances[v] = best;
+            parent[v] = bestSource;
+            changed = 1;
         }
     }
-    free(graph->adjList);
-    free(graph);
-}
\ No newline at end of file
+    return changed;
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+// 8 in-edges at a time: masked loads and a gather of the source distances, lane-wise minimum
+__attribute__((target("avx2")))
+static int relaxIncomingAVX2(Graph* incoming, int* distances, int* parent) {
+    const __m256i unreachable = _mm256_set1_epi32(INT_MAX);
+    const __m256i laneIndex = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+    int changed = 0;
+
+    for (int v = 0; v < incoming->numVertices; v++) {
+        int end = incoming->offsets[v + 1];
+        __m256i best = unreachable;
+        __m256i bestSource = _mm256_setzero_si256();
+
+        for (int e = incoming->offsets[v]; e < end; e += 8) {
+            __m256i lanes = _mm256_cmpgt_epi32(_mm256_set1_epi32(end - e), laneIndex);
+            __m256i src = _mm256_maskload_epi32(incoming->targets + e, lanes);
+            __m256i du = _mm256_mask_i32gather_epi32(unreachable, distances, src, lanes, 4);
+            __m256i active = _mm256_andnot_si256(_mm256_cmpeq_epi32(du, unreachable), lanes);
+            __m256i candidate = _mm256_add_epi32(du, _mm256_maskload_epi32(incoming->weights + e, lanes));
+            __m256i better = _mm256_and_si256(active, _mm256_cmpgt_epi32(best, candidate));
+            best = _mm256_blendv_epi8(best, candidate, better);
+            bestSource = _mm256_blendv_epi8(bestSource, src, better);
+        }
+
+        __m256i minimum = _mm256_min_epi32(best, _mm256_permute2x128_si256(best, best, 1));
+        minimum = _mm256_min_epi32(minimum, _mm256_shuffle_epi32(minimum, _MM_SHUFFLE(1, 0, 3, 2)));
+        minimum = _mm256_min_epi32(minimum, _mm256_shuffle_epi32(minimum, _MM_SHUFFLE(2, 3, 0, 1)));
+        int bestDistance = _mm256_cvtsi256_si32(minimum);
+        if (bestDistance >= distances[v]) continue;
+
+        int lane = __builtin_ctz(_mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpeq_epi32(best, minimum))));
+        distances[v] = bestDistance;
+        parent[v] = _mm256_cvtsi256_si32(_mm256_permutevar8x32_epi32(bestSource, _mm256_set1_epi32(lane)));
+        changed = 1;
+    }
+    return changed;
+}
+
+// 16 in-edges at a time with mask registers for the tail and a reduce-min per vertex
+__attribute__((target("avx512f")))
+static int relaxIncomingAVX512(Graph* incoming, int* distances, int* parent) {
+    const __m512i unreachable = _mm512_set1_epi32(INT_MAX);
+    int changed = 0;
+
+    for (int v = 0; v < incoming->numVertices; v++) {
+        int end = incoming->offsets[v + 1];
+        __m512i best = unreachable;
+        __m512i bestSource = _mm512_setzero_si512();
+
+        for (int e = incoming->offsets[v]; e < end; e += 16) {
+            __mmask16 lanes = end - e >= 16 ? 0xFFFF : (__mmask16)((1u << (end - e)) - 1);
+            __m512i src = _mm512_maskz_loadu_epi32(lanes, incoming->targets + e);
+            __m512i du = _mm512_mask_i32gather_epi32(unreachable, lanes, src, distances, 4);
+            __mmask16 active = _mm512_mask_cmpneq_epi32_mask(lanes, du, unreachable);
+            __m512i candidate = _mm512_mask_add_epi32(unreachable, active, du, _mm512_maskz_loadu_epi32(lanes, incoming->weights + e));
+            __mmask16 better = _mm512_cmplt_epi32_mask(candidate, best);
+            best = _mm512_mask_mov_epi32(best, better, candidate);
+            bestSource = _mm512_mask_mov_epi32(bestSource, better, src);
+        }
+
+        int bestDistance = _mm512_reduce_min_epi32(best);
+        if (bestDistance >= distances[v]) continue;
+
+        int lane = __builtin_ctz(_mm512_cmpeq_epi32_mask(best, _mm512_set1_epi32(bestDistance)));
+        distances[v] = bestDistance;
+        parent[v] = _mm_cvtsi128_si32(_mm512_castsi512_si128(_mm512_permutexvar_epi32(_mm512_set1_epi32(lane), bestSource)));
+        changed = 1;
+    }
+    return changed;
+}
+#endif
+
+// widest kernel this CPU can run
+static RelaxKernel bestRelaxKernel() {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f")) return KERNEL_AVX512;
+    if (__builtin_cpu_supports("avx2")) return KERNEL_AVX2;
+#endif
+    return KERNEL_SCALAR;
+}
+
+static const char* relaxKernelName(RelaxKernel kernel) {
+    switch (kernel) {
+        case KERNEL_AVX512:
+            return "AVX-512";
+        case KERNEL_AVX2:
+            return "AVX2";
+        default:
+            return "scalar";
+    }
+}
+
+static int relaxIncoming(Graph* incoming, int* distances, int* parent, RelaxKernel kernel) {
+#if defined(__x86_64__) || defined(__i386__)
+    if (kernel == KERNEL_AVX512) return relaxIncomingAVX512(incoming, distances, parent);
+    if (kernel == KERNEL_AVX2) return relaxIncomingAVX2(incoming, distances, parent);
+#endif
+    return relaxIncomingScalar(incoming, distances, parent);
+}
+
+// Bellman-Ford algorithm - classic rounds over the destination-sorted edge list incoming
+// (createReverseGraph(graph)); distances and negative-cycle detection match the classic rounds,
+// only parents of ties may differ
+static int bellmanFordVectorized(Graph* graph, Graph* incoming, int* distances, int* parent, int* cycle, RelaxKernel kernel) {
+    int changed = 1;
+    for (int i = 0; i < graph->numVertices - 1 && changed; i++) {
+        changed = relaxIncoming(incoming, distances, parent, kernel);
+    }
+    return changed ? findNegativeCycle(graph, distances, parent, cycle) : 0;
+}
+
+// fill distances and parent from startVertex; returns the length of a negative cycle written to cycle, or 0
+int computeBellmanFord(Graph* graph, int startVertex, int* distances, int* parent, int* cycle, BellmanFordMode mode, int numThreads) {
+    if (mode == BF_PARALLEL && numThreads > 1) {
+        return bellmanFordParallel(graph, startVertex, distances, parent, cycle, numThreads);
+    }
+
+    for (int i = 0; i < graph->numVertices; i++) {
+        distances[i] = INT_MAX;
+        parent[i] = -1;
+    }
+    distances[startVertex] = 0;
+
+    if (mode == BF_QUEUE) {
+        return bellmanFordQueue(graph, startVertex, distances, parent, cycle);
+    }
+    if (mode == BF_VECTOR) {
+        Graph* incoming = createReverseGraph(graph);
+        int cycleLength = bellmanFordVectorized(graph, incoming, distances, parent, cycle, bestRelaxKernel());
+        freeGraph(incoming);
+        return cycleLength;
+    }
+    return bellmanFordClassic(graph, distances, parent, cycle);
+}
+
+// Bellman-Ford algorithm - print the shortest distances or the negative-weight cycle found
+void bellmanFord(Graph* graph, int startVertex, BellmanFordMode mode, int numThreads) {
+    if (startVertex < 0 || startVertex >= graph->numVertices) {
+        printf("Invalid starting vertex %d\n", startVertex);
+        return;
+    }
+
+    int* distances = malloc(graph->numVertices * sizeof(int));
+    int* parent = malloc(graph->numVertices * sizeof(int));
+    int* cycle = malloc(graph->numVertices * sizeof(int));
+    int cycleLength = computeBellmanFord(graph, startVertex, distances, parent, cycle, mode, numThreads);
+
+    if (cycleLength > 0) {
+        printf("Graph contains negative weight cycle: ");
+        for (int i = 0; i < cycleLength; i++) {
+            printf("%d -> ", vertexLabel(graph, cycle[i]));
+        }
+        printf("%d\n", vertexLabel(graph, cycle[0]));
+    } else {
+        printf("Bellman-Ford Algorithm (%s): Shortest distances from vertex %d:\n", bellmanFordModeName(mode), vertexLabel(graph, startVertex));
+        printDistances(graph, distances);
+    }
+
+    free(distances);
+    free(parent);
+    free(cycle);
+}
+
+static void vertexListPush(VertexList* list, int vertex) {
+    if (list->size == list->capacity) {
+        list->capacity = list->capacity ? list->capacity * 2 : 64;
+        list->items = realloc(list->items, list->capacity * sizeof(int));
+    }
+    list->items[list->size++] = vertex;
+}
+
+// shared state of one delta-stepping run; bins and settled lists are per thread
+typedef struct DeltaStepping {
+    Graph* graph;
+    int* distances;
+    int delta;
+    int numSlots;
+    VertexList* bins;
+    VertexList* settled;
+    int* settledBucket;
+    int* counts;
+    int* nextOffset;
+    int* frontier;
+    int frontierSize;
+    int frontierCapacity;
+    int nextIndex;
+    int currentBucket;
+    int done;
+    pthread_barrier_t barrier;
+} DeltaStepping;
+
+// lower *target to value; returns 1 if this call lowered it
+static int atomicMin(int* target, int value) {
+    int current = __atomic_load_n(target, __ATOMIC_RELAXED);
+    while (value < current) {
+        if (__atomic_compare_exchange_n(target, &current, value, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// relax the light (w <= delta) or heavy (w > delta) edges of u into this thread's bins
+static void relaxDeltaEdges(DeltaStepping* shared, VertexList* bins, int u, int distance, int light) {
+    Graph* graph = shared->graph;
+
+    for (int e = graph->offsets[u]; e < graph->offsets[u + 1]; e++) {
+        if ((graph->weights[e] <= shared->delta) != light) continue;
+        int newDistance = distance + graph->weights[e];
+        if (atomicMin(&shared->distances[graph->targets[e]], newDistance)) {
+            vertexListPush(&bins[(newDistance / shared->delta) % shared->numSlots], graph->targets[e]);
+        }
+    }
+}
+
+// move every thread's entries of the current bucket into the shared frontier
+static void gatherBucket(DeltaStepping* shared, ThreadArgs* args) {
+    VertexList* bin = &shared->bins[args->threadId * shared->numSlots + shared->currentBucket % shared->numSlots];
+
+    shared->counts[args->threadId] = bin->size;
+    pthread_barrier_wait(&shared->barrier);
+
+    if (args->threadId == 0) {
+        int total = 0;
+        for (int t = 0; t < args->numThreads; t++) {
+            int count = shared->counts[t];
+            shared->counts[t] = total;
+            total += count;
+        }
+        if (total > shared->frontierCapacity) {
+            shared->frontierCapacity = total;
+            shared->frontier = realloc(shared->frontier, total * sizeof(int));
+        }
+        shared->frontierSize = total;
+        shared->nextIndex = 0;
+    }
+    pthread_barrier_wait(&shared->barrier);
+
+    if (bin->size > 0) {
+        memcpy(shared->frontier + shared->counts[args->threadId], bin->items, bin->size * sizeof(int));
+        bin->size = 0;
+    }
+    pthread_barrier_wait(&shared->barrier);
+}
+
+static void* deltaSteppingWorker(void* arg) {
+    ThreadArgs* args = arg;
+    DeltaStepping* shared = args->shared;
+    VertexList* bins = &shared->bins[args->threadId * shared->numSlots];
+    VertexList* settled = &shared->settled[args->threadId];
+
+    while (1) {
+        gatherBucket(shared, args);
+        int bucket = shared->currentBucket;
+
+        if (shared->frontierSize > 0) {
+            // light phase: vertices may fall back into this bucket, so repeat until it stays empty
+            while (1) {
+                int first = __atomic_fetch_add(&shared->nextIndex, 64, __ATOMIC_RELAXED);
+                if (first >= shared->frontierSize) break;
+                int last = first + 64 < shared->frontierSize ? first + 64 : shared->frontierSize;
+
+                for (int i = first; i < last; i++) {
+                    int u = shared->frontier[i];
+                    int distance = __atomic_load_n(&shared->distances[u], __ATOMIC_RELAXED);
+                    if (distance / shared->delta != bucket) continue; // stale entry
+
+                    int previous = __atomic_exchange_n(&shared->settledBucket[u], bucket, __ATOMIC_RELAXED);
+                    if (previous != bucket) {
+                        vertexListPush(settled, u);
+                    }
+                    relaxDeltaEdges(shared, bins, u, distance, 1);
+                }
+            }
+            pthread_barrier_wait(&shared->barrier);
+            continue;
+        }
+
+        // heavy phase: the bucket is settled, heavy edges can only reach later buckets
+        for (int i = 0; i < settled->size; i++) {
+            int u = settled->items[i];
+            relaxDeltaEdges(shared, bins, u, shared->distances[u], 0);
+        }
+        settled->size = 0;
+
+        int offset = 0;
+        for (int k = 1; k < shared->numSlots; k++) {
+            if (bins[(bucket + k) % shared->numSlots].size > 0) {
+                offset = k;
+                break;
+            }
+        }
+        shared->nextOffset[args->threadId] = offset;
+        pthread_barrier_wait(&shared->barrier);
+
+        if (args->threadId == 0) {
+            int next = 0;
+            for (int t = 0; t < args->numThreads; t++) {
+                if (shared->nextOffset[t] > 0 && (next == 0 || shared->nextOffset[t] < next)) {
+                    next = shared->nextOffset[t];
+                }
+            }
+            shared->done = next == 0;
+            shared->currentBucket += next;
+        }
+        pthread_barrier_wait(&shared->barrier);
+
+        if (shared->done) break;
+    }
+
+    return NULL;
+}
+
+// pick a bucket width of about the maximum weight over the average degree
+int defaultDelta(Graph* graph) {
+    int maxWeight = 0;
+    for (int e = 0; e < graph->numEdges; e++) {
+        if (graph->weights[e] > maxWeight) {
+            maxWeight = graph->weights[e];
+        }
+    }
+
+    int averageDegree = graph->numVertices > 0 ? graph->numEdges / graph->numVertices : 0;
+    int delta = averageDegree > 0 ? maxWeight / averageDegree : maxWeight;
+    return delta > 0 ? delta : 1;
+}
+
+// the bucket width actually used for delta (0 or less picks defaultDelta()): raised where needed
+// so that the maxWeight / delta + 2 cyclic bins per thread stay within a few times the vertex
+// count and MAX_DELTA_SLOTS
+int boundedDelta(Graph* graph, int delta) {
+    int maxWeight = 0;
+    for (int e = 0; e < graph->numEdges; e++) {
+        if (graph->weights[e] > maxWeight) {
+            maxWeight = graph->weights[e];
+        }
+    }
+
+    long long maxSlots = 4LL * graph->numVertices;
+    maxSlots = maxSlots < MIN_DELTA_SLOTS ? MIN_DELTA_SLOTS : maxSlots > MAX_DELTA_SLOTS ? MAX_DELTA_SLOTS : maxSlots;
+    int minDelta = (int)((maxWeight + maxSlots - 3) / (maxSlots - 2));
+    if (delta <= 0) {
+        delta = defaultDelta(graph);
+    }
+    return delta > minDelta ? delta : minDelta > 0 ? minDelta : 1;
+}
+
+// delta-stepping SSSP (Meyer & Sanders): buckets of width delta are settled in order, with
+// light edges relaxed repeatedly inside a bucket and heavy edges once it is settled.
+// Requires non-negative weights; gives the same distances as computeDijkstra(). Returns the
+// delta used (see boundedDelta()), or -1 if there is not enough memory.
+int computeDeltaStepping(Graph* graph, int startVertex, int* distances, int delta, int numThreads) {
+    DeltaStepping shared;
+    int maxWeight = 0;
+
+    for (int e = 0; e < graph->numEdges; e++) {
+        if (graph->weights[e] > maxWeight) {
+            maxWeight = graph->weights[e];
+        }
+    }
+    delta = boundedDelta(graph, delta);
+
+    // pending entries never lie more than maxWeight / delta + 1 buckets ahead, so the bins are cyclic
+    shared.graph = graph;
+    shared.distances = distances;
+    shared.delta = delta;
+    shared.numSlots = maxWeight / delta + 2;
+    shared.bins = calloc((size_t)numThreads * shared.numSlots, sizeof(VertexList));
+    shared.settled = calloc(numThreads, sizeof(VertexList));
+    shared.settledBucket = malloc(graph->numVertices * sizeof(int));
+    shared.counts = malloc(numThreads * sizeof(int));
+    shared.nextOffset = malloc(numThreads * sizeof(int));
+    if (shared.bins == NULL || shared.settled == NULL || shared.settledBucket == NULL || shared.counts == NULL
+        || shared.nextOffset == NULL) {
+        free(shared.bins);
+        free(shared.settled);
+        free(shared.settledBucket);
+        free(shared.counts);
+        free(shared.nextOffset);
+        return -1;
+    }
+    shared.frontier = NULL;
+    shared.frontierSize = 0;
+    shared.frontierCapacity = 0;
+    shared.currentBucket = 0;
+    shared.done = 0;
+    pthread_barrier_init(&shared.barrier, NULL, numThreads);
+
+    for (int i = 0; i < graph->numVertices; i++) {
+        distances[i] = INT_MAX;
+        shared.settledBucket[i] = -1;
+    }
+    distances[startVertex] = 0;
+    vertexListPush(&shared.bins[0], startVertex);
+
+    runThreads(numThreads, deltaSteppingWorker, &shared);
+
+    for (int i = 0; i < numThreads * shared.numSlots; i++) {
+        free(shared.bins[i].items);
+    }
+    for (int i = 0; i < numThreads; i++) {
+        free(shared.settled[i].items);
+    }
+    pthread_barrier_destroy(&shared.barrier);
+    free(shared.bins);
+    free(shared.settled);
+    free(shared.settledBucket);
+    free(shared.counts);
+    free(shared.nextOffset);
+    free(shared.frontier);
+    return delta;
+}
+
+// delta-stepping - print the shortest distances from startVertex
+void deltaStepping(Graph* graph, int startVertex, int delta, int numThreads) {
+    if (startVertex < 0 || startVertex >= graph->numVertices) {
+        printf("Invalid starting vertex %d\n", startVertex);
+        return;
+    }
+    if (hasNegativeWeights(graph)) {
+        printf("Delta-stepping needs non-negative weights, use Bellman-Ford instead\n");
+        return;
+    }
+
+    int* distances = malloc(graph->numVertices * sizeof(int));
+    delta = computeDeltaStepping(graph, startVertex, distances, delta, numThreads);
+    if (delta < 0) {
+        printf("Not enough memory for delta-stepping\n");
+        free(distances);
+        return;
+    }
+
+    printf("Delta-stepping (delta %d, %d threads): Shortest distances from vertex %d:\n", delta, numThreads, vertexLabel(graph, startVertex));
+    printDistances(graph, distances);
+
+    free(distances);
+}
+
+// function to create the scratch arrays for repeated queries on graphs of up to capacity vertices
+DijkstraWorkspace* createDijkstraWorkspace(int capacity) {
+    DijkstraWorkspace* ws = malloc(sizeof(DijkstraWorkspace));
+    ws->capacity = capacity;
+    ws->distances = calloc(capacity, sizeof(int));
+    ws->heap = createIndexedHeap(capacity, ws->distances);
+    return ws;
+}
+
+void freeDijkstraWorkspace(DijkstraWorkspace* ws) {
+    freeIndexedHeap(ws->heap);
+    free(ws->distances);
+    free(ws);
+}
+
+// binary-heap Dijkstra into ws->distances without allocating anything
+void workspaceDijkstra(Graph* graph, int startVertex, DijkstraWorkspace* ws) {
+    for (int i = 0; i < graph->numVertices; i++) {
+        ws->distances[i] = INT_MAX;
+    }
+    ws->distances[startVertex] = 0;
+    runHeapDijkstra(graph, startVertex, ws->distances, ws->heap);
+}
+
+// a range of source rows; the owner takes from the front, thieves split off the back half
+typedef struct WorkRange {
+    int next;
+    int end;
+    pthread_mutex_t lock;
+} WorkRange;
+
+typedef struct DistanceBatch {
+    Graph* graph;
+    const int* sources;
+    const int* potential;
+    int* matrix;
+    int fd;
+    int failed;
+    WorkRange* ranges;
+} DistanceBatch;
+
+// next row for thread self: from its own range, or by stealing half of another thread's
+static int takeWork(WorkRange* ranges, int self, int numThreads) {
+    pthread_mutex_lock(&ranges[self].lock);
+    if (ranges[self].next < ranges[self].end) {
+        int row = ranges[self].next++;
+        pthread_mutex_unlock(&ranges[self].lock);
+        return row;
+    }
+    pthread_mutex_unlock(&ranges[self].lock);
+
+    for (int i = 1; i < numThreads; i++) {
+        WorkRange* victim = &ranges[(self + i) % numThreads];
+        pthread_mutex_lock(&victim->lock);
+        int remaining = victim->end - victim->next;
+        if (remaining == 0) {
+            pthread_mutex_unlock(&victim->lock);
+            continue;
+        }
+        int stolenEnd = victim->end;
+        victim->end -= (remaining + 1) / 2;
+        int stolenStart = victim->end;
+        pthread_mutex_unlock(&victim->lock);
+
+        pthread_mutex_lock(&ranges[self].lock);
+        ranges[self].next = stolenStart + 1;
+        ranges[self].end = stolenEnd;
+        pthread_mutex_unlock(&ranges[self].lock);
+        return stolenStart;
+    }
+
+    return -1;
+}
+
+static void* distanceBatchWorker(void* arg) {
+    ThreadArgs* args = arg;
+    DistanceBatch* batch = args->shared;
+    Graph* graph = batch->graph;
+    DijkstraWorkspace* ws = createDijkstraWorkspace(graph->numVertices);
+    int* userOrder = batch->fd >= 0 && graph->labels != NULL ? malloc(graph->numVertices * sizeof(int)) : NULL;
+    int row;
+
+    while ((row = takeWork(batch->ranges, args->threadId, args->numThreads)) >= 0) {
+        int source = batch->sources[row];
+        workspaceDijkstra(graph, source, ws);
+
+        // undo Johnson's reweighting: d(s, v) = d'(s, v) - h(s) + h(v)
+        if (batch->potential != NULL) {
+            for (int v = 0; v < graph->numVertices; v++) {
+                if (ws->distances[v] != INT_MAX) {
+                    ws->distances[v] += batch->potential[v] - batch->potential[source];
+                }
+            }
+        }
+
+        if (batch->matrix != NULL) {
+            memcpy(batch->matrix + (size_t)row * graph->numVertices, ws->distances, graph->numVertices * sizeof(int));
+        }
+        if (batch->fd >= 0) {
+            // after reorderGraph() the file columns still follow the ids the user knows
+            const int* distances = ws->distances;
+            if (userOrder != NULL) {
+                for (int v = 0; v < graph->numVertices; v++) {
+                    userOrder[graph->labels[v]] = ws->distances[v];
+                }
+                distances = userOrder;
+            }
+            size_t rowBytes = (size_t)graph->numVertices * sizeof(int);
+            off_t offset = DISTANCE_MATRIX_HEADER + (off_t)row * rowBytes;
+            if (pwrite(batch->fd, distances, rowBytes, offset) != (ssize_t)rowBytes) {
+                batch->failed = 1;
+            }
+        }
+    }
+
+    free(userOrder);
+    freeDijkstraWorkspace(ws);
+    return NULL;
+}
+
+// run one Dijkstra per source on a work-stealing pool; rows go to matrix and/or the file fd
+static int runDistanceBatch(Graph* graph, const int* sources, int numSources, const int* potential,
+                            int* matrix, int fd, int numThreads) {
+    DistanceBatch batch = { graph, sources, potential, matrix, fd, 0, NULL };
+
+    if (fd >= 0) {
+        int header[3] = { DISTANCE_MATRIX_MAGIC, numSources, graph->numVertices };
+        if (pwrite(fd, header, sizeof(header), 0) != (ssize_t)sizeof(header)) return -1;
+    }
+
+    if (numThreads > numSources) {
+        numThreads = numSources > 0 ? numSources : 1;
+    }
+    batch.ranges = malloc(numThreads * sizeof(WorkRange));
+    for (int t = 0; t < numThreads; t++) {
+        batch.ranges[t].next = (int)((long long)numSources * t / numThreads);
+        batch.ranges[t].end = (int)((long long)numSources * (t + 1) / numThreads);
+        pthread_mutex_init(&batch.ranges[t].lock, NULL);
+    }
+
+    runThreads(numThreads, distanceBatchWorker, &batch);
+
+    for (int t = 0; t < numThreads; t++) {
+        pthread_mutex_destroy(&batch.ranges[t].lock);
+    }
+    free(batch.ranges);
+    return batch.failed ? -1 : 0;
+}
+
+// distance matrix for non-negative weights: row i holds the distances from sources[i].
+// matrix (numSources x V) may be NULL when the rows are only streamed to fd (-1 for none);
+// the file is a 3-int header (magic, rows, columns) followed by the rows, whose columns are in
+// the order of the vertex ids the user knows (see vertexLabel()). Returns -1 on write errors.
+int computeDistanceMatrix(Graph* graph, const int* sources, int numSources, int* matrix, int fd, int numThreads) {
+    return runDistanceBatch(graph, sources, numSources, NULL, matrix, fd, numThreads);
+}
+
+// Johnson's algorithm: one Bellman-Ford from a virtual vertex gives potentials h that make
+// every weight w + h(u) - h(v) non-negative, then the sources run as a Dijkstra batch.
+// Returns the length of a negative cycle written to cycle, 0 on success, -1 on write errors.
+int computeJohnson(Graph* graph, const int* sources, int numSources, int* matrix, int fd, int numThreads, int* cycle) {
+    int n = graph->numVertices;
+    int* src = malloc((graph->numEdges + n) * sizeof(int));
+    int* dest = malloc((graph->numEdges + n) * sizeof(int));
+    int* weight = malloc((graph->numEdges + n) * sizeof(int));
+
+    // virtual vertex n with a zero-weight edge to every vertex
+    for (int u = 0; u < n; u++) {
+        for (int e = graph->offsets[u]; e < graph->offsets[u + 1]; e++) {
+            src[e] = u;
+            dest[e] = graph->targets[e];
+            weight[e] = graph->weights[e];
+        }
+        src[graph->numEdges + u] = n;
+        dest[graph->numEdges + u] = u;
+        weight[graph->numEdges + u] = 0;
+    }
+    Graph* augmented = createGraphFromEdges(n + 1, graph->numEdges + n, src, dest, weight);
+    free(src);
+    free(dest);
+    free(weight);
+
+    int* potential = malloc((n + 1) * sizeof(int));
+    int* parent = malloc((n + 1) * sizeof(int));
+    int* augmentedCycle = malloc((n + 1) * sizeof(int));
+    int cycleLength = computeBellmanFord(augmented, n, potential, parent, augmentedCycle, BF_QUEUE, 1);
+    freeGraph(augmented);
+    free(parent);
+
+    int result = cycleLength;
+    if (cycleLength > 0) {
+        // the virtual vertex has no incoming edges, so it is never on the cycle
+        memcpy(cycle, augmentedCycle, cycleLength * sizeof(int));
+    } else {
+        // the reweighted graph shares the CSR structure and only swaps in new weights
+        Graph reweighted = *graph;
+        reweighted.weights = malloc(graph->numEdges * sizeof(int));
+        for (int u = 0; u < n; u++) {
+            for (int e = graph->offsets[u]; e < graph->offsets[u + 1]; e++) {
+                reweighted.weights[e] = graph->weights[e] + potential[u] - potential[graph->targets[e]];
+            }
+        }
+        result = runDistanceBatch(&reweighted, sources, numSources, potential, matrix, fd, numThreads);
+        free(reweighted.weights);
+    }
+
+    free(potential);
+    free(augmentedCycle);
+    return result;
+}
+
+// distance matrix - menu entry; uses Johnson's reweighting when the graph has negative weights
+void distanceMatrix(Graph* graph, const int* sources, int numSources, const char* outputFile, int numThreads) {
+    int hasNegative = hasNegativeWeights(graph);
+
+    int fd = -1;
+    int* matrix = NULL;
+    if (outputFile != NULL) {
+        fd = open(outputFile, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0) {
+            perror("Failed to open output file");
+            return;
+        }
+    } else {
+        matrix = malloc((size_t)numSources * graph->numVertices * sizeof(int));
+    }
+
+    int* cycle = malloc(graph->numVertices * sizeof(int));
+    double start = currentTime();
+    int result = hasNegative ? computeJohnson(graph, sources, numSources, matrix, fd, numThreads, cycle)
+                             : computeDistanceMatrix(graph, sources, numSources, matrix, fd, numThreads);
+    double elapsed = currentTime() - start;
+
+    if (result > 0) {
+        printf("Graph contains negative weight cycle: ");
+        for (int i = 0; i < result; i++) {
+            printf("%d -> ", vertexLabel(graph, cycle[i]));
+        }
+        printf("%d\n", vertexLabel(graph, cycle[0]));
+    } else if (result < 0) {
+        printf("Failed to write the distance matrix\n");
+    } else if (matrix != NULL) {
+        printf("Distance matrix (%s):\n", hasNegative ? "Johnson's algorithm" : "Dijkstra batch");
+        for (int i = 0; i < numSources; i++) {
+            printf("From %d:", vertexLabel(graph, sources[i]));
+            for (int id = 0; id < graph->numVertices; id++) {
+                int distance = matrix[(size_t)i * graph->numVertices + vertexIndex(graph, id)];
+                if (distance == INT_MAX) {
+                    printf(" INF");
+                } else {
+                    printf(" %d", distance);
+                }
+            }
+            printf("\n");
+        }
+    } else {
+        printf("Wrote %d x %d distance matrix to %s in %.3f s (%s)\n", numSources, graph->numVertices,
+               outputFile, elapsed, hasNegative ? "Johnson's algorithm" : "Dijkstra batch");
+    }
+
+    if (fd >= 0) {
+        close(fd);
+    }
+    free(matrix);
+    free(cycle);
+}
+
+// function to create the transpose of a finalized graph (every edge reversed)
+Graph* createReverseGraph(Graph* graph) {
+    int* src = malloc(graph->numEdges * sizeof(int));
+    int* dest = malloc(graph->numEdges * sizeof(int));
+
+    for (int u = 0; u < graph->numVertices; u++) {
+        for (int e = graph->offsets[u]; e < graph->offsets[u + 1]; e++) {
+            src[e] = graph->targets[e];
+            dest[e] = u;
+        }
+    }
+
+    Graph* reverse = createGraphFromEdges(graph->numVertices, graph->numEdges, src, dest, graph->weights);
+    free(src);
+    free(dest);
+    return reverse;
+}
+
+static void createSearchSide(SearchSide* side, int capacity) {
+    side->distances = malloc(capacity * sizeof(int));
+    side->parent = malloc(capacity * sizeof(int));
+    side->keys = calloc(capacity, sizeof(int));
+    side->stamp = calloc(capacity, sizeof(int));
+    side->heap = createIndexedHeap(capacity, side->keys);
+}
+
+static void freeSearchSide(SearchSide* side) {
+    free(side->distances);
+    free(side->parent);
+    free(side->keys);
+    free(side->stamp);
+    freeIndexedHeap(side->heap);
+}
+
+// labels from earlier queries are ignored through the stamp, so nothing is reset per query
+static int sideDistance(SearchSide* side, int v, int query) {
+    return side->stamp[v] == query ? side->distances[v] : INT_MAX;
+}
+
+// place or lower the label of v and its heap entry
+static void sideUpdate(SearchSide* side, int v, int distance, int parent, int key, int query) {
+    side->stamp[v] = query;
+    side->distances[v] = distance;
+    side->parent[v] = parent;
+    side->keys[v] = key;
+    if (side->heap->position[v] >= 0) {
+        heapDecreaseKey(side->heap, v);
+    } else {
+        heapPush(side->heap, v);
+    }
+}
+
+static void heapClear(IndexedHeap* heap) {
+    for (int i = 0; i < heap->size; i++) {
+        heap->position[heap->heap[i]] = -1;
+    }
+    heap->size = 0;
+}
+
+// pick landmarks far apart: each one maximizes the distance to the landmarks chosen before it
+static void selectLandmarks(RoutingEngine* engine, int count) {
+    Graph* graph = engine->graph;
+    int n = graph->numVertices;
+    int* closest = malloc(n * sizeof(int));
+    int next = 0;
+
+    engine->numLandmarks = count;
+    engine->landmarks = malloc(count * sizeof(int));
+    engine->fromLandmark = malloc((size_t)count * n * sizeof(int));
+    engine->toLandmark = malloc((size_t)count * n * sizeof(int));
+
+    // start from the vertex farthest from vertex 0
+    computeDijkstra(graph, 0, closest, QUEUE_BINARY_HEAP);
+    for (int v = 0; v < n; v++) {
+        if (closest[v] != INT_MAX && closest[v] > closest[next]) {
+            next = v;
+        }
+    }
+    for (int v = 0; v < n; v++) {
+        closest[v] = INT_MAX;
+    }
+
+    for (int i = 0; i < count; i++) {
+        int* from = engine->fromLandmark + (size_t)i * n;
+        engine->landmarks[i] = next;
+        computeDijkstra(graph, next, from, QUEUE_BINARY_HEAP);
+        computeDijkstra(engine->reverse, next, engine->toLandmark + (size_t)i * n, QUEUE_BINARY_HEAP);
+
+        // prefer reachable vertices with the largest distance to their closest landmark
+        next = engine->landmarks[0];
+        for (int v = 0; v < n; v++) {
+            if (from[v] < closest[v]) {
+                closest[v] = from[v];
+            }
+            if (closest[v] != INT_MAX && (closest[next] == INT_MAX || closest[v] > closest[next])) {
+                next = v;
+            }
+        }
+    }
+
+    free(closest);
+}
+
+// function to build the point-to-point query engine; landmark tables cost 2 Dijkstras per landmark
+RoutingEngine* createRoutingEngine(Graph* graph, int numLandmarks) {
+    RoutingEngine* engine = malloc(sizeof(RoutingEngine));
+    engine->graph = graph;
+    engine->reverse = createReverseGraph(graph);
+    engine->query = 0;
+    engine->settled = 0;
+    createSearchSide(&engine->forward, graph->numVertices);
+    createSearchSide(&engine->backward, graph->numVertices);
+
+    if (numLandmarks > graph->numVertices) {
+        numLandmarks = graph->numVertices;
+    }
+    selectLandmarks(engine, numLandmarks);
+    return engine;
+}
+
+void freeRoutingEngine(RoutingEngine* engine) {
+    freeGraph(engine->reverse);
+    freeSearchSide(&engine->forward);
+    freeSearchSide(&engine->backward);
+    free(engine->landmarks);
+    free(engine->fromLandmark);
+    free(engine->toLandmark);
+    free(engine);
+}
+
+// ALT lower bound on d(v, target) from the triangle inequality over all landmarks;
+// -1 when v provably cannot reach the target
+static int landmarkBound(RoutingEngine* engine, int v, int target) {
+    int n = engine->graph->numVertices;
+    int bound = 0;
+
+    for (int i = 0; i < engine->numLandmarks; i++) {
+        const int* from = engine->fromLandmark + (size_t)i * n;
+        const int* to = engine->toLandmark + (size_t)i * n;
+
+        if (to[target] != INT_MAX) {
+            if (to[v] == INT_MAX) return -1;
+            if (to[v] - to[target] > bound) {
+                bound = to[v] - to[target];
+            }
+        }
+        if (from[target] != INT_MAX && from[v] != INT_MAX && from[target] - from[v] > bound) {
+            bound = from[target] - from[v];
+        }
+    }
+
+    return bound;
+}
+
+// Dijkstra from source that stops once target is settled; with landmarks it becomes A* (ALT)
+static int searchToTarget(RoutingEngine* engine, int source, int target, int useLandmarks) {
+    Graph* graph = engine->graph;
+    SearchSide* side = &engine->forward;
+    int query = engine->query;
+    int result = INT_MAX;
+
+    int bound = useLandmarks ? landmarkBound(engine, source, target) : 0;
+    if (bound < 0) return INT_MAX;
+    sideUpdate(side, source, 0, -1, bound, query);
+
+    while (side->heap->size > 0) {
+        int u = heapPop(side->heap);
+        engine->settled++;
+        if (u == target) {
+            result = side->distances[u];
+            break;
+        }
+
+        for (int e = graph->offsets[u]; e < graph->offsets[u + 1]; e++) {
+            int v = graph->targets[e];
+            int newDistance = side->distances[u] + graph->weights[e];
+            if (newDistance >= sideDistance(side, v, query)) continue;
+
+            // the bound only depends on v, so reuse it when v was reached before
+            if (useLandmarks) {
+                bound = side->stamp[v] == query ? side->keys[v] - side->distances[v] : landmarkBound(engine, v, target);
+                if (bound < 0) continue;
+            }
+            sideUpdate(side, v, newDistance, u, newDistance + bound, query);
+        }
+    }
+
+    heapClear(side->heap);
+    return result;
+}
+
+// bidirectional Dijkstra: forward from source, backward on the reverse graph from target,
+// stopping when the two queue minimums together reach the best meeting distance
+static int bidirectionalSearch(RoutingEngine* engine, int source, int target, int* meeting) {
+    SearchSide* sides[2] = { &engine->forward, &engine->backward };
+    Graph* graphs[2] = { engine->graph, engine->reverse };
+    int query = engine->query;
+    int best = INT_MAX;
+
+    sideUpdate(sides[0], source, 0, -1, 0, query);
+    sideUpdate(sides[1], target, 0, -1, 0, query);
+    if (source == target) {
+        best = 0;
+        *meeting = source;
+    }
+
+    while (sides[0]->heap->size > 0 && sides[1]->heap->size > 0) {
+        int topForward = sides[0]->keys[sides[0]->heap->heap[0]];
+        int topBackward = sides[1]->keys[sides[1]->heap->heap[0]];
+        if (best != INT_MAX && (long long)topForward + topBackward >= best) break;
+
+        // expand the side with the smaller frontier minimum
+        int d = topForward <= topBackward ? 0 : 1;
+        SearchSide* side = sides[d];
+        SearchSide* other = sides[1 - d];
+        Graph* graph = graphs[d];
+        int u = heapPop(side->heap);
+        engine->settled++;
+
+        for (int e = graph->offsets[u]; e < graph->offsets[u + 1]; e++) {
+            int v = graph->targets[e];
+            int newDistance = side->distances[u] + graph->weights[e];
+            if (newDistance < sideDistance(side, v, query)) {
+                sideUpdate(side, v, newDistance, u, newDistance, query);
+            }
+
+            int otherDistance = sideDistance(other, v, query);
+            if (otherDistance != INT_MAX && (long long)side->distances[v] + otherDistance < best) {
+                best = side->distances[v] + otherDistance;
+                *meeting = v;
+            }
+        }
+    }
+
+    heapClear(sides[0]->heap);
+    heapClear(sides[1]->heap);
+    return best;
+}
+
+// shortest distance from source to target (INT_MAX if unreachable). When path is not NULL the
+// vertices of the path are written to it and *pathLength is set; engine->settled counts the work.
+int shortestPathQuery(RoutingEngine* engine, int source, int target, QueryMethod method, int* path, int* pathLength) {
+    int meeting = -1;
+    int distance;
+
+    engine->query++;
+    engine->settled = 0;
+
+    if (method == QUERY_BIDIRECTIONAL) {
+        distance = bidirectionalSearch(engine, source, target, &meeting);
+    } else {
+        distance = searchToTarget(engine, source, target, method == QUERY_ALT);
+        meeting = target;
+    }
+
+    if (path != NULL) {
+        *pathLength = 0;
+        if (distance != INT_MAX) {
+            // forward parents lead from the meeting vertex back to the source
+            for (int v = meeting; v != -1; v = engine->forward.parent[v]) {
+                path[(*pathLength)++] = v;
+            }
+            for (int i = 0, j = *pathLength - 1; i < j; i++, j--) {
+                int temp = path[i];
+                path[i] = path[j];
+                path[j] = temp;
+            }
+            // backward parents continue from the meeting vertex to the target
+            if (method == QUERY_BIDIRECTIONAL) {
+                for (int v = engine->backward.parent[meeting]; v != -1; v = engine->backward.parent[v]) {
+                    path[(*pathLength)++] = v;
+                }
+            }
+        }
+    }
+
+    return distance;
+}
+
+const char* queryMethodName(QueryMethod method) {
+    switch (method) {
+        case QUERY_BIDIRECTIONAL:
+            return "bidirectional Dijkstra";
+        case QUERY_ALT:
+            return "A* with landmarks";
+        default:
+            return "Dijkstra";
+    }
+}
+
+static void printShortestPath(Graph* graph, const char* method, int source, int target, int distance, const int* path, int pathLength, int settled) {
+    source = vertexLabel(graph, source);
+    target = vertexLabel(graph, target);
+    if (distance == INT_MAX) {
+        printf("Vertex %d is not reachable from vertex %d\n", target, source);
+    } else {
+        printf("Shortest path (%s) from %d to %d: distance %d\nPath: ", method, source, target, distance);
+        for (int i = 0; i < pathLength; i++) {
+            printf(i == 0 ? "%d" : " -> %d", vertexLabel(graph, path[i]));
+        }
+        printf("\n");
+    }
+    printf("Settled vertices: %d\n", settled);
+}
+
+// shortest path - print the distance and the path from source to target
+void shortestPath(RoutingEngine* engine, int source, int target, QueryMethod method) {
+    int n = engine->graph->numVertices;
+    if (source < 0 || source >= n || target < 0 || target >= n) {
+        printf("Invalid vertex\n");
+        return;
+    }
+
+    int* path = malloc(n * sizeof(int));
+    int pathLength;
+    int distance = shortestPathQuery(engine, source, target, method, path, &pathLength);
+    printShortestPath(engine->graph, queryMethodName(method), source, target, distance, path, pathLength, engine->settled);
+    free(path);
+}
+
+typedef struct HierarchyEdge {
+    int target;
+    int weight;
+    int middle;
+} HierarchyEdge;
+
+typedef struct HierarchyEdgeList {
+    HierarchyEdge* edges;
+    int size;
+    int capacity;
+} HierarchyEdgeList;
+
+// growable edge arrays in the order the hierarchy emits them
+typedef struct HierarchyEdgeArrays {
+    int* src;
+    int* dest;
+    int* weight;
+    int* middle;
+    int size;
+    int capacity;
+} HierarchyEdgeArrays;
+
+// remaining graph while vertices are contracted, plus witness-search scratch
+typedef struct HierarchyBuilder {
+    int numVertices;
+    HierarchyEdgeList* out;
+    HierarchyEdgeList* in;
+    int* contractedNeighbors;
+    int* level;
+    int* priority;
+    int* witnessDistances;
+    int* witnessStamp;
+    int witnessQuery;
+    int* targetMark;
+    int targetRound;
+    IndexedHeap* witnessHeap;
+    HierarchyEdgeArrays upward;
+    HierarchyEdgeArrays downward;
+} HierarchyBuilder;
+
+static void hierarchyListAppend(HierarchyEdgeList* list, int target, int weight, int middle) {
+    if (list->size == list->capacity) {
+        list->capacity = list->capacity ? list->capacity * 2 : 4;
+        list->edges = realloc(list->edges, list->capacity * sizeof(HierarchyEdge));
+    }
+    HierarchyEdge edge = { target, weight, middle };
+    list->edges[list->size++] = edge;
+}
+
+static HierarchyEdge* hierarchyListFind(HierarchyEdgeList* list, int target) {
+    for (int i = 0; i < list->size; i++) {
+        if (list->edges[i].target == target) return &list->edges[i];
+    }
+    return NULL;
+}
+
+static void hierarchyListRemove(HierarchyEdgeList* list, int target) {
+    for (int i = 0; i < list->size; i++) {
+        if (list->edges[i].target == target) {
+            list->edges[i] = list->edges[--list->size];
+            return;
+        }
+    }
+}
+
+static void hierarchyArraysAppend(HierarchyEdgeArrays* arrays, int src, int dest, int weight, int middle) {
+    if (arrays->size == arrays->capacity) {
+        arrays->capacity = arrays->capacity ? arrays->capacity * 2 : 1024;
+        arrays->src = realloc(arrays->src, arrays->capacity * sizeof(int));
+        arrays->dest = realloc(arrays->dest, arrays->capacity * sizeof(int));
+        arrays->weight = realloc(arrays->weight, arrays->capacity * sizeof(int));
+        arrays->middle = realloc(arrays->middle, arrays->capacity * sizeof(int));
+    }
+    arrays->src[arrays->size] = src;
+    arrays->dest[arrays->size] = dest;
+    arrays->weight[arrays->size] = weight;
+    arrays->middle[arrays->size++] = middle;
+}
+
+// add edge u -> x or lower the weight of the existing one
+static void hierarchyAddEdge(HierarchyBuilder* builder, int u, int x, int weight, int middle) {
+    HierarchyEdge* edge = hierarchyListFind(&builder->out[u], x);
+    if (edge == NULL) {
+        hierarchyListAppend(&builder->out[u], x, weight, middle);
+        hierarchyListAppend(&builder->in[x], u, weight, middle);
+    } else if (weight < edge->weight) {
+        edge->weight = weight;
+        edge->middle = middle;
+        edge = hierarchyListFind(&builder->in[x], u);
+        edge->weight = weight;
+        edge->middle = middle;
+    }
+}
+
+// bounded Dijkstra from source in the remaining graph without skip, stopping early once the
+// targets marked for this round are settled; labels are stamped per search
+static void witnessSearch(HierarchyBuilder* builder, int source, int skip, int maxDistance, int targets) {
+    IndexedHeap* heap = builder->witnessHeap;
+    int query = ++builder->witnessQuery;
+    int settled = 0;
+
+    builder->witnessStamp[source] = query;
+    builder->witnessDistances[source] = 0;
+    heapPush(heap, source);
+
+    while (heap->size > 0 && settled++ < WITNESS_SETTLE_LIMIT) {
+        int u = heapPop(heap);
+        if (builder->witnessDistances[u] > maxDistance) break;
+        if (builder->targetMark[u] == builder->targetRound && --targets == 0) break;
+
+        HierarchyEdgeList* list = &builder->out[u];
+        for (int i = 0; i < list->size; i++) {
+            int x = list->edges[i].target;
+            if (x == skip) continue;
+            int newDistance = builder->witnessDistances[u] + list->edges[i].weight;
+            if (builder->witnessStamp[x] != query) {
+                builder->witnessStamp[x] = query;
+                builder->witnessDistances[x] = newDistance;
+                heapPush(heap, x);
+            } else if (newDistance < builder->witnessDistances[x]) {
+                builder->witnessDistances[x] = newDistance;
+                heapDecreaseKey(heap, x);
+            }
+        }
+    }
+
+    heapClear(heap);
+}
+
+// count the shortcuts contracting v needs; with apply set they are also inserted
+static int contractVertex(HierarchyBuilder* builder, int v, int apply) {
+    HierarchyEdgeList* in = &builder->in[v];
+    HierarchyEdgeList* out = &builder->out[v];
+    int shortcuts = 0;
+    int maxOut = 0;
+
+    builder->targetRound++;
+    for (int j = 0; j < out->size; j++) {
+        builder->targetMark[out->edges[j].target] = builder->targetRound;
+        if (out->edges[j].weight > maxOut) {
+            maxOut = out->edges[j].weight;
+        }
+    }
+
+    for (int i = 0; i < in->size && out->size > 0; i++) {
+        int u = in->edges[i].target;
+        int toV = in->edges[i].weight;
+        witnessSearch(builder, u, v, toV + maxOut, out->size);
+
+        // a shortcut u -> x is needed unless a path avoiding v is at least as short
+        for (int j = 0; j < out->size; j++) {
+            int x = out->edges[j].target;
+            if (x == u) continue;
+            int via = toV + out->edges[j].weight;
+            if (builder->witnessStamp[x] == builder->witnessQuery && builder->witnessDistances[x] <= via) continue;
+
+            shortcuts++;
+            if (apply) {
+                hierarchyAddEdge(builder, u, x, via, v);
+            }
+        }
+    }
+
+    return shortcuts;
+}
+
+// edge difference plus the number of contracted neighbours and the hierarchy level, which
+// spread the contraction evenly over the graph
+static int contractionPriority(HierarchyBuilder* builder, int v) {
+    int shortcuts = contractVertex(builder, v, 0);
+    return shortcuts - builder->in[v].size - builder->out[v].size + builder->contractedNeighbors[v] + builder->level[v];
+}
+
+// CSR graph of the emitted edges with the middle vertex of each edge in the same order
+static Graph* buildHierarchyGraph(int numVertices, HierarchyEdgeArrays* arrays, int** middle) {
+    Graph* graph = createGraphFromEdges(numVertices, arrays->size, arrays->src, arrays->dest, arrays->weight);
+    *middle = malloc(arrays->size * sizeof(int));
+
+    // createGraphFromEdges keeps input order within a source, so replay that placement
+    int* cursor = malloc(numVertices * sizeof(int));
+    memcpy(cursor, graph->offsets, numVertices * sizeof(int));
+    for (int i = 0; i < arrays->size; i++) {
+        (*middle)[cursor[arrays->src[i]]++] = arrays->middle[i];
+    }
+
+    free(cursor);
+    free(arrays->src);
+    free(arrays->dest);
+    free(arrays->weight);
+    free(arrays->middle);
+    return graph;
+}
+
+static ContractionHierarchy* createHierarchyShell(int numVertices, int* rank) {
+    ContractionHierarchy* ch = malloc(sizeof(ContractionHierarchy));
+    ch->numVertices = numVertices;
+    ch->rank = rank;
+    ch->mapped = 0;
+    ch->query = 0;
+    ch->settled = 0;
+    createSearchSide(&ch->forward, numVertices);
+    createSearchSide(&ch->backward, numVertices);
+    return ch;
+}
+
+// contraction hierarchies preprocessing: contract vertices in order of (lazily updated) edge
+// difference, adding shortcuts where witness searches find no path avoiding the vertex
+ContractionHierarchy* buildContractionHierarchy(Graph* graph) {
+    int n = graph->numVertices;
+    HierarchyBuilder builder;
+    memset(&builder, 0, sizeof(builder));
+    builder.numVertices = n;
+    builder.out = calloc(n, sizeof(HierarchyEdgeList));
+    builder.in = calloc(n, sizeof(HierarchyEdgeList));
+    builder.contractedNeighbors = calloc(n, sizeof(int));
+    builder.level = calloc(n, sizeof(int));
+    builder.priority = calloc(n, sizeof(int));
+    builder.witnessDistances = calloc(n, sizeof(int));
+    builder.witnessStamp = calloc(n, sizeof(int));
+    builder.targetMark = calloc(n, sizeof(int));
+    builder.witnessHeap = createIndexedHeap(n, builder.witnessDistances);
+
+    // parallel edges collapse to the lightest one, self-loops never lie on a shortest path
+    for (int u = 0; u < n; u++) {
+        for (int e = graph->offsets[u]; e < graph->offsets[u + 1]; e++) {
+            if (graph->targets[e] != u) {
+                hierarchyAddEdge(&builder, u, graph->targets[e], graph->weights[e], -1);
+            }
+        }
+    }
+
+    IndexedHeap* queue = createIndexedHeap(n, builder.priority);
+    for (int v = 0; v < n; v++) {
+        builder.priority[v] = contractionPriority(&builder, v);
+        heapPush(queue, v);
+    }
+
+    ContractionHierarchy* ch = createHierarchyShell(n, malloc(n * sizeof(int)));
+    int nextRank = 0;
+
+    while (queue->size > 0) {
+        int v = heapPop(queue);
+
+        // lazy update: contract only if v is still no worse than the next candidate
+        builder.priority[v] = contractionPriority(&builder, v);
+        if (queue->size > 0 && builder.priority[v] > builder.priority[queue->heap[0]]) {
+            heapPush(queue, v);
+            continue;
+        }
+
+        // every remaining neighbour is ranked higher, so v's edges now belong to the hierarchy
+        ch->rank[v] = nextRank++;
+        for (int i = 0; i < builder.out[v].size; i++) {
+            HierarchyEdge* edge = &builder.out[v].edges[i];
+            hierarchyArraysAppend(&builder.upward, v, edge->target, edge->weight, edge->middle);
+        }
+        for (int i = 0; i < builder.in[v].size; i++) {
+            HierarchyEdge* edge = &builder.in[v].edges[i];
+            hierarchyArraysAppend(&builder.downward, v, edge->target, edge->weight, edge->middle);
+        }
+
+        contractVertex(&builder, v, 1);
+        for (int i = 0; i < builder.out[v].size; i++) {
+            hierarchyListRemove(&builder.in[builder.out[v].edges[i].target], v);
+        }
+        for (int i = 0; i < builder.in[v].size; i++) {
+            hierarchyListRemove(&builder.out[builder.in[v].edges[i].target], v);
+        }
+
+        // only the cheap terms of the neighbours' priorities change here; the edge
+        // difference is refreshed lazily when they reach the top of the queue
+        HierarchyEdgeList* lists[2] = { &builder.out[v], &builder.in[v] };
+        for (int k = 0; k < 2; k++) {
+            for (int i = 0; i < lists[k]->size; i++) {
+                int y = lists[k]->edges[i].target;
+                if (k == 1 && hierarchyListFind(&builder.out[v], y) != NULL) continue; // already updated
+                int oldLevel = builder.level[y];
+                if (builder.level[v] + 1 > builder.level[y]) {
+                    builder.level[y] = builder.level[v] + 1;
+                }
+                builder.contractedNeighbors[y]++;
+                builder.priority[y] += 1 + builder.level[y] - oldLevel;
+                heapUpdate(queue, y);
+            }
+        }
+        free(builder.out[v].edges);
+        free(builder.in[v].edges);
+        builder.out[v].edges = builder.in[v].edges = NULL;
+        builder.out[v].size = builder.in[v].size = 0;
+    }
+
+    ch->upward = buildHierarchyGraph(n, &builder.upward, &ch->upwardMiddle);
+    ch->downward = buildHierarchyGraph(n, &builder.downward, &ch->downwardMiddle);
+
+    freeIndexedHeap(queue);
+    freeIndexedHeap(builder.witnessHeap);
+    free(builder.out);
+    free(builder.in);
+    free(builder.contractedNeighbors);
+    free(builder.level);
+    free(builder.priority);
+    free(builder.witnessDistances);
+    free(builder.witnessStamp);
+    free(builder.targetMark);
+    return ch;
+}
+
+void freeContractionHierarchy(ContractionHierarchy* ch) {
+    freeGraph(ch->upward);
+    freeGraph(ch->downward);
+    if (!ch->mapped) {
+        free(ch->upwardMiddle);
+        free(ch->downwardMiddle);
+        free(ch->rank);
+    }
+    freeSearchSide(&ch->forward);
+    freeSearchSide(&ch->backward);
+    free(ch);
+}
+
+// number of shortcuts the preprocessing added on top of the original edges
+int hierarchyShortcuts(ContractionHierarchy* ch) {
+    int shortcuts = 0;
+    for (int e = 0; e < ch->upward->numEdges; e++) {
+        shortcuts += ch->upwardMiddle[e] >= 0;
+    }
+    for (int e = 0; e < ch->downward->numEdges; e++) {
+        shortcuts += ch->downwardMiddle[e] >= 0;
+    }
+    return shortcuts;
+}
+
+// append the original vertices of hierarchy edge a -> b (without a) to path
+static void unpackHierarchyEdge(ContractionHierarchy* ch, int a, int b, int* path, int* pathLength) {
+    int middle = -1;
+
+    // a -> b is stored at the lower-ranked endpoint: upward at a, or reversed in downward at b
+    Graph* graph = ch->rank[a] < ch->rank[b] ? ch->upward : ch->downward;
+    int* middles = ch->rank[a] < ch->rank[b] ? ch->upwardMiddle : ch->downwardMiddle;
+    int from = ch->rank[a] < ch->rank[b] ? a : b;
+    int to = ch->rank[a] < ch->rank[b] ? b : a;
+    for (int e = graph->offsets[from]; e < graph->offsets[from + 1]; e++) {
+        if (graph->targets[e] == to) {
+            middle = middles[e];
+            break;
+        }
+    }
+
+    if (middle < 0) {
+        path[(*pathLength)++] = b;
+    } else {
+        unpackHierarchyEdge(ch, a, middle, path, pathLength);
+        unpackHierarchyEdge(ch, middle, b, path, pathLength);
+    }
+}
+
+// contraction hierarchy query: both searches only move up in rank; a side stops once its
+// queue minimum reaches the best meeting distance. Path and settled count as in shortestPathQuery().
+int hierarchyQuery(ContractionHierarchy* ch, int source, int target, int* path, int* pathLength) {
+    SearchSide* sides[2] = { &ch->forward, &ch->backward };
+    Graph* graphs[2] = { ch->upward, ch->downward };
+    int query = ++ch->query;
+    int best = INT_MAX;
+    int meeting = -1;
+
+    ch->settled = 0;
+    sideUpdate(sides[0], source, 0, -1, 0, query);
+    sideUpdate(sides[1], target, 0, -1, 0, query);
+
+    while (sides[0]->heap->size > 0 || sides[1]->heap->size > 0) {
+        int d;
+        if (sides[1]->heap->size == 0) {
+            d = 0;
+        } else if (sides[0]->heap->size == 0) {
+            d = 1;
+        } else {
+            d = sides[0]->keys[sides[0]->heap->heap[0]] <= sides[1]->keys[sides[1]->heap->heap[0]] ? 0 : 1;
+        }
+
+        SearchSide* side = sides[d];
+        if (side->keys[side->heap->heap[0]] >= best) {
+            heapClear(side->heap);
+            continue;
+        }
+
+        int u = heapPop(side->heap);
+        ch->settled++;
+        int otherDistance = sideDistance(sides[1 - d], u, query);
+        if (otherDistance != INT_MAX && side->distances[u] + otherDistance < best) {
+            best = side->distances[u] + otherDistance;
+            meeting = u;
+        }
+
+        // stall-on-demand: a higher-ranked vertex reaching u more cheaply proves u's label is
+        // not a shortest distance, and its edges need not be relaxed
+        Graph* incoming = graphs[1 - d];
+        int stalled = 0;
+        for (int e = incoming->offsets[u]; e < incoming->offsets[u + 1] && !stalled; e++) {
+            int w = sideDistance(side, incoming->targets[e], query);
+            stalled = w != INT_MAX && w + incoming->weights[e] < side->distances[u];
+        }
+        if (stalled) continue;
+
+        Graph* graph = graphs[d];
+        for (int e = graph->offsets[u]; e < graph->offsets[u + 1]; e++) {
+            int v = graph->targets[e];
+            int newDistance = side->distances[u] + graph->weights[e];
+            if (newDistance < sideDistance(side, v, query)) {
+                sideUpdate(side, v, newDistance, u, newDistance, query);
+            }
+        }
+    }
+
+    if (path != NULL) {
+        *pathLength = 0;
+        if (best != INT_MAX) {
+            // hierarchy vertices from the source up to the meeting vertex and down to the target
+            int* route = malloc(ch->numVertices * sizeof(int));
+            int routeLength = 0;
+            for (int v = meeting; v != -1; v = ch->forward.parent[v]) {
+                route[routeLength++] = v;
+            }
+            for (int i = 0, j = routeLength - 1; i < j; i++, j--) {
+                int temp = route[i];
+                route[i] = route[j];
+                route[j] = temp;
+            }
+            for (int v = ch->backward.parent[meeting]; v != -1; v = ch->backward.parent[v]) {
+                route[routeLength++] = v;
+            }
+
+            path[(*pathLength)++] = route[0];
+            for (int i = 0; i + 1 < routeLength; i++) {
+                unpackHierarchyEdge(ch, route[i], route[i + 1], path, pathLength);
+            }
+            free(route);
+        }
+    }
+
+    return best;
+}
+
+static int writeArray(FILE* file, const int* values, int count) {
+    return fwrite(values, sizeof(int), count, file) == (size_t)count;
+}
+
+static int readArray(FILE* file, int* values, int count) {
+    return fread(values, sizeof(int), count, file) == (size_t)count;
+}
+
+static int writeHierarchyGraph(FILE* file, Graph* graph, const int* middle) {
+    return writeArray(file, graph->offsets, graph->numVertices + 1) && writeArray(file, graph->targets, graph->numEdges)
+        && writeArray(file, graph->weights, graph->numEdges) && writeArray(file, middle, graph->numEdges);
+}
+
+// whether CSR arrays read from a file can be used without out-of-range accesses: offsets start
+// at 0, never decrease and end at the edge count, targets are vertices, and middle (if given)
+// holds -1 or vertices
+static int validCsrArrays(const Graph* graph, const int* middle) {
+    int n = graph->numVertices, m = graph->numEdges;
+    int valid = graph->offsets[0] == 0 && graph->offsets[n] == m;
+    for (int u = 0; u < n && valid; u++) {
+        valid = graph->offsets[u] <= graph->offsets[u + 1];
+    }
+    for (int e = 0; e < m && valid; e++) {
+        valid = graph->targets[e] >= 0 && graph->targets[e] < n
+             && (middle == NULL || (middle[e] >= -1 && middle[e] < n));
+    }
+    return valid;
+}
+
+// whether rank[] holds every value from 0 to n - 1 exactly once
+static int validRanks(const int* rank, int n) {
+    char* seen = calloc(n > 0 ? n : 1, 1);
+    int valid = 1;
+    for (int v = 0; v < n && valid; v++) {
+        valid = rank[v] >= 0 && rank[v] < n && !seen[rank[v]];
+        if (valid) {
+            seen[rank[v]] = 1;
+        }
+    }
+    free(seen);
+    return valid;
+}
+
+// whether every shortcut u -> v bypasses a vertex contracted before u, so unpackHierarchyEdge()
+// recurses on pairs of ever lower rank and ends; needs valid ranks and CSR arrays
+static int validShortcutRanks(const Graph* graph, const int* middle, const int* rank) {
+    int valid = 1;
+    for (int u = 0; u < graph->numVertices && valid; u++) {
+        for (int e = graph->offsets[u]; e < graph->offsets[u + 1] && valid; e++) {
+            valid = middle[e] < 0 || rank[middle[e]] < rank[u];
+        }
+    }
+    return valid;
+}
+
+static Graph* readHierarchyGraph(FILE* file, int numVertices, int numEdges, int** middle) {
+    Graph* graph = malloc(sizeof(Graph));
+    graph->numVertices = numVertices;
+    graph->numEdges = numEdges;
+    graph->adjList = NULL;
+    graph->mapped = 0;
+    graph->labels = NULL;
+    graph->vertexOf = NULL;
+    graph->offsets = malloc((numVertices + 1) * sizeof(int));
+    graph->targets = malloc(numEdges * sizeof(int));
+    graph->weights = malloc(numEdges * sizeof(int));
+    *middle = malloc(numEdges * sizeof(int));
+
+    if (!readArray(file, graph->offsets, numVertices + 1) || !readArray(file, graph->targets, numEdges)
+        || !readArray(file, graph->weights, numEdges) || !readArray(file, *middle, numEdges)) {
+        freeGraph(graph);
+        free(*middle);
+        return NULL;
+    }
+    return graph;
+}
+
+// write the hierarchy as: magic, version, vertices, upward edges, downward edges, then
+// rank[] and the upward and downward CSR arrays (offsets, targets, weights, middles)
+int saveContractionHierarchy(ContractionHierarchy* ch, const char* fileName) {
+    FILE* file = fopen(fileName, "wb");
+    if (!file) {
+        perror("Failed to open file");
+        return 0;
+    }
+
+    int header[5] = { HIERARCHY_MAGIC, HIERARCHY_VERSION, ch->numVertices, ch->upward->numEdges, ch->downward->numEdges };
+    int ok = writeArray(file, header, 5) && writeArray(file, ch->rank, ch->numVertices)
+          && writeHierarchyGraph(file, ch->upward, ch->upwardMiddle)
+          && writeHierarchyGraph(file, ch->downward, ch->downwardMiddle);
+
+    if (fclose(file) != 0) {
+        ok = 0;
+    }
+    return ok;
+}
+
+// read a hierarchy written by saveContractionHierarchy(); NULL if the file is not one or its
+// arrays are inconsistent
+ContractionHierarchy* loadContractionHierarchy(const char* fileName) {
+    FILE* file = fopen(fileName, "rb");
+    if (!file) {
+        perror("Failed to open file");
+        return NULL;
+    }
+
+    int header[5];
+    if (!readArray(file, header, 5) || header[0] != HIERARCHY_MAGIC || header[1] != HIERARCHY_VERSION
+        || header[2] < 0 || header[3] < 0 || header[4] < 0) {
+        printf("%s is not a contraction hierarchy file\n", fileName);
+        fclose(file);
+        return NULL;
+    }
+
+    ContractionHierarchy* ch = createHierarchyShell(header[2], malloc(header[2] * sizeof(int)));
+    ch->upward = NULL;
+    ch->downward = NULL;
+    if (readArray(file, ch->rank, header[2])) {
+        ch->upward = readHierarchyGraph(file, header[2], header[3], &ch->upwardMiddle);
+    }
+    if (ch->upward != NULL) {
+        ch->downward = readHierarchyGraph(file, header[2], header[4], &ch->downwardMiddle);
+    }
+    fclose(file);
+
+    int valid = ch->downward != NULL && validRanks(ch->rank, ch->numVertices)
+             && validCsrArrays(ch->upward, ch->upwardMiddle) && validCsrArrays(ch->downward, ch->downwardMiddle)
+             && validShortcutRanks(ch->upward, ch->upwardMiddle, ch->rank)
+             && validShortcutRanks(ch->downward, ch->downwardMiddle, ch->rank);
+    if (!valid) {
+        printf("%s is %s\n", fileName, ch->downward == NULL ? "truncated" : "not a valid contraction hierarchy");
+        if (ch->downward != NULL) {
+            freeGraph(ch->downward);
+            free(ch->downwardMiddle);
+        }
+        if (ch->upward != NULL) {
+            freeGraph(ch->upward);
+            free(ch->upwardMiddle);
+        }
+        free(ch->rank);
+        freeSearchSide(&ch->forward);
+        freeSearchSide(&ch->backward);
+        free(ch);
+        return NULL;
+    }
+    return ch;
+}
+
+// shortest path through the contraction hierarchy - print the distance and the unpacked path
+void hierarchyShortestPath(ContractionHierarchy* ch, Graph* graph, int source, int target) {
+    int n = ch->numVertices;
+    if (source < 0 || source >= n || target < 0 || target >= n) {
+        printf("Invalid vertex\n");
+        return;
+    }
+
+    int* path = malloc(n * sizeof(int));
+    int pathLength;
+    int distance = hierarchyQuery(ch, source, target, path, &pathLength);
+    printShortestPath(graph, "contraction hierarchy", source, target, distance, path, pathLength, ch->settled);
+    free(path);
+}
+
+// edges parsed by one thread from its slice of a text graph file
+typedef struct EdgeChunk {
+    const char* begin;
+    const char* end;
+    int dimacs;
+    int numVertices;
+    int* src;
+    int* dest;
+    int* weight;
+    int size;
+    int capacity;
+    const char* error;
+} EdgeChunk;
+
+static int isBlank(char c) {
+    return c == ' ' || c == '\t' || c == '\r';
+}
+
+// parse an optionally signed decimal int at *cursor after skipping blanks; 0 if there is none or it overflows
+static int parseInt(const char** cursor, const char* end, int* value) {
+    const char* p = *cursor;
+    while (p < end && isBlank(*p)) p++;
+
+    int negative = p < end && *p == '-';
+    if (negative) p++;
+    if (p == end || *p < '0' || *p > '9') return 0;
+
+    long long result = 0;
+    while (p < end && *p >= '0' && *p <= '9') {
+        result = result * 10 + (*p++ - '0');
+        if (result > (long long)INT_MAX + 1) return 0;
+    }
+    if (negative) {
+        result = -result;
+    }
+    if (result > INT_MAX) return 0;
+
+    *value = (int)result;
+    *cursor = p;
+    return 1;
+}
+
+static void edgeChunkAppend(EdgeChunk* chunk, int src, int dest, int weight) {
+    if (chunk->size == chunk->capacity) {
+        chunk->capacity = chunk->capacity ? chunk->capacity * 2 : 4096;
+        chunk->src = realloc(chunk->src, chunk->capacity * sizeof(int));
+        chunk->dest = realloc(chunk->dest, chunk->capacity * sizeof(int));
+        chunk->weight = realloc(chunk->weight, chunk->capacity * sizeof(int));
+    }
+    chunk->src[chunk->size] = src;
+    chunk->dest[chunk->size] = dest;
+    chunk->weight[chunk->size++] = weight;
+}
+
+// parse the edge lines of one chunk: "a u v w" (1-based) in DIMACS files, "u v w" in edge lists;
+// blank lines and comments ("c" in DIMACS, "#" in edge lists) are skipped
+static void* parseEdgeChunk(void* arg) {
+    ThreadArgs* args = arg;
+    EdgeChunk* chunk = (EdgeChunk*)args->shared + args->threadId;
+    const char* p = chunk->begin;
+
+    while (p < chunk->end) {
+        const char* line = p;
+        const char* lineEnd = memchr(p, '\n', chunk->end - p);
+        if (lineEnd == NULL) {
+            lineEnd = chunk->end;
+        }
+        p = lineEnd + 1;
+
+        while (line < lineEnd && isBlank(*line)) line++;
+        if (line == lineEnd || *line == (chunk->dimacs ? 'c' : '#')) continue;
+
+        int u, v, w;
+        if (chunk->dimacs && *line++ != 'a') {
+            chunk->error = line - 1;
+            return NULL;
+        }
+        if (!parseInt(&line, lineEnd, &u) || !parseInt(&line, lineEnd, &v) || !parseInt(&line, lineEnd, &w)) {
+            chunk->error = line;
+            return NULL;
+        }
+        while (line < lineEnd && isBlank(*line)) line++;
+
+        if (chunk->dimacs) {
+            u--;
+            v--;
+        }
+        if (line != lineEnd || u < 0 || u >= chunk->numVertices || v < 0 || v >= chunk->numVertices) {
+            chunk->error = line;
+            return NULL;
+        }
+        edgeChunkAppend(chunk, u, v, w);
+    }
+
+    return NULL;
+}
+
+// the header is "p sp <vertices> <edges>" after optional "c" comment lines for DIMACS files,
+// or "<vertices> <edges>" for edge lists; returns the start of the edge lines, NULL if malformed
+static const char* parseGraphHeader(const char* p, const char* end, int* dimacs, int* vertices, int* edges) {
+    while (p < end) {
+        const char* lineEnd = memchr(p, '\n', end - p);
+        if (lineEnd == NULL) {
+            lineEnd = end;
+        }
+
+        const char* q = p;
+        while (q < lineEnd && isBlank(*q)) q++;
+        if (q == lineEnd || *q == 'c' || *q == '#') {
+            p = lineEnd + 1;
+            continue;
+        }
+
+        *dimacs = *q == 'p';
+        if (*dimacs) {
+            q++;
+            while (q < lineEnd && isBlank(*q)) q++;
+            if (lineEnd - q < 2 || q[0] != 's' || q[1] != 'p') return NULL;
+            q += 2;
+        }
+        if (!parseInt(&q, lineEnd, vertices) || !parseInt(&q, lineEnd, edges) || *vertices <= 0 || *edges < 0) return NULL;
+        return lineEnd < end ? lineEnd + 1 : end;
+    }
+    return NULL;
+}
+
+// text graphs are split at line boundaries into one chunk per thread and parsed in parallel
+static Graph* parseTextGraph(const char* data, size_t size, const char* fileName, int numThreads) {
+    const char* end = data + size;
+    int dimacs, vertices, edges;
+    const char* body = parseGraphHeader(data, end, &dimacs, &vertices, &edges);
+    if (body == NULL) {
+        printf("%s: missing or malformed graph header\n", fileName);
+        return NULL;
+    }
+
+    EdgeChunk* chunks = calloc(numThreads, sizeof(EdgeChunk));
+    const char* begin = body;
+    for (int t = 0; t < numThreads; t++) {
+        const char* chunkEnd = t == numThreads - 1 ? end : body + (end - body) * (t + 1) / numThreads;
+        if (chunkEnd < begin) {
+            chunkEnd = begin;
+        }
+        const char* newline = chunkEnd < end ? memchr(chunkEnd, '\n', end - chunkEnd) : NULL;
+        chunkEnd = newline != NULL ? newline + 1 : end;
+
+        chunks[t].begin = begin;
+        chunks[t].end = chunkEnd;
+        chunks[t].dimacs = dimacs;
+        chunks[t].numVertices = vertices;
+        begin = chunkEnd;
+    }
+
+    runThreads(numThreads, parseEdgeChunk, chunks);
+
+    Graph* graph = NULL;
+    int total = 0;
+    const char* error = NULL;
+    for (int t = 0; t < numThreads && error == NULL; t++) {
+        error = chunks[t].error;
+        total += chunks[t].size;
+    }
+
+    if (error != NULL) {
+        int line = 1;
+        for (const char* p = data; p < error; p++) {
+            line += *p == '\n';
+        }
+        printf("%s:%d: malformed edge line\n", fileName, line);
+    } else if (total != edges) {
+        printf("%s: header announces %d edges but %d were read\n", fileName, edges, total);
+    } else {
+        int* src = malloc(total * sizeof(int));
+        int* dest = malloc(total * sizeof(int));
+        int* weight = malloc(total * sizeof(int));
+        int offset = 0;
+        for (int t = 0; t < numThreads; t++) {
+            if (chunks[t].size > 0) {
+                memcpy(src + offset, chunks[t].src, chunks[t].size * sizeof(int));
+                memcpy(dest + offset, chunks[t].dest, chunks[t].size * sizeof(int));
+                memcpy(weight + offset, chunks[t].weight, chunks[t].size * sizeof(int));
+            }
+            offset += chunks[t].size;
+        }
+        graph = createGraphFromEdges(vertices, total, src, dest, weight);
+        free(src);
+        free(dest);
+        free(weight);
+    }
+
+    for (int t = 0; t < numThreads; t++) {
+        free(chunks[t].src);
+        free(chunks[t].dest);
+        free(chunks[t].weight);
+    }
+    free(chunks);
+    return graph;
+}
+
+// binary graphs are a 4-int header (magic, version, vertices, edges) followed by the CSR arrays
+// offsets[V + 1], targets[E] and weights[E], so loading is three bulk copies
+static Graph* readBinaryGraph(const char* data, size_t size, const char* fileName) {
+    const int* header = (const int*)data;
+    if (size < GRAPH_BINARY_HEADER || header[1] != GRAPH_BINARY_VERSION || header[2] <= 0 || header[3] < 0
+        || size != GRAPH_BINARY_HEADER + ((size_t)header[2] + 1 + 2 * (size_t)header[3]) * sizeof(int)) {
+        printf("%s: unsupported version or truncated binary graph\n", fileName);
+        return NULL;
+    }
+
+    int n = header[2];
+    int m = header[3];
+    const int* offsets = header + 4;
+    Graph* graph = malloc(sizeof(Graph));
+    graph->numVertices = n;
+    graph->numEdges = m;
+    graph->adjList = NULL;
+    graph->mapped = 0;
+    graph->labels = NULL;
+    graph->vertexOf = NULL;
+    graph->offsets = malloc((n + 1) * sizeof(int));
+    graph->targets = malloc(m * sizeof(int));
+    graph->weights = malloc(m * sizeof(int));
+    memcpy(graph->offsets, offsets, (n + 1) * sizeof(int));
+    memcpy(graph->targets, offsets + n + 1, m * sizeof(int));
+    memcpy(graph->weights, offsets + n + 1 + m, m * sizeof(int));
+
+    // a corrupt file must not lead to out-of-range accesses later
+    if (!validCsrArrays(graph, NULL)) {
+        printf("%s: corrupt binary graph\n", fileName);
+        freeGraph(graph);
+        return NULL;
+    }
+    return graph;
+}
+
+// load a graph file: binary graphs are recognized by their magic number, anything else is
+// parsed as DIMACS .gr or edge-list text on numThreads threads. NULL (with a message) on errors.
+Graph* loadGraph(const char* fileName, int numThreads) {
+    int fd = open(fileName, O_RDONLY);
+    if (fd < 0) {
+        perror("Failed to open graph file");
+        return NULL;
+    }
+
+    struct stat info;
+    if (fstat(fd, &info) != 0 || info.st_size == 0) {
+        printf("%s: empty or unreadable graph file\n", fileName);
+        close(fd);
+        return NULL;
+    }
+
+    size_t size = info.st_size;
+    char* data = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        perror("Failed to map graph file");
+        return NULL;
+    }
+    madvise(data, size, MADV_SEQUENTIAL);
+
+    Graph* graph;
+    if (size >= sizeof(int) && *(const int*)data == GRAPH_BINARY_MAGIC) {
+        graph = readBinaryGraph(data, size, fileName);
+    } else {
+        graph = parseTextGraph(data, size, fileName, numThreads);
+    }
+
+    munmap(data, size);
+    return graph;
+}
+
+// write a graph in the binary format read by loadGraph(); returns 0 on write errors
+int saveGraphBinary(Graph* graph, const char* fileName) {
+    FILE* file = fopen(fileName, "wb");
+    if (!file) {
+        perror("Failed to open file");
+        return 0;
+    }
+
+    int header[4] = { GRAPH_BINARY_MAGIC, GRAPH_BINARY_VERSION, graph->numVertices, graph->numEdges };
+    int ok = writeArray(file, header, 4) && writeArray(file, graph->offsets, graph->numVertices + 1)
+          && writeArray(file, graph->targets, graph->numEdges) && writeArray(file, graph->weights, graph->numEdges);
+
+    if (fclose(file) != 0) {
+        ok = 0;
+    }
+    return ok;
+}
+
+// decimal digits of value at p; returns the position after them
+static char* formatInt(char* p, int value) {
+    char digits[12];
+    int length = 0;
+    unsigned int magnitude = value < 0 ? 0u - (unsigned int)value : (unsigned int)value;
+
+    if (value < 0) {
+        *p++ = '-';
+    }
+    do {
+        digits[length++] = '0' + magnitude % 10;
+        magnitude /= 10;
+    } while (magnitude > 0);
+    while (length > 0) {
+        *p++ = digits[--length];
+    }
+    return p;
+}
+
+// write a graph as DIMACS .gr text (1-based "a u v w" lines) or as a 0-based edge list;
+// lines are formatted by hand into a large buffer. Returns 0 on write errors.
+int saveGraphText(Graph* graph, const char* fileName, int dimacs) {
+    FILE* file = fopen(fileName, "w");
+    if (!file) {
+        perror("Failed to open file");
+        return 0;
+    }
+
+    if (dimacs) {
+        fprintf(file, "p sp %d %d\n", graph->numVertices, graph->numEdges);
+    } else {
+        fprintf(file, "%d %d\n", graph->numVertices, graph->numEdges);
+    }
+
+    char* buffer = malloc(TEXT_WRITE_BUFFER);
+    char* p = buffer;
+    int ok = 1;
+    for (int u = 0; u < graph->numVertices && ok; u++) {
+        for (int e = graph->offsets[u]; e < graph->offsets[u + 1]; e++) {
+            // a line is at most 2 + 3 * 12 bytes
+            if (p - buffer > TEXT_WRITE_BUFFER - 64) {
+                ok = fwrite(buffer, 1, p - buffer, file) == (size_t)(p - buffer);
+                p = buffer;
+            }
+            if (dimacs) {
+                *p++ = 'a';
+                *p++ = ' ';
+            }
+            p = formatInt(p, u + dimacs);
+            *p++ = ' ';
+            p = formatInt(p, graph->targets[e] + dimacs);
+            *p++ = ' ';
+            p = formatInt(p, graph->weights[e]);
+            *p++ = '\n';
+        }
+    }
+    if (ok && p > buffer) {
+        ok = fwrite(buffer, 1, p - buffer, file) == (size_t)(p - buffer);
+    }
+
+    free(buffer);
+    if (fclose(file) != 0) {
+        ok = 0;
+    }
+    return ok;
+}
+
+static int hasSuffix(const char* name, const char* suffix) {
+    size_t nameLength = strlen(name);
+    size_t suffixLength = strlen(suffix);
+    return nameLength >= suffixLength && strcmp(name + nameLength - suffixLength, suffix) == 0;
+}
+
+// converter: weighted_graph convert <input> <output>; the output format follows its extension:
+// .gr for DIMACS text, .txt for an edge list, anything else for the binary format
+int convertGraph(const char* input, const char* output, int numThreads) {
+    double start = currentTime();
+    Graph* graph = loadGraph(input, numThreads);
+    if (graph == NULL) return 1;
+
+    double loaded = currentTime() - start;
+    printf("Loaded %d vertices and %d edges from %s in %.3f s (%.1f M edges/s)\n", graph->numVertices,
+           graph->numEdges, input, loaded, graph->numEdges / (loaded > 0 ? loaded : 1e-9) / 1e6);
+
+    start = currentTime();
+    int ok;
+    if (hasSuffix(output, ".gr")) {
+        ok = saveGraphText(graph, output, 1);
+    } else if (hasSuffix(output, ".txt")) {
+        ok = saveGraphText(graph, output, 0);
+    } else {
+        ok = saveGraphBinary(graph, output);
+    }
+
+    if (ok) {
+        printf("Wrote %s in %.3f s\n", output, currentTime() - start);
+    } else {
+        printf("Failed to write %s\n", output);
+    }
+    freeGraph(graph);
+    return ok ? 0 : 1;
+}
+
+// FNV-1a over 32-bit words, continuing from hash
+static unsigned long long checksumWords(unsigned long long hash, const int* words, long long count) {
+    for (long long i = 0; i < count; i++) {
+        hash ^= (unsigned int)words[i];
+        hash *= 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+static unsigned long long snapshotChecksum(const char* data, const SnapshotHeader* header) {
+    unsigned long long hash = SNAPSHOT_CHECKSUM_SEED;
+    for (int s = 0; s < SNAPSHOT_SECTIONS; s++) {
+        hash = checksumWords(hash, (const int*)(data + header->sections[s].offset), header->sections[s].count);
+    }
+    return hash;
+}
+
+// write a snapshot: a one-page header, then every section on its own page boundary so that a
+// mapping of the file can be used in place. ch may be NULL; with checksum set the header stores
+// an FNV-1a hash of all sections. Returns 0 on write errors.
+int saveGraphSnapshot(Graph* graph, ContractionHierarchy* ch, const char* fileName, int checksum) {
+    SnapshotHeader header;
+    memset(&header, 0, sizeof(header));
+    header.magic = SNAPSHOT_MAGIC;
+    header.version = SNAPSHOT_VERSION;
+    header.numVertices = graph->numVertices;
+    header.numEdges = graph->numEdges;
+
+    const int* arrays[SNAPSHOT_SECTIONS] = { graph->offsets, graph->targets, graph->weights };
+    long long counts[SNAPSHOT_SECTIONS] = { graph->numVertices + 1, graph->numEdges, graph->numEdges };
+    if (ch != NULL) {
+        Graph* sides[2] = { ch->upward, ch->downward };
+        int* middles[2] = { ch->upwardMiddle, ch->downwardMiddle };
+        header.flags |= SNAPSHOT_HIERARCHY;
+        header.upwardEdges = ch->upward->numEdges;
+        header.downwardEdges = ch->downward->numEdges;
+        arrays[SECTION_RANK] = ch->rank;
+        counts[SECTION_RANK] = ch->numVertices;
+        for (int d = 0; d < 2; d++) {
+            int first = d == 0 ? SECTION_UPWARD_OFFSETS : SECTION_DOWNWARD_OFFSETS;
+            arrays[first] = sides[d]->offsets;
+            arrays[first + 1] = sides[d]->targets;
+            arrays[first + 2] = sides[d]->weights;
+            arrays[first + 3] = middles[d];
+            counts[first] = ch->numVertices + 1;
+            counts[first + 1] = counts[first + 2] = counts[first + 3] = sides[d]->numEdges;
+        }
+    }
+
+    long long offset = SNAPSHOT_PAGE;
+    for (int s = 0; s < SNAPSHOT_SECTIONS; s++) {
+        if (arrays[s] == NULL) continue;
+        header.sections[s].offset = offset;
+        header.sections[s].count = counts[s];
+        offset += (counts[s] * (long long)sizeof(int) + SNAPSHOT_PAGE - 1) / SNAPSHOT_PAGE * SNAPSHOT_PAGE;
+    }
+    if (checksum) {
+        header.flags |= SNAPSHOT_CHECKSUM;
+        header.checksum = SNAPSHOT_CHECKSUM_SEED;
+        for (int s = 0; s < SNAPSHOT_SECTIONS; s++) {
+            header.checksum = checksumWords(header.checksum, arrays[s], arrays[s] != NULL ? counts[s] : 0);
+        }
+    }
+
+    int fd = open(fileName, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        perror("Failed to open snapshot file");
+        return 0;
+    }
+
+    // the gaps up to each page boundary stay holes that read back as zeros
+    int ok = pwrite(fd, &header, sizeof(header), 0) == (ssize_t)sizeof(header);
+    for (int s = 0; s < SNAPSHOT_SECTIONS && ok; s++) {
+        size_t bytes = header.sections[s].count * sizeof(int);
+        const char* data = (const char*)arrays[s];
+        for (size_t done = 0; done < bytes && ok;) {
+            ssize_t written = pwrite(fd, data + done, bytes - done, header.sections[s].offset + done);
+            ok = written > 0;
+            done += ok ? written : 0;
+        }
+    }
+    ok = ok && ftruncate(fd, offset) == 0;
+
+    if (close(fd) != 0) {
+        ok = 0;
+    }
+    return ok;
+}
+
+// a graph whose CSR arrays are views into the snapshot mapping
+static Graph* mappedGraph(const char* data, const SnapshotHeader* header, int first, int numEdges) {
+    Graph* graph = malloc(sizeof(Graph));
+    graph->numVertices = header->numVertices;
+    graph->numEdges = numEdges;
+    graph->adjList = NULL;
+    graph->offsets = (int*)(data + header->sections[first].offset);
+    graph->targets = (int*)(data + header->sections[first + 1].offset);
+    graph->weights = (int*)(data + header->sections[first + 2].offset);
+    graph->mapped = 1;
+    graph->labels = NULL;
+    graph->vertexOf = NULL;
+    return graph;
+}
+
+static int snapshotSectionValid(const SnapshotHeader* header, int section, long long count, size_t size) {
+    const SnapshotSection* s = &header->sections[section];
+    return s->count == count && s->offset >= SNAPSHOT_PAGE && s->offset % SNAPSHOT_PAGE == 0
+        && (size_t)s->offset + (size_t)count * sizeof(int) <= size;
+}
+
+// 1 if the file starts with the snapshot magic number
+int isGraphSnapshot(const char* fileName) {
+    int magic = 0;
+    int fd = open(fileName, O_RDONLY);
+    if (fd < 0) return 0;
+    int ok = read(fd, &magic, sizeof(magic)) == (ssize_t)sizeof(magic);
+    close(fd);
+    return ok && magic == SNAPSHOT_MAGIC;
+}
+
+// map a snapshot read-only and shared, so every process opening the same file uses one page-cache
+// copy; the graph and hierarchy are used in place. The header is checked, then the arrays in
+// one pass (offsets, targets, middles and ranks in range); verify also checks the stored
+// checksum against every section. NULL (with a message) on errors.
+GraphSnapshot* openGraphSnapshot(const char* fileName, int verify) {
+    int fd = open(fileName, O_RDONLY);
+    if (fd < 0) {
+        perror("Failed to open snapshot file");
+        return NULL;
+    }
+
+    struct stat info;
+    if (fstat(fd, &info) != 0 || (size_t)info.st_size < SNAPSHOT_PAGE) {
+        printf("%s: not a graph snapshot\n", fileName);
+        close(fd);
+        return NULL;
+    }
+
+    size_t size = info.st_size;
+    char* data = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        perror("Failed to map snapshot file");
+        return NULL;
+    }
+
+    const SnapshotHeader* header = (const SnapshotHeader*)data;
+    int hierarchy = header->flags & SNAPSHOT_HIERARCHY;
+    int n = header->numVertices;
+    int valid = header->magic == SNAPSHOT_MAGIC && header->version == SNAPSHOT_VERSION && n > 0 && header->numEdges >= 0
+             && snapshotSectionValid(header, SECTION_OFFSETS, (long long)n + 1, size)
+             && snapshotSectionValid(header, SECTION_TARGETS, header->numEdges, size)
+             && snapshotSectionValid(header, SECTION_WEIGHTS, header->numEdges, size);
+    if (valid && hierarchy) {
+        valid = snapshotSectionValid(header, SECTION_RANK, n, size);
+        for (int d = 0; d < 2 && valid; d++) {
+            int first = d == 0 ? SECTION_UPWARD_OFFSETS : SECTION_DOWNWARD_OFFSETS;
+            int numEdges = d == 0 ? header->upwardEdges : header->downwardEdges;
+            valid = numEdges >= 0 && snapshotSectionValid(header, first, (long long)n + 1, size);
+            for (int s = first + 1; s <= first + 3 && valid; s++) {
+                valid = snapshotSectionValid(header, s, numEdges, size);
+            }
+        }
+    } else {
+        // the checksum walks every section, so those of a missing hierarchy must be empty
+        for (int s = SECTION_RANK; s < SNAPSHOT_SECTIONS && valid; s++) {
+            valid = header->sections[s].count == 0;
+        }
+    }
+    if (!valid) {
+        printf("%s: unsupported version or corrupt snapshot header\n", fileName);
+        munmap(data, size);
+        return NULL;
+    }
+
+    if (verify) {
+        if (!(header->flags & SNAPSHOT_CHECKSUM)) {
+            printf("%s: no checksum stored, skipping verification\n", fileName);
+        } else if (snapshotChecksum(data, header) != header->checksum) {
+            printf("%s: checksum mismatch\n", fileName);
+            munmap(data, size);
+            return NULL;
+        }
+    }
+
+    GraphSnapshot* snapshot = malloc(sizeof(GraphSnapshot));
+    snapshot->data = data;
+    snapshot->size = size;
+    snapshot->graph = mappedGraph(data, header, SECTION_OFFSETS, header->numEdges);
+    snapshot->hierarchy = NULL;
+    if (hierarchy) {
+        ContractionHierarchy* ch = createHierarchyShell(n, (int*)(data + header->sections[SECTION_RANK].offset));
+        ch->mapped = 1;
+        ch->upward = mappedGraph(data, header, SECTION_UPWARD_OFFSETS, header->upwardEdges);
+        ch->downward = mappedGraph(data, header, SECTION_DOWNWARD_OFFSETS, header->downwardEdges);
+        ch->upwardMiddle = (int*)(data + header->sections[SECTION_UPWARD_MIDDLE].offset);
+        ch->downwardMiddle = (int*)(data + header->sections[SECTION_DOWNWARD_MIDDLE].offset);
+        snapshot->hierarchy = ch;
+    }
+
+    // the queries index with the mapped arrays directly, so their contents are checked as
+    // readBinaryGraph() and loadContractionHierarchy() check theirs
+    ContractionHierarchy* ch = snapshot->hierarchy;
+    if (!validCsrArrays(snapshot->graph, NULL)
+        || (ch != NULL && (!validRanks(ch->rank, n) || !validCsrArrays(ch->upward, ch->upwardMiddle)
+                           || !validCsrArrays(ch->downward, ch->downwardMiddle)
+                           || !validShortcutRanks(ch->upward, ch->upwardMiddle, ch->rank)
+                           || !validShortcutRanks(ch->downward, ch->downwardMiddle, ch->rank)))) {
+        printf("%s: corrupt snapshot\n", fileName);
+        if (ch != NULL) {
+            freeContractionHierarchy(ch);
+        }
+        freeGraph(snapshot->graph);
+        closeGraphSnapshot(snapshot);
+        return NULL;
+    }
+    return snapshot;
+}
+
+// unmap a snapshot; the graph and hierarchy taken from it must have been freed before
+void closeGraphSnapshot(GraphSnapshot* snapshot) {
+    munmap(snapshot->data, snapshot->size);
+    free(snapshot);
+}
+
+// snapshot writer: weighted_graph snapshot <graph file> <output> [ch] [checksum]
+int createSnapshotFile(const char* input, const char* output, int withHierarchy, int checksum, int numThreads) {
+    Graph* graph = loadGraph(input, numThreads);
+    if (graph == NULL) return 1;
+
+    ContractionHierarchy* ch = NULL;
+    if (withHierarchy) {
+        if (hasNegativeWeights(graph)) {
+            printf("Contraction hierarchies need non-negative weights\n");
+            freeGraph(graph);
+            return 1;
+        }
+        double start = currentTime();
+        ch = buildContractionHierarchy(graph);
+        printf("Built hierarchy with %d shortcuts in %.3f s\n", hierarchyShortcuts(ch), currentTime() - start);
+    }
+
+    double start = currentTime();
+    int ok = saveGraphSnapshot(graph, ch, output, checksum);
+    if (ok) {
+        printf("Wrote snapshot %s (%d vertices, %d edges%s%s) in %.3f s\n", output, graph->numVertices, graph->numEdges,
+               ch != NULL ? ", contraction hierarchy" : "", checksum ? ", checksum" : "", currentTime() - start);
+    } else {
+        printf("Failed to write %s\n", output);
+    }
+
+    if (ch != NULL) {
+        freeContractionHierarchy(ch);
+    }
+    freeGraph(graph);
+    return ok ? 0 : 1;
+}
+
+static DynamicEdge* dynamicListFind(DynamicEdgeList* list, int target) {
+    for (int i = 0; i < list->size; i++) {
+        if (list->edges[i].target == target) return &list->edges[i];
+    }
+    return NULL;
+}
+
+static void dynamicListAppend(DynamicEdgeList* list, int target, int weight) {
+    if (list->size == list->capacity) {
+        list->capacity = list->capacity ? list->capacity * 2 : 4;
+        list->edges = realloc(list->edges, list->capacity * sizeof(DynamicEdge));
+    }
+    list->edges[list->size].target = target;
+    list->edges[list->size++].weight = weight;
+}
+
+static void dynamicListRemove(DynamicEdgeList* list, int target) {
+    DynamicEdge* edge = dynamicListFind(list, target);
+    *edge = list->edges[--list->size];
+}
+
+// function to copy a finalized graph into growable edge lists; parallel edges keep the lightest weight
+DynamicGraph* createDynamicGraph(Graph* graph) {
+    DynamicGraph* dynamic = malloc(sizeof(DynamicGraph));
+    dynamic->numVertices = graph->numVertices;
+    dynamic->numEdges = 0;
+    dynamic->out = calloc(graph->numVertices, sizeof(DynamicEdgeList));
+    dynamic->in = calloc(graph->numVertices, sizeof(DynamicEdgeList));
+
+    for (int u = 0; u < graph->numVertices; u++) {
+        for (int e = graph->offsets[u]; e < graph->offsets[u + 1]; e++) {
+            DynamicEdge* edge = dynamicListFind(&dynamic->out[u], graph->targets[e]);
+            if (edge == NULL) {
+                dynamicInsertEdge(dynamic, u, graph->targets[e], graph->weights[e]);
+            } else if (graph->weights[e] < edge->weight) {
+                dynamicUpdateWeight(dynamic, u, graph->targets[e], graph->weights[e]);
+            }
+        }
+    }
+    return dynamic;
+}
+
+void freeDynamicGraph(DynamicGraph* graph) {
+    for (int i = 0; i < graph->numVertices; i++) {
+        free(graph->out[i].edges);
+        free(graph->in[i].edges);
+    }
+    free(graph->out);
+    free(graph->in);
+    free(graph);
+}
+
+static int dynamicEdgeValid(DynamicGraph* graph, int src, int dest) {
+    return src >= 0 && src < graph->numVertices && dest >= 0 && dest < graph->numVertices;
+}
+
+// insert edge src -> dest; returns 0 if a vertex is out of range or the edge already exists
+int dynamicInsertEdge(DynamicGraph* graph, int src, int dest, int weight) {
+    if (!dynamicEdgeValid(graph, src, dest) || dynamicListFind(&graph->out[src], dest) != NULL) return 0;
+
+    dynamicListAppend(&graph->out[src], dest, weight);
+    dynamicListAppend(&graph->in[dest], src, weight);
+    graph->numEdges++;
+    return 1;
+}
+
+// change the weight of edge src -> dest; returns 0 if there is no such edge
+int dynamicUpdateWeight(DynamicGraph* graph, int src, int dest, int weight) {
+    if (!dynamicEdgeValid(graph, src, dest)) return 0;
+    DynamicEdge* edge = dynamicListFind(&graph->out[src], dest);
+    if (edge == NULL) return 0;
+
+    edge->weight = weight;
+    dynamicListFind(&graph->in[dest], src)->weight = weight;
+    return 1;
+}
+
+// delete edge src -> dest; returns 0 if there is no such edge
+int dynamicDeleteEdge(DynamicGraph* graph, int src, int dest) {
+    if (!dynamicEdgeValid(graph, src, dest) || dynamicListFind(&graph->out[src], dest) == NULL) return 0;
+
+    dynamicListRemove(&graph->out[src], dest);
+    dynamicListRemove(&graph->in[dest], src);
+    graph->numEdges--;
+    return 1;
+}
+
+// settle the queued vertices in distance order, relaxing out-edges
+static void dynamicPropagate(DynamicSSSP* sssp) {
+    DynamicGraph* graph = sssp->graph;
+
+    while (sssp->heap->size > 0) {
+        int u = heapPop(sssp->heap);
+        sssp->processed++;
+
+        DynamicEdgeList* list = &graph->out[u];
+        for (int i = 0; i < list->size; i++) {
+            int v = list->edges[i].target;
+            int newDistance = sssp->distances[u] + list->edges[i].weight;
+            if (newDistance >= sssp->distances[v]) continue;
+
+            sssp->distances[v] = newDistance;
+            sssp->parent[v] = u;
+            if (sssp->heap->position[v] >= 0) {
+                heapDecreaseKey(sssp->heap, v);
+            } else {
+                heapPush(sssp->heap, v);
+            }
+        }
+    }
+}
+
+// full Dijkstra from the source, discarding the current tree
+void dynamicRecompute(DynamicSSSP* sssp) {
+    for (int v = 0; v < sssp->graph->numVertices; v++) {
+        sssp->distances[v] = INT_MAX;
+        sssp->parent[v] = -1;
+    }
+    sssp->distances[sssp->source] = 0;
+    sssp->processed = 0;
+    heapPush(sssp->heap, sssp->source);
+    dynamicPropagate(sssp);
+}
+
+// function to compute the shortest-path tree that later edge changes keep up to date; returns
+// NULL if the source is out of range or an edge has a negative weight
+DynamicSSSP* createDynamicSSSP(DynamicGraph* graph, int source) {
+    if (source < 0 || source >= graph->numVertices) return NULL;
+    for (int u = 0; u < graph->numVertices; u++) {
+        for (int i = 0; i < graph->out[u].size; i++) {
+            if (graph->out[u].edges[i].weight < 0) return NULL;
+        }
+    }
+
+    DynamicSSSP* sssp = malloc(sizeof(DynamicSSSP));
+    sssp->graph = graph;
+    sssp->source = source;
+    sssp->distances = calloc(graph->numVertices, sizeof(int));
+    sssp->parent = malloc(graph->numVertices * sizeof(int));
+    sssp->affected = calloc(graph->numVertices, 1);
+    sssp->heap = createIndexedHeap(graph->numVertices, sssp->distances);
+    sssp->invalidated.items = NULL;
+    sssp->invalidated.size = 0;
+    sssp->invalidated.capacity = 0;
+    dynamicRecompute(sssp);
+    return sssp;
+}
+
+void freeDynamicSSSP(DynamicSSSP* sssp) {
+    free(sssp->distances);
+    free(sssp->parent);
+    free(sssp->affected);
+    free(sssp->invalidated.items);
+    freeIndexedHeap(sssp->heap);
+    free(sssp);
+}
+
+// detach the subtree below v: its distances may only have grown and are recomputed
+static void invalidateSubtree(DynamicSSSP* sssp, int v) {
+    VertexList* list = &sssp->invalidated;
+    int first = list->size;
+
+    sssp->affected[v] = 1;
+    vertexListPush(list, v);
+    for (int i = first; i < list->size; i++) {
+        int x = list->items[i];
+        DynamicEdgeList* out = &sssp->graph->out[x];
+        for (int j = 0; j < out->size; j++) {
+            int y = out->edges[j].target;
+            if (sssp->parent[y] == x && !sssp->affected[y]) {
+                sssp->affected[y] = 1;
+                vertexListPush(list, y);
+            }
+        }
+    }
+}
+
+// apply a batch of edge changes and repair the tree (Ramalingam-Reps style): subtrees hanging
+// from tree edges that got heavier or vanished are invalidated and re-seeded from their
+// unaffected in-neighbours, lighter or new edges seed their heads, and a single Dijkstra pass
+// settles only the vertices whose distance changes. Weights must stay non-negative; returns the
+// number of changes rejected (unknown or duplicate edges, bad vertices, negative weights).
+int applyEdgeChanges(DynamicSSSP* sssp, const EdgeChange* changes, int numChanges) {
+    DynamicGraph* graph = sssp->graph;
+    int rejected = 0;
+
+    sssp->processed = 0;
+    sssp->invalidated.size = 0;
+
+    for (int i = 0; i < numChanges; i++) {
+        const EdgeChange* change = &changes[i];
+        int u = change->src, v = change->dest;
+        int oldWeight = INT_MAX;
+        if (dynamicEdgeValid(graph, u, v) && dynamicListFind(&graph->out[u], v) != NULL) {
+            oldWeight = dynamicListFind(&graph->out[u], v)->weight;
+        }
+
+        int ok;
+        if (change->type == EDGE_DELETE) {
+            ok = dynamicDeleteEdge(graph, u, v);
+        } else if (change->weight < 0) {
+            ok = 0;
+        } else if (change->type == EDGE_INSERT) {
+            ok = dynamicInsertEdge(graph, u, v, change->weight);
+        } else {
+            ok = dynamicUpdateWeight(graph, u, v, change->weight);
+        }
+        if (!ok) {
+            rejected++;
+            continue;
+        }
+
+        int heavier = change->type == EDGE_DELETE || change->weight > oldWeight;
+        if (heavier && sssp->parent[v] == u && !sssp->affected[v]) {
+            invalidateSubtree(sssp, v);
+        }
+    }
+
+    for (int i = 0; i < sssp->invalidated.size; i++) {
+        int v = sssp->invalidated.items[i];
+        sssp->distances[v] = INT_MAX;
+        sssp->parent[v] = -1;
+    }
+
+    // best path into each invalidated vertex through a vertex whose distance is still valid
+    for (int i = 0; i < sssp->invalidated.size; i++) {
+        int v = sssp->invalidated.items[i];
+        DynamicEdgeList* in = &graph->in[v];
+        for (int j = 0; j < in->size; j++) {
+            int u = in->edges[j].target;
+            if (sssp->affected[u] || sssp->distances[u] == INT_MAX) continue;
+            if (sssp->distances[u] + in->edges[j].weight < sssp->distances[v]) {
+                sssp->distances[v] = sssp->distances[u] + in->edges[j].weight;
+                sssp->parent[v] = u;
+            }
+        }
+        if (sssp->distances[v] != INT_MAX) {
+            heapPush(sssp->heap, v);
+        }
+    }
+    for (int i = 0; i < sssp->invalidated.size; i++) {
+        sssp->affected[sssp->invalidated.items[i]] = 0;
+    }
+
+    // lighter and new edges can only shorten paths through their head
+    for (int i = 0; i < numChanges; i++) {
+        const EdgeChange* change = &changes[i];
+        if (change->type == EDGE_DELETE || !dynamicEdgeValid(graph, change->src, change->dest)) continue;
+        int u = change->src, v = change->dest;
+        DynamicEdge* edge = dynamicListFind(&graph->out[u], v);
+        if (edge == NULL || sssp->distances[u] == INT_MAX || sssp->distances[u] + edge->weight >= sssp->distances[v]) continue;
+
+        sssp->distances[v] = sssp->distances[u] + edge->weight;
+        sssp->parent[v] = u;
+        if (sssp->heap->position[v] >= 0) {
+            heapDecreaseKey(sssp->heap, v);
+        } else {
+            heapPush(sssp->heap, v);
+        }
+    }
+
+    dynamicPropagate(sssp);
+    return rejected;
+}
+
+// id shown to the user for vertex v
+int vertexLabel(Graph* graph, int v) {
+    return graph->labels != NULL ? graph->labels[v] : v;
+}
+
+// vertex known to the user as id; out-of-range ids are returned unchanged so callers still reject them
+int vertexIndex(Graph* graph, int id) {
+    if (graph->vertexOf == NULL || id < 0 || id >= graph->numVertices) return id;
+    return graph->vertexOf[id];
+}
+
+// breadth-first search - number of edges on the shortest path from startVertex, INT_MAX if unreachable
+void computeBFS(Graph* graph, int startVertex, int* levels) {
+    int* queue = malloc(graph->numVertices * sizeof(int));
+    int head = 0, tail = 0;
+
+    for (int i = 0; i < graph->numVertices; i++) {
+        levels[i] = INT_MAX;
+    }
+    levels[startVertex] = 0;
+    queue[tail++] = startVertex;
+
+    while (head < tail) {
+        int u = queue[head++];
+        for (int e = graph->offsets[u]; e < graph->offsets[u + 1]; e++) {
+            int v = graph->targets[e];
+            if (levels[v] == INT_MAX) {
+                levels[v] = levels[u] + 1;
+                queue[tail++] = v;
+            }
+        }
+    }
+    free(queue);
+}
+
+static int outDegree(Graph* graph, int v) {
+    return graph->offsets[v + 1] - graph->offsets[v];
+}
+
+// vertices by increasing out-degree, ties in id order (counting sort)
+static int* verticesByDegree(Graph* graph) {
+    int n = graph->numVertices;
+    int maxDegree = 0;
+    for (int v = 0; v < n; v++) {
+        if (outDegree(graph, v) > maxDegree) maxDegree = outDegree(graph, v);
+    }
+
+    int* count = calloc(maxDegree + 2, sizeof(int));
+    int* sorted = malloc(n * sizeof(int));
+    for (int v = 0; v < n; v++) {
+        count[outDegree(graph, v) + 1]++;
+    }
+    for (int d = 0; d <= maxDegree; d++) {
+        count[d + 1] += count[d];
+    }
+    for (int v = 0; v < n; v++) {
+        sorted[count[outDegree(graph, v)]++] = v;
+    }
+    free(count);
+    return sorted;
+}
+
+// breadth-first numbering of every component, each started from the next vertex of starts;
+// with byDegree the unvisited neighbours of a vertex are numbered by increasing degree (Cuthill-McKee)
+static void breadthFirstOrder(Graph* graph, const int* starts, int byDegree, int* order) {
+    int n = graph->numVertices;
+    char* visited = calloc(n, 1);
+    int tail = 0;
+
+    for (int s = 0; s < n; s++) {
+        if (visited[starts[s]]) continue;
+        visited[starts[s]] = 1;
+        order[tail++] = starts[s];
+
+        for (int head = tail - 1; head < tail; head++) {
+            int u = order[head];
+            int first = tail;
+            for (int e = graph->offsets[u]; e < graph->offsets[u + 1]; e++) {
+                int v = graph->targets[e];
+                if (visited[v]) continue;
+                visited[v] = 1;
+                order[tail++] = v;
+            }
+
+            // neighbour lists are short, insertion sort is enough
+            for (int i = first + 1; i < tail && byDegree; i++) {
+                int v = order[i];
+                int j = i;
+                while (j > first && outDegree(graph, order[j - 1]) > outDegree(graph, v)) {
+                    order[j] = order[j - 1];
+                    j--;
+                }
+                order[j] = v;
+            }
+        }
+    }
+    free(visited);
+}
+
+// function to compute a locality-friendly numbering: newId[v] is the new id of vertex v.
+// Vertices close in the graph get close ids, so a search touches fewer cache lines and pages.
+int* computeVertexOrder(Graph* graph, VertexOrder order) {
+    int n = graph->numVertices;
+    int* sequence = malloc(n * sizeof(int));
+
+    if (order == ORDER_BFS) {
+        int* starts = malloc(n * sizeof(int));
+        for (int v = 0; v < n; v++) {
+            starts[v] = v;
+        }
+        breadthFirstOrder(graph, starts, 0, sequence);
+        free(starts);
+    } else if (order == ORDER_RCM) {
+        // peripheral-ish starts: every component begins at its lowest-degree vertex
+        int* starts = verticesByDegree(graph);
+        breadthFirstOrder(graph, starts, 1, sequence);
+        free(starts);
+        for (int i = 0; i < n / 2; i++) {
+            int temp = sequence[i];
+            sequence[i] = sequence[n - 1 - i];
+            sequence[n - 1 - i] = temp;
+        }
+    } else {
+        // hubs are touched by most searches, packing them together keeps them cached
+        int* sorted = verticesByDegree(graph);
+        for (int i = 0; i < n; i++) {
+            sequence[i] = sorted[n - 1 - i];
+        }
+        free(sorted);
+    }
+
+    int* newId = malloc(n * sizeof(int));
+    for (int i = 0; i < n; i++) {
+        newId[sequence[i]] = i;
+    }
+    free(sequence);
+    return newId;
+}
+
+// function to renumber a finalized graph: vertex v becomes newId[v], edges keep their order.
+// The ids shown to the user carry over, so results still print with the original ids.
+Graph* permuteGraph(Graph* graph, const int* newId) {
+    int n = graph->numVertices;
+    Graph* permuted = malloc(sizeof(Graph));
+    permuted->numVertices = n;
+    permuted->numEdges = graph->numEdges;
+    permuted->adjList = NULL;
+    permuted->mapped = 0;
+    permuted->offsets = malloc((n + 1) * sizeof(int));
+    permuted->targets = malloc(graph->numEdges * sizeof(int));
+    permuted->weights = malloc(graph->numEdges * sizeof(int));
+    permuted->labels = malloc(n * sizeof(int));
+    permuted->vertexOf = malloc(n * sizeof(int));
+
+    permuted->offsets[0] = 0;
+    for (int v = 0; v < n; v++) {
+        permuted->labels[newId[v]] = v;
+    }
+    for (int x = 0; x < n; x++) {
+        permuted->offsets[x + 1] = permuted->offsets[x] + outDegree(graph, permuted->labels[x]);
+    }
+
+    for (int v = 0; v < n; v++) {
+        int slot = permuted->offsets[newId[v]];
+        for (int e = graph->offsets[v]; e < graph->offsets[v + 1]; e++, slot++) {
+            permuted->targets[slot] = newId[graph->targets[e]];
+            permuted->weights[slot] = graph->weights[e];
+        }
+    }
+
+    // labels[x] is the old vertex for now; map it on to the id the user knows
+    for (int x = 0; x < n; x++) {
+        permuted->labels[x] = vertexLabel(graph, permuted->labels[x]);
+        permuted->vertexOf[permuted->labels[x]] = x;
+    }
+    return permuted;
+}
+
+// function to create a copy of the graph renumbered for locality; the original is left untouched
+Graph* reorderGraph(Graph* graph, VertexOrder order) {
+    int* newId = computeVertexOrder(graph, order);
+    Graph* reordered = permuteGraph(graph, newId);
+    free(newId);
+    return reordered;
+}
+
+const char* vertexOrderName(VertexOrder order) {
+    switch (order) {
+        case ORDER_BFS:
+            return "breadth-first";
+        case ORDER_RCM:
+            return "reverse Cuthill-McKee";
+        default:
+            return "degree";
+    }
+}
+
+// function to create the alternative-route engine for a finalized graph with non-negative weights
+PathFinder* createPathFinder(Graph* graph) {
+    int n = graph->numVertices;
+    PathFinder* finder = malloc(sizeof(PathFinder));
+    finder->graph = graph;
+    finder->reverse = createReverseGraph(graph);
+    finder->toTarget = createDijkstraWorkspace(n);
+    finder->hopsToTarget = malloc(n * sizeof(int));
+    finder->target = -1;
+    createSearchSide(&finder->side, n);
+    finder->parentEdge = malloc(n * sizeof(int));
+    finder->query = 0;
+    finder->blockedVertex = calloc(n, sizeof(int));
+    finder->blockedEdge = calloc(graph->numEdges > 0 ? graph->numEdges : 1, 1);
+    finder->blockRound = 0;
+    finder->bestHops = malloc(n * sizeof(int));
+    finder->labels = NULL;
+    finder->numLabels = 0;
+    finder->labelCapacity = 0;
+    finder->labelHeap = NULL;
+    finder->labelHeapSize = 0;
+    finder->settled = 0;
+    finder->spurSearches = 0;
+    return finder;
+}
+
+void freePathFinder(PathFinder* finder) {
+    freeGraph(finder->reverse);
+    freeDijkstraWorkspace(finder->toTarget);
+    free(finder->hopsToTarget);
+    freeSearchSide(&finder->side);
+    free(finder->parentEdge);
+    free(finder->blockedVertex);
+    free(finder->blockedEdge);
+    free(finder->bestHops);
+    free(finder->labels);
+    free(finder->labelHeap);
+    free(finder);
+}
+
+void freePath(Path* path) {
+    free(path->vertices);
+    free(path->edges);
+}
+
+static Path createPath(int distance, int length) {
+    Path path;
+    path.distance = distance;
+    path.length = length;
+    path.vertices = malloc(length * sizeof(int));
+    path.edges = malloc(length * sizeof(int));
+    return path;
+}
+
+// distances and edge counts to the target over the reverse graph, kept while the target stays the same
+static void prepareTarget(PathFinder* finder, int target) {
+    if (finder->target == target) return;
+    workspaceDijkstra(finder->reverse, target, finder->toTarget);
+    computeBFS(finder->reverse, target, finder->hopsToTarget);
+    finder->target = target;
+}
+
+// A* from spur to the target on the graph minus the blocked vertices and edges, giving up once
+// the key reaches limit. Blocking only removes edges, so the exact distances of the full graph
+// stay a consistent heuristic. Returns the distance, or INT_MAX.
+static int spurSearch(PathFinder* finder, int spur, int limit) {
+    Graph* graph = finder->graph;
+    SearchSide* side = &finder->side;
+    const int* toTarget = finder->toTarget->distances;
+    int query = ++finder->query;
+    int result = INT_MAX;
+
+    finder->spurSearches++;
+    if (toTarget[spur] >= limit) return INT_MAX;
+    sideUpdate(side, spur, 0, -1, toTarget[spur], query);
+    finder->parentEdge[spur] = -1;
+
+    while (side->heap->size > 0) {
+        int u = heapPop(side->heap);
+        finder->settled++;
+        if (side->keys[u] >= limit) break;
+        if (u == finder->target) {
+            result = side->distances[u];
+            break;
+        }
+
+        for (int e = graph->offsets[u]; e < graph->offsets[u + 1]; e++) {
+            int v = graph->targets[e];
+            if (finder->blockedEdge[e] || finder->blockedVertex[v] == finder->blockRound || toTarget[v] == INT_MAX) continue;
+
+            int newDistance = side->distances[u] + graph->weights[e];
+            if (newDistance >= sideDistance(side, v, query)) continue;
+            sideUpdate(side, v, newDistance, u, newDistance + toTarget[v], query);
+            finder->parentEdge[v] = e;
+        }
+    }
+
+    heapClear(side->heap);
+    return result;
+}
+
+// the first rootLength vertices of root followed by the path of the last spur search
+static Path joinSpurPath(PathFinder* finder, const Path* root, int rootLength, int distance) {
+    int spurLength = 0;
+    for (int x = finder->target; x != -1; x = finder->side.parent[x]) {
+        spurLength++;
+    }
+
+    Path path = createPath(distance, rootLength + spurLength);
+    if (rootLength > 0) {
+        memcpy(path.vertices, root->vertices, rootLength * sizeof(int));
+        memcpy(path.edges, root->edges, rootLength * sizeof(int));
+    }
+    int x = finder->target;
+    for (int i = path.length - 1; i >= rootLength; i--) {
+        path.vertices[i] = x;
+        if (i > rootLength) {
+            path.edges[i - 1] = finder->parentEdge[x];
+        }
+        x = finder->side.parent[x];
+    }
+    return path;
+}
+
+static int commonEdges(const Path* a, const Path* b) {
+    int count = 0;
+    while (count < a->length - 1 && count < b->length - 1 && a->edges[count] == b->edges[count]) {
+        count++;
+    }
+    return count;
+}
+
+static int samePath(const Path* a, const Path* b) {
+    return a->distance == b->distance && a->length == b->length && memcmp(a->edges, b->edges, (a->length - 1) * sizeof(int)) == 0;
+}
+
+// Yen's k shortest loopless paths: every next path leaves one of the paths found so far at some
+// spur vertex, avoiding the edges the other paths with the same root took there and the root's
+// vertices. Candidates are kept sorted with the best last, and spur searches stop at the cost of
+// the last candidate that could still be needed. Fills paths[0 .. result - 1] in order of distance;
+// free each with freePath.
+int kShortestPaths(PathFinder* finder, int source, int target, int k, Path* paths) {
+    Graph* graph = finder->graph;
+    finder->settled = 0;
+    finder->spurSearches = 0;
+    if (k <= 0) return 0;
+    prepareTarget(finder, target);
+
+    finder->blockRound++;
+    if (spurSearch(finder, source, INT_MAX) == INT_MAX) return 0;
+    paths[0] = joinSpurPath(finder, NULL, 0, finder->side.distances[target]);
+
+    Path* candidates = NULL;
+    int numCandidates = 0, candidateCapacity = 0;
+    int* blocked = malloc(k * sizeof(int));
+    int* common = malloc(k * sizeof(int));
+    int found = 1;
+
+    while (found < k) {
+        const Path* previous = &paths[found - 1];
+        for (int p = 0; p < found; p++) {
+            common[p] = commonEdges(&paths[p], previous);
+        }
+
+        int rootDistance = 0;
+        for (int i = 0; i < previous->length - 1; i++) {
+            int numBlocked = 0;
+            for (int p = 0; p < found; p++) {
+                int e = paths[p].length - 1 > i && common[p] >= i ? paths[p].edges[i] : -1;
+                if (e >= 0 && !finder->blockedEdge[e]) {
+                    finder->blockedEdge[e] = 1;
+                    blocked[numBlocked++] = e;
+                }
+            }
+            finder->blockRound++;
+            for (int j = 0; j < i; j++) {
+                finder->blockedVertex[previous->vertices[j]] = finder->blockRound;
+            }
+
+            int needed = k - found;
+            int limit = numCandidates >= needed ? candidates[numCandidates - needed].distance - rootDistance : INT_MAX;
+            int spurDistance = limit > 0 ? spurSearch(finder, previous->vertices[i], limit) : INT_MAX;
+            for (int b = 0; b < numBlocked; b++) {
+                finder->blockedEdge[blocked[b]] = 0;
+            }
+
+            if (spurDistance != INT_MAX) {
+                Path candidate = joinSpurPath(finder, previous, i, rootDistance + spurDistance);
+                int duplicate = 0;
+                for (int c = numCandidates - 1; c >= 0 && candidates[c].distance <= candidate.distance && !duplicate; c--) {
+                    duplicate = samePath(&candidates[c], &candidate);
+                }
+
+                if (duplicate) {
+                    freePath(&candidate);
+                } else {
+                    if (numCandidates == candidateCapacity) {
+                        candidateCapacity = candidateCapacity ? candidateCapacity * 2 : 16;
+                        candidates = realloc(candidates, candidateCapacity * sizeof(Path));
+                    }
+                    // equal distances stay first come, first served
+                    int slot = numCandidates;
+                    while (slot > 0 && candidates[slot - 1].distance < candidate.distance) {
+                        slot--;
+                    }
+                    memmove(candidates + slot + 1, candidates + slot, (numCandidates - slot) * sizeof(Path));
+                    candidates[slot] = candidate;
+                    numCandidates++;
+                }
+            }
+            rootDistance += graph->weights[previous->edges[i]];
+        }
+
+        if (numCandidates == 0) break;
+        paths[found++] = candidates[--numCandidates];
+
+        // candidates beyond the k - found best can no longer be reached
+        int surplus = numCandidates - (k - found);
+        if (surplus > 0) {
+            for (int c = 0; c < surplus; c++) {
+                freePath(&candidates[c]);
+            }
+            memmove(candidates, candidates + surplus, (numCandidates - surplus) * sizeof(Path));
+            numCandidates -= surplus;
+        }
+    }
+
+    for (int c = 0; c < numCandidates; c++) {
+        freePath(&candidates[c]);
+    }
+    free(candidates);
+    free(blocked);
+    free(common);
+    return found;
+}
+
+static int labelKey(PathFinder* finder, int label) {
+    return finder->labels[label].distance + finder->toTarget->distances[finder->labels[label].vertex];
+}
+
+static void pushHopLabel(PathFinder* finder, int vertex, int hops, int distance, int parent, int edge) {
+    if (finder->numLabels == finder->labelCapacity) {
+        finder->labelCapacity = finder->labelCapacity ? finder->labelCapacity * 2 : 1024;
+        finder->labels = realloc(finder->labels, finder->labelCapacity * sizeof(HopLabel));
+        finder->labelHeap = realloc(finder->labelHeap, finder->labelCapacity * sizeof(int));
+    }
+
+    int label = finder->numLabels++;
+    finder->labels[label].vertex = vertex;
+    finder->labels[label].hops = hops;
+    finder->labels[label].distance = distance;
+    finder->labels[label].parent = parent;
+    finder->labels[label].edge = edge;
+
+    int* heap = finder->labelHeap;
+    int index = finder->labelHeapSize++;
+    int key = labelKey(finder, label);
+    while (index > 0 && labelKey(finder, heap[(index - 1) / 2]) > key) {
+        heap[index] = heap[(index - 1) / 2];
+        index = (index - 1) / 2;
+    }
+    heap[index] = label;
+}
+
+static int popHopLabel(PathFinder* finder) {
+    int* heap = finder->labelHeap;
+    int top = heap[0];
+    int last = heap[--finder->labelHeapSize];
+    int key = labelKey(finder, last);
+    int index = 0;
+
+    while (2 * index + 1 < finder->labelHeapSize) {
+        int child = 2 * index + 1;
+        if (child + 1 < finder->labelHeapSize && labelKey(finder, heap[child + 1]) < labelKey(finder, heap[child])) {
+            child++;
+        }
+        if (labelKey(finder, heap[child]) >= key) break;
+        heap[index] = heap[child];
+        index = child;
+    }
+    heap[index] = last;
+    return top;
+}
+
+// shortest path using at most maxHops edges: label-setting A* over (vertex, hops) states. Labels
+// leave the queue by distance, so a label is dominated once its vertex was settled with no more
+// hops, and edge counts to the target prune labels that cannot arrive in time.
+// Returns the distance and fills path (free with freePath), or INT_MAX.
+int hopLimitedPath(PathFinder* finder, int source, int target, int maxHops, Path* path) {
+    Graph* graph = finder->graph;
+    finder->settled = 0;
+    path->distance = INT_MAX;
+    path->length = 0;
+    path->vertices = NULL;
+    path->edges = NULL;
+
+    prepareTarget(finder, target);
+    if (finder->hopsToTarget[source] > maxHops) return INT_MAX;
+
+    for (int v = 0; v < graph->numVertices; v++) {
+        finder->bestHops[v] = INT_MAX;
+    }
+    finder->numLabels = 0;
+    finder->labelHeapSize = 0;
+    pushHopLabel(finder, source, 0, 0, -1, -1);
+
+    while (finder->labelHeapSize > 0) {
+        int label = popHopLabel(finder);
+        HopLabel current = finder->labels[label];
+        if (current.hops >= finder->bestHops[current.vertex]) continue;
+        finder->bestHops[current.vertex] = current.hops;
+        finder->settled++;
+
+        if (current.vertex == target) {
+            *path = createPath(current.distance, current.hops + 1);
+            for (int i = current.hops; i >= 0; i--) {
+                path->vertices[i] = finder->labels[label].vertex;
+                if (i > 0) {
+                    path->edges[i - 1] = finder->labels[label].edge;
+                }
+                label = finder->labels[label].parent;
+            }
+            return current.distance;
+        }
+
+        int hops = current.hops + 1;
+        for (int e = graph->offsets[current.vertex]; e < graph->offsets[current.vertex + 1]; e++) {
+            int v = graph->targets[e];
+            if (finder->hopsToTarget[v] == INT_MAX || hops + finder->hopsToTarget[v] > maxHops || hops >= finder->bestHops[v]) continue;
+            pushHopLabel(finder, v, hops, current.distance + graph->weights[e], label, e);
+        }
+    }
+    return INT_MAX;
+}
+
+static void printPathVertices(Graph* graph, const Path* path) {
+    printf("Path: ");
+    for (int i = 0; i < path->length; i++) {
+        printf(i == 0 ? "%d" : " -> %d", vertexLabel(graph, path->vertices[i]));
+    }
+    printf("\n");
+}
+
+// alternative routes - print up to k shortest loopless paths from source to target
+void alternativeRoutes(PathFinder* finder, int source, int target, int k) {
+    Graph* graph = finder->graph;
+    int n = graph->numVertices;
+    if (source < 0 || source >= n || target < 0 || target >= n || k <= 0) {
+        printf("Invalid vertex or number of routes\n");
+        return;
+    }
+
+    Path* paths = malloc(k * sizeof(Path));
+    int found = kShortestPaths(finder, source, target, k, paths);
+    if (found == 0) {
+        printf("Vertex %d is not reachable from vertex %d\n", vertexLabel(graph, target), vertexLabel(graph, source));
+    }
+    for (int i = 0; i < found; i++) {
+        printf("Route %d: distance %d, %d edges\n", i + 1, paths[i].distance, paths[i].length - 1);
+        printPathVertices(graph, &paths[i]);
+        freePath(&paths[i]);
+    }
+    printf("Spur searches: %d, settled vertices: %d\n", finder->spurSearches, finder->settled);
+    free(paths);
+}
+
+// hop-limited route - print the shortest path from source to target with at most maxHops edges
+void hopLimitedRoute(PathFinder* finder, int source, int target, int maxHops) {
+    Graph* graph = finder->graph;
+    int n = graph->numVertices;
+    if (source < 0 || source >= n || target < 0 || target >= n || maxHops < 0) {
+        printf("Invalid vertex or edge limit\n");
+        return;
+    }
+
+    Path path;
+    int distance = hopLimitedPath(finder, source, target, maxHops, &path);
+    if (distance == INT_MAX) {
+        printf("No path from %d to %d with at most %d edges\n", vertexLabel(graph, source), vertexLabel(graph, target), maxHops);
+    } else {
+        printf("Shortest path with at most %d edges from %d to %d: distance %d, %d edges\n", maxHops,
+               vertexLabel(graph, source), vertexLabel(graph, target), distance, path.length - 1);
+        printPathVertices(graph, &path);
+    }
+    printf("Settled labels: %d\n", finder->settled);
+    freePath(&path);
+}
+
+// function to free the graph
+void freeGraph(Graph* graph) {
+    if (graph->adjList != NULL) {
+        for (int i = 0; i < graph->numVertices; i++) {
+            Edge* edge = graph->adjList[i];
+            while (edge != NULL) {
+                Edge* temp = edge;
+                edge = edge->next;
+                free(temp);
+            }
+        }
+        free(graph->adjList);
+    }
+    if (!graph->mapped) {
+        free(graph->offsets);
+        free(graph->targets);
+        free(graph->weights);
+    }
+    free(graph->labels);
+    free(graph->vertexOf);
+    free(graph);
+}
+
+// function to create an indexed heap for vertices 0..capacity-1
+IndexedHeap* createIndexedHeap(int capacity, const int* keys) {
+    IndexedHeap* heap = malloc(sizeof(IndexedHeap));
+    heap->heap = malloc(capacity * sizeof(int));
+    heap->position = malloc(capacity * sizeof(int));
+    heap->keys = keys;
+    heap->size = 0;
+
+    for (int i = 0; i < capacity; i++) {
+        heap->position[i] = -1;
+    }
+
+    return heap;
+}
+
+static void heapSiftUp(IndexedHeap* heap, int index) {
+    int vertex = heap->heap[index];
+    int key = heap->keys[vertex];
+
+    while (index > 0) {
+        int parent = (index - 1) / 2;
+        if (heap->keys[heap->heap[parent]] <= key) break;
+        heap->heap[index] = heap->heap[parent];
+        heap->position[heap->heap[index]] = index;
+        index = parent;
+    }
+
+    heap->heap[index] = vertex;
+    heap->position[vertex] = index;
+}
+
+static void heapSiftDown(IndexedHeap* heap, int index) {
+    int vertex = heap->heap[index];
+    int key = heap->keys[vertex];
+
+    while (1) {
+        int smallest = 2 * index + 1;
+        if (smallest >= heap->size) break;
+        if (smallest + 1 < heap->size && heap->keys[heap->heap[smallest + 1]] < heap->keys[heap->heap[smallest]]) {
+            smallest++;
+        }
+        if (key <= heap->keys[heap->heap[smallest]]) break;
+        heap->heap[index] = heap->heap[smallest];
+        heap->position[heap->heap[index]] = index;
+        index = smallest;
+    }
+
+    heap->heap[index] = vertex;
+    heap->position[vertex] = index;
+}
+
+// insert a vertex that is not in the heap yet
+void heapPush(IndexedHeap* heap, int vertex) {
+    heap->heap[heap->size] = vertex;
+    heapSiftUp(heap, heap->size++);
+}
+
+// restore heap order after the key of a vertex in the heap was lowered
+void heapDecreaseKey(IndexedHeap* heap, int vertex) {
+    heapSiftUp(heap, heap->position[vertex]);
+}
+
+// restore heap order after the key of a vertex in the heap changed in either direction
+void heapUpdate(IndexedHeap* heap, int vertex) {
+    heapSiftUp(heap, heap->position[vertex]);
+    heapSiftDown(heap, heap->position[vertex]);
+}
+
+// remove and return the vertex with the smallest key
+int heapPop(IndexedHeap* heap) {
+    int minVertex = heap->heap[0];
+    heap->position[minVertex] = -1;
+
+    if (--heap->size > 0) {
+        heap->heap[0] = heap->heap[heap->size];
+        heapSiftDown(heap, 0);
+    }
+
+    return minVertex;
+}
+
+void freeIndexedHeap(IndexedHeap* heap) {
+    free(heap->heap);
+    free(heap->position);
+    free(heap);
+}
+
+RadixHeap* createRadixHeap() {
+    return calloc(1, sizeof(RadixHeap));
+}
+
+// bucket 0 holds keys equal to the last popped key, bucket i keys whose highest differing bit is i-1
+static int radixBucketIndex(unsigned int key, unsigned int last) {
+    return key == last ? 0 : 32 - __builtin_clz(key ^ last);
+}
+
+static void radixBucketAppend(RadixBucket* bucket, RadixEntry entry) {
+    if (bucket->size == bucket->capacity) {
+        bucket->capacity = bucket->capacity ? bucket->capacity * 2 : 16;
+        bucket->entries = realloc(bucket->entries, bucket->capacity * sizeof(RadixEntry));
+    }
+    bucket->entries[bucket->size++] = entry;
+}
+
+// insert a key, which must not be smaller than the last popped key
+void radixPush(RadixHeap* heap, unsigned int key, int vertex) {
+    RadixEntry entry = { key, vertex };
+    radixBucketAppend(&heap->buckets[radixBucketIndex(key, heap->last)], entry);
+    heap->size++;
+}
+
+// remove and return an entry with the smallest key
+RadixEntry radixPop(RadixHeap* heap) {
+    if (heap->buckets[0].size == 0) {
+        int i = 1;
+        while (heap->buckets[i].size == 0) {
+            i++;
+        }
+
+        // the new minimum becomes the reference point, every entry of bucket i moves to a lower bucket
+        RadixBucket* bucket = &heap->buckets[i];
+        unsigned int minKey = bucket->entries[0].key;
+        for (int j = 1; j < bucket->size; j++) {
+            if (bucket->entries[j].key < minKey) {
+                minKey = bucket->entries[j].key;
+            }
+        }
+
+        heap->last = minKey;
+        for (int j = 0; j < bucket->size; j++) {
+            RadixEntry entry = bucket->entries[j];
+            radixBucketAppend(&heap->buckets[radixBucketIndex(entry.key, minKey)], entry);
+        }
+        bucket->size = 0;
+    }
+
+    heap->size--;
+    return heap->buckets[0].entries[--heap->buckets[0].size];
+}
+
+void freeRadixHeap(RadixHeap* heap) {
+    for (int i = 0; i < RADIX_BUCKETS; i++) {
+        free(heap->buckets[i].entries);
+    }
+    free(heap);
+}
+
+const char* queueName(QueueType queue) {
+    switch (queue) {
+        case QUEUE_LINEAR_SCAN:
+            return "linear scan";
+        case QUEUE_RADIX_HEAP:
+            return "radix heap";
+        default:
+            return "binary heap";
+    }
+}
+
+const char* bellmanFordModeName(BellmanFordMode mode) {
+    switch (mode) {
+        case BF_QUEUE:
+            return "queue-based";
+        case BF_PARALLEL:
+            return "parallel";
+        case BF_VECTOR:
+            return "vectorized";
+        default:
+            return "classic";
+    }
+}
+
+int defaultThreadCount() {
+    long cores = sysconf(_SC_NPROCESSORS_ONLN);
+    return cores > 0 ? (int)cores : 1;
+}
+
+// run worker on numThreads threads (the caller being thread 0) and wait for all of them
+void runThreads(int numThreads, void* (*worker)(void*), void* shared) {
+    pthread_t* threads = malloc(numThreads * sizeof(pthread_t));
+    ThreadArgs* args = malloc(numThreads * sizeof(ThreadArgs));
+
+    for (int i = 0; i < numThreads; i++) {
+        args[i].threadId = i;
+        args[i].numThreads = numThreads;
+        args[i].shared = shared;
+    }
+    for (int i = 1; i < numThreads; i++) {
+        pthread_create(&threads[i], NULL, worker, &args[i]);
+    }
+    worker(&args[0]);
+    for (int i = 1; i < numThreads; i++) {
+        pthread_join(threads[i], NULL);
+    }
+
+    free(threads);
+    free(args);
+}
+
+// random directed graph with the given out-degree per vertex and weights in 1..maxWeight
+Graph* generateRandomGraph(int vertices, int degree, int maxWeight, unsigned int seed) {
+    int edges = vertices * degree;
+    int* src = malloc(edges * sizeof(int));
+    int* dest = malloc(edges * sizeof(int));
+    int* weight = malloc(edges * sizeof(int));
+    srand(seed);
+
+    for (int i = 0; i < edges; i++) {
+        src[i] = i / degree;
+        dest[i] = rand() % vertices;
+        weight[i] = 1 + rand() % maxWeight;
+    }
+
+    Graph* graph = createGraphFromEdges(vertices, edges, src, dest, weight);
+    free(src);
+    free(dest);
+    free(weight);
+    return graph;
+}
+
+// road-like graph: rows x cols grid with edges in both directions between neighbours
+Graph* generateGridGraph(int rows, int cols, int maxWeight, unsigned int seed) {
+    int vertices = rows * cols;
+    int* src = malloc(4 * vertices * sizeof(int));
+    int* dest = malloc(4 * vertices * sizeof(int));
+    int* weight = malloc(4 * vertices * sizeof(int));
+    int edges = 0;
+    srand(seed);
+
+    for (int r = 0; r < rows; r++) {
+        for (int c = 0; c < cols; c++) {
+            int u = r * cols + c;
+            int neighbours[2] = { c + 1 < cols ? u + 1 : -1, r + 1 < rows ? u + cols : -1 };
+            for (int k = 0; k < 2; k++) {
+                if (neighbours[k] < 0) continue;
+                int w = 1 + rand() % maxWeight;
+                src[edges] = u;
+                dest[edges] = neighbours[k];
+                weight[edges++] = w;
+                src[edges] = neighbours[k];
+                dest[edges] = u;
+                weight[edges++] = w;
+            }
+        }
+    }
+
+    Graph* graph = createGraphFromEdges(vertices, edges, src, dest, weight);
+    free(src);
+    free(dest);
+    free(weight);
+    return graph;
+}
+
+double currentTime() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// benchmark: weighted_graph bench dijkstra [vertices] [degree] [queries]
+// the default size is the largest the O(V^2) linear scan runs on, so the heaps' speedup over it
+// is always shown; the scan times only the first query, the heaps all of them
+static int benchDijkstra(int argc, char* argv[]) {
+    int vertices = argc > 0 ? atoi(argv[0]) : BENCH_SCAN_LIMIT;
+    int degree = argc > 1 ? atoi(argv[1]) : 3;
+    int queries = argc > 2 ? atoi(argv[2]) : 5;
+
+    if (vertices <= 0 || degree <= 0 || queries <= 0) {
+        printf("Usage: weighted_graph bench dijkstra [vertices] [degree] [queries]\n");
+        return 1;
+    }
+
+    printf("Random graph: %d vertices, %d edges per vertex, %d queries\n", vertices, degree, queries);
+    Graph* graph = generateRandomGraph(vertices, degree, 1000, 42);
+
+    int* expected = malloc(vertices * sizeof(int));
+    int* distances = malloc(vertices * sizeof(int));
+    QueueType queues[] = { QUEUE_LINEAR_SCAN, QUEUE_BINARY_HEAP, QUEUE_RADIX_HEAP };
+    double baseline = 0;
+
+    for (int q = 0; q < 3; q++) {
+        if (queues[q] == QUEUE_LINEAR_SCAN && vertices > BENCH_SCAN_LIMIT) {
+            printf("%-12s skipped (O(V^2), more than %d vertices)\n", queueName(queues[q]), BENCH_SCAN_LIMIT);
+            continue;
+        }
+
+        double total = 0;
+        int mismatches = 0;
+        int timed = queues[q] == QUEUE_LINEAR_SCAN ? 1 : queries;
+        for (int i = 0; i < timed; i++) {
+            int source = (int)((long long)i * vertices / queries);
+            double start = currentTime();
+            computeDijkstra(graph, source, distances, queues[q]);
+            total += currentTime() - start;
+
+            // every queue must agree with the binary heap
+            computeDijkstra(graph, source, expected, QUEUE_BINARY_HEAP);
+            if (memcmp(distances, expected, vertices * sizeof(int)) != 0) {
+                mismatches++;
+            }
+        }
+
+        if (baseline == 0) {
+            baseline = total / timed;
+        }
+        printf("%-12s %10.3f ms/query  speedup %6.2fx  %s\n", queueName(queues[q]),
+               total * 1000 / timed, baseline * timed / total, mismatches ? "MISMATCH" : "ok");
+    }
+
+    free(expected);
+    free(distances);
+    freeGraph(graph);
+    return 0;
+}
+
+// benchmark: weighted_graph bench bellman-ford [vertices] [degree] [queries] [threads]
+static int benchBellmanFord(int argc, char* argv[]) {
+    int vertices = argc > 0 ? atoi(argv[0]) : 100000;
+    int degree = argc > 1 ? atoi(argv[1]) : 3;
+    int queries = argc > 2 ? atoi(argv[2]) : 3;
+    int numThreads = argc > 3 ? atoi(argv[3]) : defaultThreadCount();
+
+    if (vertices <= 0 || degree <= 0 || queries <= 0 || numThreads <= 0) {
+        printf("Usage: weighted_graph bench bellman-ford [vertices] [degree] [queries] [threads]\n");
+        return 1;
+    }
+
+    // shifting weights by random vertex potentials adds negative edges but no negative cycles
+    Graph* graph = generateRandomGraph(vertices, degree, 1000, 42);
+    int* potential = malloc(vertices * sizeof(int));
+    for (int i = 0; i < vertices; i++) {
+        potential[i] = rand() % 500;
+    }
+    for (int u = 0; u < vertices; u++) {
+        for (int e = graph->offsets[u]; e < graph->offsets[u + 1]; e++) {
+            graph->weights[e] += potential[u] - potential[graph->targets[e]];
+        }
+    }
+    printf("Random graph with negative weights: %d vertices, %d edges per vertex, %d queries, %d threads\n",
+           vertices, degree, queries, numThreads);
+
+    int* expected = malloc(vertices * sizeof(int));
+    int* distances = malloc(vertices * sizeof(int));
+    int* parent = malloc(vertices * sizeof(int));
+    int* cycle = malloc(vertices * sizeof(int));
+    BellmanFordMode modes[] = { BF_CLASSIC, BF_QUEUE, BF_PARALLEL };
+    double baseline = 0;
+
+    // the three modes, then the vectorized rounds with every kernel this CPU supports; their
+    // destination-sorted edge list is built once, like an engine answering many queries would
+    double start = currentTime();
+    Graph* incoming = createReverseGraph(graph);
+    printf("Destination-sorted edge list for the vectorized rounds built in %.3f ms\n", (currentTime() - start) * 1000);
+
+    int variants = 3 + bestRelaxKernel() + 1;
+    for (int m = 0; m < variants; m++) {
+        double total = 0;
+        int mismatches = 0;
+        for (int i = 0; i < queries; i++) {
+            int source = (int)((long long)i * vertices / queries);
+            double start = currentTime();
+            int cycleLength;
+            if (m < 3) {
+                cycleLength = computeBellmanFord(graph, source, distances, parent, cycle, modes[m], numThreads);
+            } else {
+                for (int v = 0; v < vertices; v++) {
+                    distances[v] = INT_MAX;
+                    parent[v] = -1;
+                }
+                distances[source] = 0;
+                cycleLength = bellmanFordVectorized(graph, incoming, distances, parent, cycle, (RelaxKernel)(m - 3));
+            }
+            total += currentTime() - start;
+
+            computeBellmanFord(graph, source, expected, parent, cycle, BF_CLASSIC, 1);
+            if (cycleLength != 0 || memcmp(distances, expected, vertices * sizeof(int)) != 0) {
+                mismatches++;
+            }
+        }
+
+        if (baseline == 0) {
+            baseline = total;
+        }
+        char name[32];
+        if (m < 3) {
+            snprintf(name, sizeof(name), "%s", bellmanFordModeName(modes[m]));
+        } else {
+            snprintf(name, sizeof(name), "%s %s", bellmanFordModeName(BF_VECTOR), relaxKernelName((RelaxKernel)(m - 3)));
+        }
+        printf("%-20s %10.3f ms/query  speedup %6.2fx  %s\n", name, total * 1000 / queries, baseline / total,
+               mismatches ? "MISMATCH" : "ok");
+    }
+
+    free(potential);
+    free(expected);
+    free(distances);
+    free(parent);
+    free(cycle);
+    freeGraph(incoming);
+    freeGraph(graph);
+    return 0;
+}
+
+// delta-stepping speedup over thread counts 1, 2, 4, ... up to maxThreads on one graph
+static void benchDeltaGraph(const char* name, Graph* graph, int delta, int maxThreads) {
+    int* expected = malloc(graph->numVertices * sizeof(int));
+    int* distances = malloc(graph->numVertices * sizeof(int));
+
+    delta = boundedDelta(graph, delta);
+    printf("%s: %d vertices, %d edges, delta %d\n", name, graph->numVertices, graph->numEdges, delta);
+
+    double start = currentTime();
+    computeDijkstra(graph, 0, expected, QUEUE_BINARY_HEAP);
+    double dijkstraTime = currentTime() - start;
+    printf("  dijkstra (binary heap) %10.3f ms\n", dijkstraTime * 1000);
+
+    double singleThread = 0;
+    for (int threads = 1; ; threads = threads * 2 < maxThreads ? threads * 2 : maxThreads) {
+        start = currentTime();
+        computeDeltaStepping(graph, 0, distances, delta, threads);
+        double elapsed = currentTime() - start;
+        if (threads == 1) {
+            singleThread = elapsed;
+        }
+
+        int match = memcmp(distances, expected, graph->numVertices * sizeof(int)) == 0;
+        printf("  delta-stepping %3d threads %10.3f ms  speedup %6.2fx  vs dijkstra %6.2fx  %s\n", threads,
+               elapsed * 1000, singleThread / elapsed, dijkstraTime / elapsed, match ? "ok" : "MISMATCH");
+        if (threads >= maxThreads) break;
+    }
+
+    free(expected);
+    free(distances);
+}
+
+// benchmark: weighted_graph bench delta [vertices] [degree] [delta] [max threads]
+static int benchDeltaStepping(int argc, char* argv[]) {
+    int vertices = argc > 0 ? atoi(argv[0]) : 1000000;
+    int degree = argc > 1 ? atoi(argv[1]) : 3;
+    int delta = argc > 2 ? atoi(argv[2]) : 0;
+    int maxThreads = argc > 3 ? atoi(argv[3]) : defaultThreadCount();
+
+    if (vertices <= 0 || degree <= 0 || maxThreads <= 0) {
+        printf("Usage: weighted_graph bench delta [vertices] [degree] [delta] [max threads]\n");
+        return 1;
+    }
+
+    Graph* graph = generateRandomGraph(vertices, degree, 1000, 42);
+    benchDeltaGraph("Random graph", graph, delta, maxThreads);
+    freeGraph(graph);
+
+    int side = 1;
+    while ((long long)(side + 1) * (side + 1) <= vertices) {
+        side++;
+    }
+    graph = generateGridGraph(side, side, 1000, 42);
+    benchDeltaGraph("Road-like grid", graph, delta, maxThreads);
+    freeGraph(graph);
+    return 0;
+}
+
+// benchmark: weighted_graph bench matrix [vertices] [degree] [sources] [max threads]
+static int benchDistanceMatrix(int argc, char* argv[]) {
+    int vertices = argc > 0 ? atoi(argv[0]) : 100000;
+    int degree = argc > 1 ? atoi(argv[1]) : 3;
+    int numSources = argc > 2 ? atoi(argv[2]) : 64;
+    int maxThreads = argc > 3 ? atoi(argv[3]) : defaultThreadCount();
+
+    if (vertices <= 0 || degree <= 0 || numSources <= 0 || numSources > vertices || maxThreads <= 0) {
+        printf("Usage: weighted_graph bench matrix [vertices] [degree] [sources] [max threads]\n");
+        return 1;
+    }
+
+    Graph* graph = generateRandomGraph(vertices, degree, 1000, 42);
+    int* sources = malloc(numSources * sizeof(int));
+    int* matrix = malloc((size_t)numSources * vertices * sizeof(int));
+    int* expected = malloc(vertices * sizeof(int));
+    for (int i = 0; i < numSources; i++) {
+        sources[i] = rand() % vertices;
+    }
+    printf("Random graph: %d vertices, %d edges per vertex, %d sources\n", vertices, degree, numSources);
+
+    double singleThread = 0;
+    for (int threads = 1; ; threads = threads * 2 < maxThreads ? threads * 2 : maxThreads) {
+        double start = currentTime();
+        computeDistanceMatrix(graph, sources, numSources, matrix, -1, threads);
+        double elapsed = currentTime() - start;
+        if (threads == 1) {
+            singleThread = elapsed;
+        }
+
+        int mismatches = 0;
+        for (int i = 0; i < numSources; i += numSources / 8 + 1) {
+            computeDijkstra(graph, sources[i], expected, QUEUE_BINARY_HEAP);
+            mismatches += memcmp(matrix + (size_t)i * vertices, expected, vertices * sizeof(int)) != 0;
+        }
+        printf("%3d threads %10.3f ms  %10.1f sources/s  speedup %6.2fx  %s\n", threads, elapsed * 1000,
+               numSources / elapsed, singleThread / elapsed, mismatches ? "MISMATCH" : "ok");
+        if (threads >= maxThreads) break;
+    }
+
+    free(sources);
+    free(matrix);
+    free(expected);
+    freeGraph(graph);
+    return 0;
+}
+
+// settled vertices and time per point-to-point query method on one graph
+static void benchQueryGraph(const char* name, Graph* graph, int queries, int numLandmarks) {
+    int n = graph->numVertices;
+    int* sources = malloc(queries * sizeof(int));
+    int* targets = malloc(queries * sizeof(int));
+    int* expected = malloc(queries * sizeof(int));
+    int* distances = malloc(n * sizeof(int));
+
+    for (int i = 0; i < queries; i++) {
+        sources[i] = rand() % n;
+        targets[i] = rand() % n;
+    }
+    printf("%s: %d vertices, %d edges, %d queries\n", name, n, graph->numEdges, queries);
+
+    // full Dijkstra settles every reachable vertex and gives the reference distances
+    double total = 0;
+    long long settled = 0;
+    for (int i = 0; i < queries; i++) {
+        double start = currentTime();
+        computeDijkstra(graph, sources[i], distances, QUEUE_BINARY_HEAP);
+        total += currentTime() - start;
+        expected[i] = distances[targets[i]];
+        for (int v = 0; v < n; v++) {
+            settled += distances[v] != INT_MAX;
+        }
+    }
+    printf("  %-24s %10.3f ms/query  %12.1f settled/query\n", "full Dijkstra", total * 1000 / queries, (double)settled / queries);
+
+    double start = currentTime();
+    RoutingEngine* engine = createRoutingEngine(graph, numLandmarks);
+    printf("  landmark preprocessing (%d landmarks) %.3f ms\n", numLandmarks, (currentTime() - start) * 1000);
+
+    QueryMethod methods[] = { QUERY_DIJKSTRA, QUERY_BIDIRECTIONAL, QUERY_ALT };
+    for (int m = 0; m < 3; m++) {
+        total = 0;
+        settled = 0;
+        int mismatches = 0;
+        for (int i = 0; i < queries; i++) {
+            start = currentTime();
+            int distance = shortestPathQuery(engine, sources[i], targets[i], methods[m], NULL, NULL);
+            total += currentTime() - start;
+            settled += engine->settled;
+            mismatches += distance != expected[i];
+        }
+        printf("  %-24s %10.3f ms/query  %12.1f settled/query  %s\n", queryMethodName(methods[m]),
+               total * 1000 / queries, (double)settled / queries, mismatches ? "MISMATCH" : "ok");
+    }
+
+    freeRoutingEngine(engine);
+    free(sources);
+    free(targets);
+    free(expected);
+    free(distances);
+}
+
+// benchmark: weighted_graph bench query [vertices] [queries] [landmarks]
+static int benchPointToPoint(int argc, char* argv[]) {
+    int vertices = argc > 0 ? atoi(argv[0]) : 1000000;
+    int queries = argc > 1 ? atoi(argv[1]) : 20;
+    int numLandmarks = argc > 2 ? atoi(argv[2]) : ROUTING_LANDMARKS;
+
+    if (vertices <= 0 || queries <= 0 || numLandmarks <= 0) {
+        printf("Usage: weighted_graph bench query [vertices] [queries] [landmarks]\n");
+        return 1;
+    }
+
+    int side = 1;
+    while ((long long)(side + 1) * (side + 1) <= vertices) {
+        side++;
+    }
+    Graph* graph = generateGridGraph(side, side, 1000, 42);
+    benchQueryGraph("Road-like grid", graph, queries, numLandmarks);
+    freeGraph(graph);
+
+    graph = generateRandomGraph(vertices, 3, 1000, 42);
+    benchQueryGraph("Random graph", graph, queries, numLandmarks);
+    freeGraph(graph);
+    return 0;
+}
+
+// benchmark: weighted_graph bench ch [vertices] [queries] [hierarchy file]
+// preprocessing, optional save/load round trip and query time on a road-like grid
+static int benchContractionHierarchy(int argc, char* argv[]) {
+    int vertices = argc > 0 ? atoi(argv[0]) : 1000000;
+    int queries = argc > 1 ? atoi(argv[1]) : 10000;
+    const char* fileName = argc > 2 ? argv[2] : NULL;
+
+    if (vertices <= 0 || queries <= 0) {
+        printf("Usage: weighted_graph bench ch [vertices] [queries] [hierarchy file]\n");
+        return 1;
+    }
+
+    int side = 1;
+    while ((long long)(side + 1) * (side + 1) <= vertices) {
+        side++;
+    }
+    Graph* graph = generateGridGraph(side, side, 1000, 42);
+    int n = graph->numVertices;
+    printf("Road-like grid: %d vertices, %d edges, %d queries\n", n, graph->numEdges, queries);
+
+    double start = currentTime();
+    ContractionHierarchy* ch = buildContractionHierarchy(graph);
+    printf("  preprocessing %.3f s, %d shortcuts (%.2f per vertex)\n", currentTime() - start,
+           hierarchyShortcuts(ch), (double)hierarchyShortcuts(ch) / n);
+
+    if (fileName != NULL) {
+        start = currentTime();
+        if (!saveContractionHierarchy(ch, fileName)) {
+            printf("Failed to write %s\n", fileName);
+            freeContractionHierarchy(ch);
+            freeGraph(graph);
+            return 1;
+        }
+        double saved = currentTime() - start;
+        freeContractionHierarchy(ch);
+
+        start = currentTime();
+        ch = loadContractionHierarchy(fileName);
+        if (ch == NULL) {
+            freeGraph(graph);
+            return 1;
+        }
+        printf("  saved in %.3f s, loaded in %.3f s (%s)\n", saved, currentTime() - start, fileName);
+    }
+
+    int* sources = malloc(queries * sizeof(int));
+    int* targets = malloc(queries * sizeof(int));
+    int* path = malloc(n * sizeof(int));
+    for (int i = 0; i < queries; i++) {
+        sources[i] = rand() % n;
+        targets[i] = rand() % n;
+    }
+
+    double total = 0;
+    long long settled = 0;
+    for (int i = 0; i < queries; i++) {
+        start = currentTime();
+        hierarchyQuery(ch, sources[i], targets[i], NULL, NULL);
+        total += currentTime() - start;
+        settled += ch->settled;
+    }
+    printf("  %-24s %10.4f ms/query  %10.1f settled/query\n", "distance only", total * 1000 / queries, (double)settled / queries);
+
+    total = 0;
+    long long pathVertices = 0;
+    for (int i = 0; i < queries; i++) {
+        int pathLength;
+        start = currentTime();
+        hierarchyQuery(ch, sources[i], targets[i], path, &pathLength);
+        total += currentTime() - start;
+        pathVertices += pathLength;
+    }
+    printf("  %-24s %10.4f ms/query  %10.1f path vertices/query\n", "with path unpacking", total * 1000 / queries, (double)pathVertices / queries);
+
+    // full Dijkstra is slow on big graphs, so only a few queries are checked against it
+    int checks = queries < BENCH_CHECK_QUERIES ? queries : BENCH_CHECK_QUERIES;
+    int* distances = malloc(n * sizeof(int));
+    int mismatches = 0;
+    for (int i = 0; i < checks; i++) {
+        computeDijkstra(graph, sources[i], distances, QUEUE_BINARY_HEAP);
+        mismatches += hierarchyQuery(ch, sources[i], targets[i], NULL, NULL) != distances[targets[i]];
+    }
+    printf("  checked %d queries against Dijkstra: %s\n", checks, mismatches ? "MISMATCH" : "ok");
+
+    freeContractionHierarchy(ch);
+    freeGraph(graph);
+    free(sources);
+    free(targets);
+    free(path);
+    free(distances);
+    return mismatches ? 1 : 0;
+}
+
+// 1 if both graphs have the same CSR arrays
+static int sameGraph(Graph* a, Graph* b) {
+    return a->numVertices == b->numVertices && a->numEdges == b->numEdges
+        && memcmp(a->offsets, b->offsets, (a->numVertices + 1) * sizeof(int)) == 0
+        && memcmp(a->targets, b->targets, a->numEdges * sizeof(int)) == 0
+        && memcmp(a->weights, b->weights, a->numEdges * sizeof(int)) == 0;
+}
+
+// load one file with the given thread count and report edges/s
+static void benchLoadFile(const char* format, const char* fileName, Graph* original, int numThreads) {
+    double start = currentTime();
+    Graph* graph = loadGraph(fileName, numThreads);
+    double elapsed = currentTime() - start;
+
+    if (graph == NULL) {
+        printf("  %-12s %2d threads  failed to load\n", format, numThreads);
+        return;
+    }
+    printf("  %-12s %2d threads  %8.3f s  %8.1f M edges/s  %s\n", format, numThreads, elapsed,
+           graph->numEdges / (elapsed > 0 ? elapsed : 1e-9) / 1e6, sameGraph(graph, original) ? "ok" : "MISMATCH");
+    freeGraph(graph);
+}
+
+// benchmark: weighted_graph bench load [vertices] [degree] [max threads]
+// writes a random graph as DIMACS, edge list and binary files and times loading them back
+static int benchLoadGraph(int argc, char* argv[]) {
+    int vertices = argc > 0 ? atoi(argv[0]) : 1000000;
+    int degree = argc > 1 ? atoi(argv[1]) : 8;
+    int maxThreads = argc > 2 ? atoi(argv[2]) : defaultThreadCount();
+
+    if (vertices <= 0 || degree <= 0 || maxThreads <= 0) {
+        printf("Usage: weighted_graph bench load [vertices] [degree] [max threads]\n");
+        return 1;
+    }
+
+    Graph* graph = generateRandomGraph(vertices, degree, 1000, 42);
+    const char* formats[] = { "DIMACS", "edge list", "binary" };
+    char fileNames[3][64];
+    int ok = 1;
+
+    for (int f = 0; f < 3 && ok; f++) {
+        strcpy(fileNames[f], "/tmp/weighted_graph_load_XXXXXX");
+        int fd = mkstemp(fileNames[f]);
+        if (fd < 0) {
+            perror("Failed to create a temporary file");
+            ok = 0;
+            break;
+        }
+        close(fd);
+
+        double start = currentTime();
+        ok = f == 2 ? saveGraphBinary(graph, fileNames[f]) : saveGraphText(graph, fileNames[f], f == 0);
+        struct stat info;
+        stat(fileNames[f], &info);
+        printf("Wrote %s graph (%d vertices, %d edges, %.1f MB) in %.3f s\n", formats[f], vertices,
+               graph->numEdges, info.st_size / 1e6, currentTime() - start);
+    }
+
+    for (int f = 0; f < 3 && ok; f++) {
+        // the binary loader is a bulk copy, threads only matter for text
+        for (int t = 1; t <= (f == 2 ? 1 : maxThreads); t *= 2) {
+            benchLoadFile(formats[f], fileNames[f], graph, t);
+        }
+    }
+
+    for (int f = 0; f < 3; f++) {
+        unlink(fileNames[f]);
+    }
+    freeGraph(graph);
+    return ok ? 0 : 1;
+}
+
+// benchmark: weighted_graph bench snapshot [vertices] [ch]
+// startup from a binary graph file versus mapping a snapshot of the same road-like grid
+static int benchSnapshot(int argc, char* argv[]) {
+    int vertices = argc > 0 ? atoi(argv[0]) : 1000000;
+    int withHierarchy = argc > 1 && strcmp(argv[1], "ch") == 0;
+
+    if (vertices <= 0) {
+        printf("Usage: weighted_graph bench snapshot [vertices] [ch]\n");
+        return 1;
+    }
+
+    int side = 1;
+    while ((long long)(side + 1) * (side + 1) <= vertices) {
+        side++;
+    }
+    Graph* graph = generateGridGraph(side, side, 1000, 42);
+    int n = graph->numVertices;
+    ContractionHierarchy* ch = withHierarchy ? buildContractionHierarchy(graph) : NULL;
+
+    char binaryFile[] = "/tmp/weighted_graph_binary_XXXXXX";
+    char snapshotFile[] = "/tmp/weighted_graph_snapshot_XXXXXX";
+    int binaryFd = mkstemp(binaryFile);
+    int snapshotFd = mkstemp(snapshotFile);
+    if (binaryFd < 0 || snapshotFd < 0) {
+        perror("Failed to create a temporary file");
+        return 1;
+    }
+    close(binaryFd);
+    close(snapshotFd);
+
+    int ok = saveGraphBinary(graph, binaryFile) && saveGraphSnapshot(graph, ch, snapshotFile, 1);
+    printf("Road-like grid: %d vertices, %d edges%s\n", n, graph->numEdges, ch != NULL ? ", contraction hierarchy" : "");
+
+    int* expected = malloc(n * sizeof(int));
+    int* distances = malloc(n * sizeof(int));
+    computeDijkstra(graph, 0, expected, QUEUE_BINARY_HEAP);
+
+    if (ok) {
+        double start = currentTime();
+        Graph* loaded = loadGraph(binaryFile, 1);
+        printf("  %-28s %10.3f ms\n", "load binary graph", (currentTime() - start) * 1000);
+        freeGraph(loaded);
+
+        for (int verify = 0; verify <= 1; verify++) {
+            start = currentTime();
+            GraphSnapshot* snapshot = openGraphSnapshot(snapshotFile, verify);
+            double opened = currentTime() - start;
+            if (snapshot == NULL) {
+                ok = 0;
+                break;
+            }
+
+            // the first query pulls the mapped pages in
+            start = currentTime();
+            computeDijkstra(snapshot->graph, 0, distances, QUEUE_BINARY_HEAP);
+            double query = currentTime() - start;
+            int same = memcmp(distances, expected, n * sizeof(int)) == 0;
+            if (snapshot->hierarchy != NULL) {
+                for (int i = 0; i < BENCH_CHECK_QUERIES; i++) {
+                    int target = rand() % n;
+                    same = same && hierarchyQuery(snapshot->hierarchy, 0, target, NULL, NULL) == expected[target];
+                }
+                freeContractionHierarchy(snapshot->hierarchy);
+            }
+            printf("  %-28s %10.3f ms  first Dijkstra %.3f ms  %s\n", verify ? "map snapshot + checksum" : "map snapshot",
+                   opened * 1000, query * 1000, same ? "ok" : "MISMATCH");
+            ok = ok && same;
+
+            freeGraph(snapshot->graph);
+            closeGraphSnapshot(snapshot);
+        }
+    }
+
+    unlink(binaryFile);
+    unlink(snapshotFile);
+    if (ch != NULL) {
+        freeContractionHierarchy(ch);
+    }
+    freeGraph(graph);
+    free(expected);
+    free(distances);
+    return ok ? 0 : 1;
+}
+
+// benchmark: weighted_graph bench dynamic [vertices] [batches]
+// latency of incremental repair versus full recomputation as batches touch more of the edges
+static int benchDynamicUpdates(int argc, char* argv[]) {
+    int vertices = argc > 0 ? atoi(argv[0]) : 1000000;
+    int batches = argc > 1 ? atoi(argv[1]) : 5;
+
+    if (vertices <= 0 || batches <= 0) {
+        printf("Usage: weighted_graph bench dynamic [vertices] [batches]\n");
+        return 1;
+    }
+
+    int side = 1;
+    while ((long long)(side + 1) * (side + 1) <= vertices) {
+        side++;
+    }
+    Graph* graph = generateGridGraph(side, side, 1000, 42);
+    DynamicGraph* dynamic = createDynamicGraph(graph);
+    int n = dynamic->numVertices;
+    freeGraph(graph);
+
+    DynamicSSSP* incremental = createDynamicSSSP(dynamic, 0);
+    DynamicSSSP* reference = createDynamicSSSP(dynamic, 0);
+    if (incremental == NULL || reference == NULL) {
+        printf("Dynamic shortest paths need non-negative weights\n");
+        if (incremental != NULL) freeDynamicSSSP(incremental);
+        if (reference != NULL) freeDynamicSSSP(reference);
+        freeDynamicGraph(dynamic);
+        return 1;
+    }
+    printf("Road-like grid: %d vertices, %d edges, %d batches per change fraction\n", n, dynamic->numEdges, batches);
+    printf("  %-10s %9s %14s %16s %14s %9s\n", "fraction", "changes", "incremental", "settled/batch", "full", "speedup");
+
+    double fractions[] = { 0.00001, 0.0001, 0.001, 0.01, 0.1 };
+    int ok = 1;
+    for (int f = 0; f < 5; f++) {
+        int numChanges = (int)(dynamic->numEdges * fractions[f]);
+        if (numChanges < 1) {
+            numChanges = 1;
+        }
+        EdgeChange* changes = malloc(numChanges * sizeof(EdgeChange));
+        double incrementalTime = 0, fullTime = 0;
+        long long settled = 0;
+
+        for (int b = 0; b < batches; b++) {
+            // like a traffic feed: mostly weights scaled by 0.5 - 1.5, a few closed and re-opened roads
+            for (int i = 0; i < numChanges; i++) {
+                int u = rand() % n;
+                int kind = rand() % 10;
+                changes[i].src = u;
+                if (kind < 9 && dynamic->out[u].size > 0) {
+                    DynamicEdge* edge = &dynamic->out[u].edges[rand() % dynamic->out[u].size];
+                    changes[i].dest = edge->target;
+                    changes[i].weight = 1 + (int)((long long)edge->weight * (50 + rand() % 101) / 100);
+                    changes[i].type = kind == 0 ? EDGE_DELETE : EDGE_UPDATE;
+                } else {
+                    int neighbours[4] = { u - 1, u + 1, u - side, u + side };
+                    int v = neighbours[rand() % 4];
+                    changes[i].dest = v >= 0 && v < n ? v : u;
+                    changes[i].weight = 1 + rand() % 1000;
+                    changes[i].type = EDGE_INSERT;
+                }
+            }
+
+            double start = currentTime();
+            applyEdgeChanges(incremental, changes, numChanges);
+            incrementalTime += currentTime() - start;
+            settled += incremental->processed;
+
+            start = currentTime();
+            dynamicRecompute(reference);
+            fullTime += currentTime() - start;
+            ok = ok && memcmp(incremental->distances, reference->distances, n * sizeof(int)) == 0;
+        }
+
+        printf("  %-10g %9d %11.3f ms %16.1f %11.3f ms %8.1fx\n", fractions[f], numChanges, incrementalTime * 1000 / batches,
+               (double)settled / batches, fullTime * 1000 / batches, fullTime / (incrementalTime > 0 ? incrementalTime : 1e-9));
+        free(changes);
+    }
+    printf("  distances after every batch match full recomputation: %s\n", ok ? "ok" : "MISMATCH");
+
+    freeDynamicSSSP(incremental);
+    freeDynamicSSSP(reference);
+    freeDynamicGraph(dynamic);
+    return ok ? 0 : 1;
+}
+
+// hardware cache-miss counter for this thread (user space only), -1 where perf events are unavailable
+static int openCacheMissCounter() {
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.size = sizeof(attr);
+    attr.config = PERF_COUNT_HW_CACHE_MISSES;
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    return (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+static long long readCacheMisses(int fd) {
+    long long count = -1;
+    if (fd < 0 || read(fd, &count, sizeof(count)) != (ssize_t)sizeof(count)) return -1;
+    return count;
+}
+
+// mean |id(u) - id(v)| over all edges: small gaps mean neighbours share cache lines
+static double meanEdgeGap(Graph* graph) {
+    double total = 0;
+    for (int u = 0; u < graph->numVertices; u++) {
+        for (int e = graph->offsets[u]; e < graph->offsets[u + 1]; e++) {
+            total += abs(graph->targets[e] - u);
+        }
+    }
+    return graph->numEdges > 0 ? total / graph->numEdges : 0;
+}
+
+// time and cache misses of Dijkstra, Bellman-Ford (SPFA) and BFS on one numbering of a graph; results
+// are compared by user-visible id against expected (filled in on the first call, when baseline is 0)
+static void benchReorderedGraph(const char* order, Graph* graph, int queries, int counter, int** expected, double* baseline) {
+    int n = graph->numVertices;
+    int* distances = malloc(n * sizeof(int));
+    int* parent = malloc(n * sizeof(int));
+    int* cycle = malloc(n * sizeof(int));
+    const char* names[] = { "dijkstra", "bellman-ford", "bfs" };
+
+    for (int a = 0; a < 3; a++) {
+        double total = 0;
+        long long misses = 0;
+        int mismatches = 0;
+        for (int i = 0; i < queries; i++) {
+            int id = (int)((long long)i * n / queries);
+            int source = vertexIndex(graph, id);
+            long long before = readCacheMisses(counter);
+            double start = currentTime();
+            if (a == 0) {
+                computeDijkstra(graph, source, distances, QUEUE_BINARY_HEAP);
+            } else if (a == 1) {
+                computeBellmanFord(graph, source, distances, parent, cycle, BF_QUEUE, 1);
+            } else {
+                computeBFS(graph, source, distances);
+            }
+            total += currentTime() - start;
+            misses += readCacheMisses(counter) - before;
+
+            int* reference = expected[a * queries + i];
+            for (int v = 0; v < n; v++) {
+                if (baseline[a] == 0) {
+                    reference[vertexLabel(graph, v)] = distances[v];
+                } else if (reference[vertexLabel(graph, v)] != distances[v]) {
+                    mismatches++;
+                    break;
+                }
+            }
+        }
+
+        if (baseline[a] == 0) {
+            baseline[a] = total;
+        }
+        char missText[32] = "n/a";
+        if (counter >= 0) {
+            snprintf(missText, sizeof(missText), "%.0f", (double)misses / queries);
+        }
+        printf("  %-22s %-13s %10.3f ms/query  speedup %5.2fx  cache misses %12s  %s\n", order, names[a],
+               total * 1000 / queries, baseline[a] / total, missText, mismatches ? "MISMATCH" : "ok");
+    }
+
+    free(distances);
+    free(parent);
+    free(cycle);
+}
+
+// every reordering of one graph whose input ids carry no locality (randomly scrambled)
+static void benchReorderGraph(const char* name, Graph* generated, int queries, int counter) {
+    int n = generated->numVertices;
+    int* scramble = malloc(n * sizeof(int));
+    for (int v = 0; v < n; v++) {
+        scramble[v] = v;
+    }
+    for (int v = n - 1; v > 0; v--) {
+        int j = rand() % (v + 1);
+        int temp = scramble[v];
+        scramble[v] = scramble[j];
+        scramble[j] = temp;
+    }
+
+    // the scrambled ids are the ones the user typed
+    Graph* graph = permuteGraph(generated, scramble);
+    free(graph->labels);
+    free(graph->vertexOf);
+    graph->labels = NULL;
+    graph->vertexOf = NULL;
+    free(scramble);
+
+    int** expected = malloc(3 * queries * sizeof(int*));
+    for (int i = 0; i < 3 * queries; i++) {
+        expected[i] = malloc(n * sizeof(int));
+    }
+    double baseline[3] = { 0, 0, 0 };
+
+    printf("%s: %d vertices, %d edges, %d queries\n", name, n, graph->numEdges, queries);
+    printf("  %-22s mean edge gap %10.0f\n", "input order", meanEdgeGap(graph));
+    benchReorderedGraph("input order", graph, queries, counter, expected, baseline);
+
+    VertexOrder orders[] = { ORDER_BFS, ORDER_RCM, ORDER_DEGREE };
+    for (int o = 0; o < 3; o++) {
+        double start = currentTime();
+        Graph* reordered = reorderGraph(graph, orders[o]);
+        double elapsed = currentTime() - start;
+        printf("  %-22s mean edge gap %10.0f  reordered in %.3f s\n", vertexOrderName(orders[o]), meanEdgeGap(reordered), elapsed);
+        benchReorderedGraph(vertexOrderName(orders[o]), reordered, queries, counter, expected, baseline);
+        freeGraph(reordered);
+    }
+
+    for (int i = 0; i < 3 * queries; i++) {
+        free(expected[i]);
+    }
+    free(expected);
+    freeGraph(graph);
+}
+
+// benchmark: weighted_graph bench reorder [vertices] [queries]
+static int benchReorder(int argc, char* argv[]) {
+    int vertices = argc > 0 ? atoi(argv[0]) : 1000000;
+    int queries = argc > 1 ? atoi(argv[1]) : 3;
+
+    if (vertices <= 0 || queries <= 0) {
+        printf("Usage: weighted_graph bench reorder [vertices] [queries]\n");
+        return 1;
+    }
+
+    int counter = openCacheMissCounter();
+    if (counter < 0) {
+        printf("Hardware cache counters unavailable (perf_event_open failed), reporting time only\n");
+    } else {
+        ioctl(counter, PERF_EVENT_IOC_RESET, 0);
+        ioctl(counter, PERF_EVENT_IOC_ENABLE, 0);
+    }
+
+    int side = 1;
+    while ((long long)(side + 1) * (side + 1) <= vertices) {
+        side++;
+    }
+    Graph* grid = generateGridGraph(side, side, 1000, 42);
+    benchReorderGraph("Road-like grid, scrambled ids", grid, queries, counter);
+    freeGraph(grid);
+
+    Graph* random = generateRandomGraph(vertices, 4, 1000, 42);
+    benchReorderGraph("Random graph, 4 edges per vertex", random, queries, counter);
+    freeGraph(random);
+
+    if (counter >= 0) {
+        close(counter);
+    }
+    return 0;
+}
+
+// benchmark: weighted_graph bench kpaths [vertices] [queries]
+static int benchAlternativeRoutes(int argc, char* argv[]) {
+    int vertices = argc > 0 ? atoi(argv[0]) : 100000;
+    int queries = argc > 1 ? atoi(argv[1]) : 5;
+
+    if (vertices <= 0 || queries <= 0) {
+        printf("Usage: weighted_graph bench kpaths [vertices] [queries]\n");
+        return 1;
+    }
+
+    int side = 1;
+    while ((long long)(side + 1) * (side + 1) <= vertices) {
+        side++;
+    }
+    Graph* graph = generateGridGraph(side, side, 1000, 42);
+    int n = graph->numVertices;
+    int* sources = malloc(queries * sizeof(int));
+    int* targets = malloc(queries * sizeof(int));
+    int* distances = malloc(n * sizeof(int));
+    int* shortestHops = malloc(queries * sizeof(int));
+    for (int i = 0; i < queries; i++) {
+        sources[i] = rand() % n;
+        targets[i] = rand() % n;
+    }
+    printf("Road-like grid: %d vertices, %d edges, %d queries, one reused path finder\n", n, graph->numEdges, queries);
+
+    PathFinder* finder = createPathFinder(graph);
+    int ks[] = { 1, 2, 5, 10, 20, 50, 100 };
+    Path* paths = malloc(100 * sizeof(Path));
+    int ok = 1;
+
+    printf("  %-5s %12s %14s %16s %14s\n", "k", "time", "spur searches", "settled", "k-th / 1st");
+    for (int j = 0; j < 7; j++) {
+        double total = 0, stretch = 0;
+        long long spurs = 0, settled = 0;
+        for (int i = 0; i < queries; i++) {
+            double start = currentTime();
+            int found = kShortestPaths(finder, sources[i], targets[i], ks[j], paths);
+            total += currentTime() - start;
+            spurs += finder->spurSearches;
+            settled += finder->settled;
+
+            // the first route is the Dijkstra distance, the others follow in order without repeats
+            computeDijkstra(graph, sources[i], distances, QUEUE_BINARY_HEAP);
+            ok = ok && found == ks[j] && paths[0].distance == distances[targets[i]];
+            for (int p = 1; p < found; p++) {
+                ok = ok && paths[p].distance >= paths[p - 1].distance && !samePath(&paths[p], &paths[p - 1]);
+            }
+            if (found > 0) {
+                stretch += paths[0].distance > 0 ? (double)paths[found - 1].distance / paths[0].distance : 1;
+                shortestHops[i] = paths[0].length - 1;
+            }
+            for (int p = 0; p < found; p++) {
+                freePath(&paths[p]);
+            }
+        }
+        printf("  %-5d %9.3f ms %14.1f %16.1f %13.3fx\n", ks[j], total * 1000 / queries, (double)spurs / queries,
+               (double)settled / queries, stretch / queries);
+    }
+
+    // hop limits between the fewest possible edges and the edge count of the unconstrained shortest path
+    printf("  %-18s %12s %16s %14s\n", "edge limit", "time", "settled labels", "distance");
+    const char* names[] = { "fewest edges", "halfway", "shortest path's" };
+    for (int j = 0; j < 3; j++) {
+        double total = 0, increase = 0;
+        long long settled = 0;
+        for (int i = 0; i < queries; i++) {
+            kShortestPaths(finder, sources[i], targets[i], 1, paths);
+            int unconstrained = paths[0].distance;
+            freePath(&paths[0]);
+            int fewest = finder->hopsToTarget[sources[i]];
+            int limit = j == 0 ? fewest : j == 1 ? (fewest + shortestHops[i]) / 2 : shortestHops[i];
+
+            Path path;
+            double start = currentTime();
+            int distance = hopLimitedPath(finder, sources[i], targets[i], limit, &path);
+            total += currentTime() - start;
+            settled += finder->settled;
+            ok = ok && distance != INT_MAX && path.length - 1 <= limit && distance >= unconstrained
+                 && (j < 2 || distance == unconstrained);
+            increase += unconstrained > 0 ? (double)distance / unconstrained : 1;
+            freePath(&path);
+        }
+        printf("  %-18s %9.3f ms %16.1f %13.3fx\n", names[j], total * 1000 / queries, (double)settled / queries, increase / queries);
+    }
+    printf("  routes and hop limits checked: %s\n", ok ? "ok" : "MISMATCH");
+
+    free(paths);
+    free(sources);
+    free(targets);
+    free(distances);
+    free(shortestHops);
+    freePathFinder(finder);
+    freeGraph(graph);
+    return ok ? 0 : 1;
+}
+
+// benchmark dispatcher: weighted_graph bench <dijkstra|bellman-ford|delta|matrix|query|ch|load|snapshot|dynamic|reorder|kpaths> [options]
+int runBenchmark(int argc, char* argv[]) {
+    if (argc > 0 && strcmp(argv[0], "kpaths") == 0) {
+        return benchAlternativeRoutes(argc - 1, argv + 1);
+    }
+    if (argc > 0 && strcmp(argv[0], "reorder") == 0) {
+        return benchReorder(argc - 1, argv + 1);
+    }
+    if (argc > 0 && strcmp(argv[0], "dynamic") == 0) {
+        return benchDynamicUpdates(argc - 1, argv + 1);
+    }
+    if (argc > 0 && strcmp(argv[0], "snapshot") == 0) {
+        return benchSnapshot(argc - 1, argv + 1);
+    }
+    if (argc > 0 && strcmp(argv[0], "load") == 0) {
+        return benchLoadGraph(argc - 1, argv + 1);
+    }
+    if (argc > 0 && strcmp(argv[0], "ch") == 0) {
+        return benchContractionHierarchy(argc - 1, argv + 1);
+    }
+    if (argc > 0 && strcmp(argv[0], "query") == 0) {
+        return benchPointToPoint(argc - 1, argv + 1);
+    }
+    if (argc > 0 && strcmp(argv[0], "matrix") == 0) {
+        return benchDistanceMatrix(argc - 1, argv + 1);
+    }
+    if (argc > 0 && strcmp(argv[0], "delta") == 0) {
+        return benchDeltaStepping(argc - 1, argv + 1);
+    }
+    if (argc > 0 && strcmp(argv[0], "bellman-ford") == 0) {
+        return benchBellmanFord(argc - 1, argv + 1);
+    }
+    if (argc > 0 && strcmp(argv[0], "dijkstra") == 0) {
+        return benchDijkstra(argc - 1, argv + 1);
+    }
+    if (argc == 0) {
+        return benchDijkstra(0, argv);
+    }
+
+    printf("Usage: weighted_graph bench <dijkstra|bellman-ford|delta|matrix|query|ch|load|snapshot|dynamic|reorder|kpaths> [options]\n");
+    return 1;
+}